@@ -0,0 +1,407 @@
+#include"Main.h"
+
+
+using namespace nautilus::network;
+
+
+#define BOTS_COUNT 16 // Default count of bots, can be overridden by first command line argument.
+#define BOTS_UPDATE_RATE 30 // Default updates per second each bot sends, can be overridden by second command line argument.
+#define BOTS_DURATION 60 // Default seconds to run, can be overridden by third command line argument.
+#define BOTS_CSV "bots.csv" // Default report file, can be overridden by fourth command line argument.
+#define BOTS_SERVER_HOST "127.0.0.1" // Can be overridden by fifth command line argument.
+#define BOTS_SERVER_PORT 7777 // Can be overridden by sixth command line argument.
+
+#define BOTS_PING_RATE 5 // Pings per second each bot sends to measure the round trip time.
+#define BOTS_SPACING 10.0f // Distance between the centers the bots fly around.
+#define BOTS_ORBIT 4.0f // Radius of the circle each bot flies.
+#define BOTS_INCOMING_QUEUE 256 // Messages waiting for a bot to handle them, each bot receives a few per frame.
+
+
+
+// Time in microseconds, only used for differences.
+static uint64_t nowMicroseconds() {
+
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Value below which the given fraction of the sorted samples lies.
+static float percentile(const std::vector<float>& sorted, float fraction) {
+
+	if (sorted.empty()) return 0.0f;
+
+	size_t index = (size_t)std::ceil(fraction * sorted.size());
+	if (index > 0) index--;
+
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+
+
+// A bot behaves like a game client without any graphics.
+//
+// It registers with a ship, flies in a circle, sends its input at a fixed rate
+// and acknowledges the world snapshots like the real client does,
+// so the server has the same work to do as with real players.
+//
+class SpaceGame_Bot : public olc::net::client_interface<NetMsg> {
+public:
+
+	SpaceGame_Bot(uint32_t index) : olc::net::client_interface<NetMsg>(BOTS_INCOMING_QUEUE), m_Index(index) {
+
+		m_Dispatcher.context().m_SnapshotHistory = &m_SnapshotHistory;
+
+		// Spread the bots on a grid, so the areas of interest overlap partly.
+		m_CenterX = (float)(index % 16) * BOTS_SPACING - 8 * BOTS_SPACING;
+		m_CenterY = (float)(index / 16) * BOTS_SPACING - 8 * BOTS_SPACING;
+		m_AngularSpeed = 0.5f + 0.1f * (float)(index % 7);
+	}
+
+
+	// Process everything the server sent since the last call.
+	// Measured round trip times in milliseconds are appended to "rtt".
+	//
+	void onUpdate(float time, std::vector<float>& rtt) {
+
+		while (!Incoming().empty()) {
+
+			auto msg = Incoming().pop_front().msg;
+
+			m_Dispatcher.dispatch(*this, msg, time, rtt);
+
+			Pool().release(std::move(msg));
+		}
+	}
+
+
+
+	// Handlers of the messages the server sends, called by "onUpdate" through the dispatcher.
+	//
+	void handle(const AcceptedPayload& accepted, float, std::vector<float>&) {
+
+		if (accepted.m_ProtocolVersion != protocolVersion()) {
+
+			std::cout << "Bot " << m_Index << ": server speaks another protocol version." << std::endl;
+			Disconnect();
+			return;
+		}
+
+
+		// Register with a ship, each bot takes another one.
+		// The server places it, our own player comes with the players around us.
+		RegisterPayload registration;
+		registration.m_Player.m_PlayerShip = (PlayerDescription::PlayerRepresentation)(m_Index % 4);
+
+		Send(makeMessage(Pool(), registration));
+	}
+
+
+	void handle(const AssignIDPayload& assign, float, std::vector<float>&) {
+
+		m_PlayerID = assign.m_PlayerID;
+	}
+
+
+	void handle(const AddPlayerPayload& add, float, std::vector<float>&) {
+
+		if (add.m_Player.m_PlayerNetworkID == m_PlayerID) _join(add.m_Player);
+	}
+
+
+	void handle(const AddPlayersPayload& add, float, std::vector<float>&) {
+
+		// When joining, our own player comes with everyone around us.
+		for (const auto& desc : add.m_Players) {
+
+			if (desc.m_PlayerNetworkID == m_PlayerID) _join(desc);
+		}
+	}
+
+
+	void handle(const WorldSnapshotPayload& snapshot, float, std::vector<float>&) {
+
+		// Acknowledge like the client, so the server sends deltas.
+		AckSnapshotPayload ack;
+		ack.m_Tick = snapshot.m_Decoded ? snapshot.m_Tick : 0;
+		SendDatagramState(makeMessage(Pool(), ack), stateKey(NetMsg::Client_AckSnapshot));
+
+		if (snapshot.m_Decoded) storeSnapshot(m_SnapshotHistory, snapshot.m_Tick, snapshot.m_Players);
+	}
+
+
+	void handle(const PingPayload& ping, float, std::vector<float>& rtt) {
+
+		// The server echoes the time we sent.
+		rtt.push_back((float)(nowMicroseconds() - ping.m_ClientTime) / 1000.0f);
+	}
+
+
+	// Send the input steering towards the velocity on the circle.
+	// Like the client, the bot moves its ship with the input itself, the server does the same.
+	//
+	void sendUpdate(float time, float dt) {
+
+		if (!m_Registered) return;
+
+		PlayerDescription target = _scriptedState(time);
+
+		// The acceleration reaching the target velocity after the input, against the damping, see "_simulateAxis".
+		// The duration is the one the input carries, in whole milliseconds.
+		const float step = (float)makePlayerInput(0, 0.0f, 0.0f, 0.0f, false, dt).m_DeltaTimeMs / 1000.0f;
+		const float decay = std::exp(-g_VelocityDamping * step);
+		const float scale = g_VelocityDamping / (1.0f - decay) / g_ShipAcceleration;
+
+		float moveX = (target.m_PlayerVelocityX - m_Player.m_PlayerVelocityX * decay) * scale;
+		float moveY = (target.m_PlayerVelocityY - m_Player.m_PlayerVelocityY * decay) * scale;
+
+		float turn = target.m_PlayerRotation - m_Player.m_PlayerRotation;
+		turn -= 6.28318530718f * std::round(turn / 6.28318530718f);
+		turn /= g_ShipTurnRate * step;
+
+		PlayerInput input = makePlayerInput(++m_InputSequence, moveX, moveY, turn, false, dt);
+		simulatePlayer(m_Player, input);
+
+		m_Inputs.push_back(input);
+		if (m_Inputs.size() > g_InputRedundancy) m_Inputs.pop_front();
+
+		m_Input.m_Inputs.assign(m_Inputs.begin(), m_Inputs.end());
+		SendDatagram(makeMessage(Pool(), m_Input));
+	}
+
+
+	// Pings go over the reliable channel, like everything but the state updates.
+	void sendPing() {
+
+		PingPayload ping;
+		ping.m_ClientTime = nowMicroseconds();
+		Send(makeMessage(Pool(), ping));
+	}
+
+
+	bool isRegistered() const { return m_Registered; }
+
+
+private:
+
+	uint32_t m_Index = 0;
+	uint32_t m_PlayerID = 0;
+	bool m_Registered = false;
+
+
+	// Scripted movement.
+	float m_CenterX = 0.0f;
+	float m_CenterY = 0.0f;
+	float m_AngularSpeed = 0.0f;
+
+
+	PlayerSnapshotHistory m_SnapshotHistory;
+	MessageDispatcher<SpaceGame_Bot, float, std::vector<float>&> m_Dispatcher;
+
+
+	// Own ship as moved by the inputs, and the newest inputs sent.
+	PlayerDescription m_Player;
+	uint32_t m_InputSequence = 0;
+	std::deque<PlayerInput> m_Inputs;
+	InputPayload m_Input;
+
+
+private:
+
+	// Our own player as the server spawned it, the inputs move it from there.
+	void _join(const PlayerDescription& desc) {
+
+		m_Player = desc;
+		m_Registered = true;
+	}
+
+
+	// Position, velocity and heading on the circle at given time.
+	PlayerDescription _scriptedState(float time) {
+
+		float angle = m_AngularSpeed * time + (float)m_Index;
+
+		PlayerDescription desc;
+		desc.m_PlayerPositionX = m_CenterX + BOTS_ORBIT * std::cos(angle);
+		desc.m_PlayerPositionY = m_CenterY + BOTS_ORBIT * std::sin(angle);
+		desc.m_PlayerVelocityX = -BOTS_ORBIT * m_AngularSpeed * std::sin(angle);
+		desc.m_PlayerVelocityY = BOTS_ORBIT * m_AngularSpeed * std::cos(angle);
+		desc.m_PlayerRotation = std::atan2(desc.m_PlayerVelocityY, desc.m_PlayerVelocityX);
+
+		return desc;
+	}
+};
+
+
+
+
+int main(int argc, char** argv) {
+
+	using namespace std;
+
+
+	int botCount = (argc > 1) ? atoi(argv[1]) : BOTS_COUNT;
+	if (botCount <= 0) botCount = BOTS_COUNT;
+
+	int updateRate = (argc > 2) ? atoi(argv[2]) : BOTS_UPDATE_RATE;
+	if (updateRate <= 0) updateRate = BOTS_UPDATE_RATE;
+
+	int duration = (argc > 3) ? atoi(argv[3]) : BOTS_DURATION;
+	if (duration <= 0) duration = BOTS_DURATION;
+
+	string csvPath = (argc > 4) ? argv[4] : BOTS_CSV;
+	string host = (argc > 5) ? argv[5] : BOTS_SERVER_HOST;
+
+	int port = (argc > 6) ? atoi(argv[6]) : BOTS_SERVER_PORT;
+	if (port <= 0) port = BOTS_SERVER_PORT;
+
+
+	ofstream csv(csvPath);
+	if (!csv.is_open()) {
+
+		cout << "Could not open \"" << csvPath << "\"." << endl;
+		return 1;
+	}
+
+	csv << "time_s,bots_connected,bots_registered,msgs_out_per_s,msgs_in_per_s,bytes_out_per_s,bytes_in_per_s,rtt_samples,rtt_p50_ms,rtt_p90_ms,rtt_p99_ms,rtt_max_ms" << endl;
+
+
+	cout << "Starting " << botCount << " bots against \"" << host << "\":\"" << port << "\", "
+		<< updateRate << " updates per second, for " << duration << " seconds." << endl;
+
+
+	// Each bot has its own connection and network thread, like a real client.
+	vector<unique_ptr<SpaceGame_Bot>> bots;
+	for (int i = 0; i < botCount; i++) {
+
+		// Like the client, everything a bot sends in a frame goes out together.
+		olc::net::connection_options options;
+		options.bManualFlush = true;
+		options.vecMaxMessageSizes = messageSizeLimits();
+
+		bots.push_back(make_unique<SpaceGame_Bot>(i));
+		bots.back()->SetConnectionOptions(options);
+		if (!bots.back()->Connect(host, (uint16_t)port, true)) {
+
+			cout << "Bot " << i << " could not connect." << endl;
+		}
+	}
+
+
+	// Report of one interval, or of the whole run.
+	auto report = [&](const string& label, float seconds, const olc::net::connection_stats& traffic, vector<float>& rtt) {
+
+		int connected = 0, registered = 0;
+		for (auto& bot : bots) {
+
+			if (bot->IsConnected()) connected++;
+			if (bot->isRegistered()) registered++;
+		}
+
+		sort(rtt.begin(), rtt.end());
+
+		csv << label << "," << connected << "," << registered << ","
+			<< traffic.nMessagesOut / seconds << "," << traffic.nMessagesIn / seconds << ","
+			<< traffic.nBytesOut / seconds << "," << traffic.nBytesIn / seconds << ","
+			<< rtt.size() << "," << percentile(rtt, 0.5f) << "," << percentile(rtt, 0.9f) << ","
+			<< percentile(rtt, 0.99f) << "," << (rtt.empty() ? 0.0f : rtt.back()) << endl;
+
+		cout << "[" << label << "] " << registered << "/" << botCount << " bots in game, "
+			<< traffic.nMessagesOut / seconds << " msgs/s out, " << traffic.nMessagesIn / seconds << " msgs/s in, "
+			<< traffic.nBytesOut / seconds << " B/s out, " << traffic.nBytesIn / seconds << " B/s in, "
+			<< "rtt p50 " << percentile(rtt, 0.5f) << " ms p99 " << percentile(rtt, 0.99f) << " ms." << endl;
+	};
+
+
+	auto totalTraffic = [&]() {
+
+		olc::net::connection_stats total;
+		for (auto& bot : bots) {
+
+			auto stats = bot->GetStats();
+			total.nBytesIn += stats.nBytesIn;
+			total.nBytesOut += stats.nBytesOut;
+			total.nMessagesIn += stats.nMessagesIn;
+			total.nMessagesOut += stats.nMessagesOut;
+		}
+
+		return total;
+	};
+
+
+	// Fixed rate loop, like the server.
+	// Each frame every bot handles what it received and sends its state.
+	//
+	const auto frameDuration = chrono::microseconds(1000000 / updateRate);
+	const int framesPerPing = max(1, updateRate / BOTS_PING_RATE);
+	const auto start = chrono::steady_clock::now();
+	auto nextFrame = start;
+	auto nextReport = start + chrono::seconds(1);
+
+	olc::net::connection_stats lastTraffic;
+	vector<float> rttInterval;
+	vector<float> rttAll;
+	int second = 0;
+	uint64_t frame = 0;
+	float lastTime = 0.0f;
+
+	while (second < duration) {
+
+		nextFrame += frameDuration;
+
+		float time = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+		float dt = time - lastTime;
+		lastTime = time;
+		bool ping = (frame++ % framesPerPing) == 0;
+
+		for (auto& bot : bots) {
+
+			bot->onUpdate(time, rttInterval);
+			bot->sendUpdate(time, dt);
+			if (ping) bot->sendPing();
+			bot->Flush();
+		}
+
+
+		if (chrono::steady_clock::now() >= nextReport) {
+
+			nextReport += chrono::seconds(1);
+			second++;
+
+			auto traffic = totalTraffic();
+			olc::net::connection_stats interval;
+			interval.nBytesIn = traffic.nBytesIn - lastTraffic.nBytesIn;
+			interval.nBytesOut = traffic.nBytesOut - lastTraffic.nBytesOut;
+			interval.nMessagesIn = traffic.nMessagesIn - lastTraffic.nMessagesIn;
+			interval.nMessagesOut = traffic.nMessagesOut - lastTraffic.nMessagesOut;
+			lastTraffic = traffic;
+
+			rttAll.insert(rttAll.end(), rttInterval.begin(), rttInterval.end());
+			report(to_string(second), 1.0f, interval, rttInterval);
+			rttInterval.clear();
+		}
+
+
+		// Falling behind means the bots are the bottleneck, not the server.
+		auto now = chrono::steady_clock::now();
+		if (now > nextFrame) {
+
+			nextFrame = now;
+		}
+		else {
+
+			this_thread::sleep_until(nextFrame);
+		}
+	}
+
+
+	float seconds = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+	report("total", seconds, totalTraffic(), rttAll);
+
+	cout << "Report written to \"" << csvPath << "\"." << endl;
+
+
+	for (auto& bot : bots) bot->Disconnect();
+
+	return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// The bots only talk to the server.
+// No window, no GPU and no Steam, so only the network part of the engine is included.
+//
+#include"NetworkMessages.h"
+#include"NetworkEncoding.h"
+#include"NetworkSnapshot.h"
+#include"NetworkPrediction.h"
+#include"NetworkRegistry.h"
+
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<algorithm>
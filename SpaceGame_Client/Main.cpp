@@ -1,6 +1,9 @@
 #include"Main.h"
 
 #define SERVER_PORT 7777
+#define CLIENT_INTERPOLATION_DELAY 0.1f // Seconds remote ships are rendered behind the newest snapshot.
+#define CLIENT_MAX_EXTRAPOLATION 0.25f // Seconds remote ships are moved on when snapshots are missing.
+#define CLIENT_PING_INTERVAL 250000 // Microseconds between two pings measuring the round trip time.
 
 void SpaceGame_Client::onUpdate(float dt) {
 
@@ -14,379 +17,364 @@ void SpaceGame_Client::onUpdate(float dt) {
 		cout << color(colors::YELLOW);
 		cout << "Network update..." << white << endl;
 
-		uint32_t id = 0;
+		// Measure the network latency.
+		// The server echoes our clock with his own, see "LatencyEstimator".
+		//
+		uint64_t now = monotonicMicroseconds();
+		if (now >= m_NextPing) {
 
+			m_NextPing = now + CLIENT_PING_INTERVAL;
 
-		// We have connected. So start to count the network latency.
-		m_Timer->startTimer();
+			PingPayload ping;
+			ping.m_ClientTime = now;
+			Send(makeMessage(Pool(), ping));
+		}
 
 
+		// Each message goes to its "handle".
 		while (!Incoming().empty()) {
 
 			auto msg = Incoming().pop_front().msg;
 
+			m_Dispatcher.dispatch(*this, msg);
 
+			// Done with the message, give it back for reuse.
+			Pool().release(std::move(msg));
+		}
+	}
 
-			// Store how long we needed to get the next message, aka Ping.
-			float ping = (float)m_Timer->getElapsedTime();
-			cout << color(colors::RED);
-			cout << "Ping: " << ping << white << endl;
-			m_LastPing = ping;
-			m_PingQueue.push_back(ping);
-			m_Timer->startTimer();
-
-
-			if (msg.header.id == NetMsg::Client_Accepted) {
-
-				cout << color(colors::DARKMAGENTA);
-				cout << "Network Message: \"Client_Accepted\"" << endl;
-
-				// Register ourselves in the server,
-				// by sending him our own player description.
-				//
-				message<NetMsg> outMsg;
-				outMsg.header.id = NetMsg::Client_RegisterWithServer;
-
-				// Send initial data of our space ship to the server.
-				int ship = 0;
-				cout << color(colors::WHITE);
-				cout << "Choose your ship: 0 - 3" << white << endl;
-				cin >> ship;
-				if (ship == 0 || ship > 3) {
-
-					m_PlayerDesc.m_PlayerShip = PlayerDescription::PlayerRepresentation::Fighter;
-					m_PlayerDesc.m_PlayerArmor = 10;
-					m_PlayerDesc.m_PlayerHealth = 10;
-					m_PlayerDesc.m_PlayerPositionX = 1.0f;
-					m_PlayerDesc.m_PlayerPositionY = 1.0f;
-					m_PlayerDesc.m_PlayerRotation = 0.0f;
-				}
-				else if (ship == 1) {
-
-					m_PlayerDesc.m_PlayerShip = PlayerDescription::PlayerRepresentation::Juggernaut;
-					m_PlayerDesc.m_PlayerArmor = 35;
-					m_PlayerDesc.m_PlayerHealth = 15;
-					m_PlayerDesc.m_PlayerPositionX = 1.0f;
-					m_PlayerDesc.m_PlayerPositionY = 1.0f;
-					m_PlayerDesc.m_PlayerRotation = 0.0f;
-
-				}
-				else if (ship == 2) {
-
-					m_PlayerDesc.m_PlayerShip = PlayerDescription::PlayerRepresentation::Raider;
-					m_PlayerDesc.m_PlayerArmor = 15;
-					m_PlayerDesc.m_PlayerHealth = 15;
-					m_PlayerDesc.m_PlayerPositionX = 1.0f;
-					m_PlayerDesc.m_PlayerPositionY = 1.0f;
-					m_PlayerDesc.m_PlayerRotation = 0.0f;
-
-				}
-				else if (ship == 3) {
-
-					m_PlayerDesc.m_PlayerShip = PlayerDescription::PlayerRepresentation::Interceptor;
-					m_PlayerDesc.m_PlayerArmor = 5;
-					m_PlayerDesc.m_PlayerHealth = 10;
-					m_PlayerDesc.m_PlayerPositionX = 1.0f;
-					m_PlayerDesc.m_PlayerPositionY = 1.0f;
-					m_PlayerDesc.m_PlayerRotation = 0.0f;
-
-				}
-
-				outMsg << m_PlayerDesc;
-				Send(outMsg);
-			}
 
 
-			else if (msg.header.id == NetMsg::Client_AssignID) {
+	if (m_WaitingForConnection) {
 
-				cout << color(colors::DARKMAGENTA);
-				cout << "Network Message: \"Client_AssignID\"" << endl;
+		// Send the acknowledgements and the registration.
+		Flush();
+		return;
+	}
 
-				msg >> id;
-				m_PlayerID = id; // Server assigned us our Network GUID.
-			}
 
+	// Update the clients ship position etc. based on its networked entity.
+	using namespace nautilus::graphics;
+	using namespace nautilus;
 
-			else if (msg.header.id == NetMsg::Game_AddPlayer) {
 
-				cout << color(colors::DARKMAGENTA);
-				cout << "Network Message: \"Game_AddPlayer\"" << endl;
 
-				// Update or insert a player in the lobby.
-				//
-				PlayerDescription desc;
-				msg >> desc;
-				m_PlayerLobby.insert_or_assign(desc.m_PlayerNetworkID, desc);
+	// Do the device input update.
+	using namespace nautilus::hid;
 
+	// Here we check for gamepad, because we know that a gamepad is connected.
+	// The keys are added on top, so both can be used.
+	//
+	float x_axis_dt = m_HIDManager->getButtonValue(Button::Move_Left_Float);
+	float y_axis_dt = m_HIDManager->getButtonValue(Button::Move_Up_Float);
+	float rotation = m_HIDManager->getButtonValue(Button::Turn_Left_Float);
 
-				if (desc.m_PlayerNetworkID == m_PlayerID)
-				{
+	float moveX = x_axis_dt; // the delta value is positive if we press stick to rght, else negative
+	float moveY = y_axis_dt; // same here, values are plus or minus...
+	float turn = -rotation / 3.141f;
 
-					// Now we exist in game world
-					m_WaitingForConnection = false;
-				}
+	if (m_HIDManager->isButtonHeld(Button::Move_Down)) moveY -= 1.0f;
+	if (m_HIDManager->isButtonHeld(Button::Move_Up)) moveY += 1.0f;
+	if (m_HIDManager->isButtonHeld(Button::Move_Right)) moveX += 1.0f;
+	if (m_HIDManager->isButtonHeld(Button::Move_Left)) moveX -= 1.0f;
+	if (m_HIDManager->isButtonHeld(Button::Turn_Right)) turn -= 0.3f;
+	if (m_HIDManager->isButtonHeld(Button::Turn_Left)) turn += 0.3f;
 
 
-				// Create a representation for 
-				// new added player.
-				if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Fighter) {
+	// We do not send our state to the server, but the input of this frame.
+	// The server moves our ship with it and is the authority.
+	//
+	// Waiting for the server to move us would feel laggy, so we apply the input right away
+	// to our own ship too and remember it, until the server tells us he applied it.
+	// See "_reconcile".
+	//
+	PlayerInput input = makePlayerInput(++m_InputSequence, moveX, moveY, turn, m_HIDManager->isButtonPressed(Button::Confirm), ImGui::GetIO().DeltaTime);
 
-					// Populate current scene with object...
-					std::string network_id = std::to_string(desc.m_PlayerNetworkID);
-					if (m_SceneManager->populateActiveScene("Ship_" + network_id, "ship_wasp_class.png")) {
+	simulatePlayer(m_PlayerLobby[m_PlayerID], input);
 
-					}
-				}
-				else if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Juggernaut) {
+	m_PendingInputs.push_back(input);
+	if (m_PendingInputs.size() > g_InputHistorySize) m_PendingInputs.pop_front();
 
-					// Populate current scene with object...
-					std::string network_id = std::to_string(desc.m_PlayerNetworkID);
-					if (m_SceneManager->populateActiveScene("Ship_" + network_id, "spaceShips_005.png")) {
 
-					}
-				}
-				else if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Raider) {
+	// Inputs are sent as datagrams, each with the newest few inputs,
+	// so a lost datagram is covered by the next one.
+	//
+	auto firstInput = m_PendingInputs.end() - std::min<size_t>(m_PendingInputs.size(), g_InputRedundancy);
+	m_Input.m_Inputs.assign(firstInput, m_PendingInputs.end());
+	SendDatagram(makeMessage(Pool(), m_Input));
 
-					// Populate current scene with object...
-					std::string network_id = std::to_string(desc.m_PlayerNetworkID);
-					if (m_SceneManager->populateActiveScene("Ship_" + network_id, "spaceShips_002.png")) {
 
-					}
-				}
-				else if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Interceptor) {
+	// Acknowledgements, input and anything else sent this frame go out together.
+	Flush();
 
-					// Populate current scene with object...
-					std::string network_id = std::to_string(desc.m_PlayerNetworkID);
-					if (m_SceneManager->populateActiveScene("Ship_" + network_id, "enemyRed3.png")) {
 
-					}
-				}
-			}
 
 
-			else if (msg.header.id == NetMsg::Game_RemovePlayer) {
+	// Update the positions and data of the ships on the client side,
+	// according to those on the server side.
+	//
+	// Iterate over every ship in the Lobby.
+	//
+	// Remote ships are rendered a little in the past, interpolated between the snapshots
+	// around that time, so they move smoothly even if snapshots arrive unevenly or get lost.
+	//
+	double renderTime = m_ServerClock.serverTime(_localTime()) - CLIENT_INTERPOLATION_DELAY;
 
-				cout << color(colors::DARKMAGENTA);
-				cout << "Network Message: \"Game_RemovePlayer\"" << endl;
+	for (auto& it : m_PlayerLobby) {
 
-				msg >> id;
-				m_PlayerLobby.erase(id);
-			}
+		using namespace std;
+		cout << color(colors::CYAN);
+		cout << "Client Rendering Update: " << it.first << endl;
+		//if (m_PlayerID == it.first) {
+		//	cout << "Skipping local client player..." << white << endl;
+		//	continue;
+		//}
 
 
-			else if (msg.header.id == NetMsg::Game_UpdatePlayer) {
+		// Get the associated entity with the iterated networked player.
+		//
+		std::string handle = "Ship_" + std::to_string(it.first);
+		Ref<CEntity> entity = m_SceneManager->getSceneEntity(handle);
 
-				cout << color(colors::DARKMAGENTA);
-				cout << "Network Message: \"Game_UpdatePlayer\"" << endl;
 
-				PlayerDescription desc;
-				msg >> desc;
+		// Our own ship was moved already by the prediction.
+		// A remote ship without any snapshot yet stays where "Game_AddPlayer" put it.
+		//
+		PlayerDescription state = it.second;
 
-				// Try to avoid Bug.
-				// We dont want to update own client player entity.
-				//
-				if (desc.m_PlayerNetworkID == m_PlayerID) break;
+		if (m_PlayerID != it.first) {
 
+			auto states = m_RemoteStates.find(it.first);
+			if (states != m_RemoteStates.end()) states->second.sample(renderTime, CLIENT_MAX_EXTRAPOLATION, state);
+		}
 
-				m_PlayerLobby.insert_or_assign(desc.m_PlayerNetworkID, desc);
-			}
 
-		}
+		// Rendering position.
+		// position for rendering as defined in networked position
+		auto& transform = entity->getComponent<ComponentTransform>();
+		transform.m_Position = glm::vec2(state.m_PlayerPositionX, state.m_PlayerPositionY);
+		transform.m_Rotation = state.m_PlayerRotation;
 	}
+}
 
 
 
-	if (m_WaitingForConnection) {
-		return;
-	}
-
 
-	// Update the clients ship position etc. based on its networked entity.
-	using namespace nautilus::graphics;
-	using namespace nautilus;
 
+// Handlers of the messages the server sends, called by "onUpdate" through the dispatcher.
+// See "NetworkRegistry.h" for the payloads.
+//
+void SpaceGame_Client::handle(const nautilus::network::PingPayload& ping) {
 
+	using namespace nautilus::network;
 
-	// We have to check for input here, 
-	// as if we updated our own client before this point and did not press any button
-	// it will just stay unnoticed IF WE PRESS any button, because it will be nulled out
-	// by the server update, which says we havent pressed anything/ changed velocity...
-	//
-	// THIS IS A BUG! Obviously.
-	//
-	// So how can we detect input change if we cannot do it here but have to rely on "EventManager" and "InputHandler" in
-	// theyre own separate threads?
-	//
-	// Well, one possible solution is not to let the server update ourselves.
-	// As we update everything here and send the server the data for updating,
-	// is seems an overhead to try to update the data we have in place...
-	//
+	m_Latency.addSample(ping.m_ClientTime, ping.m_ServerTime, monotonicMicroseconds());
 
+	// Align the snapshots with the measured server clock.
+	m_ServerClock.synchronize(m_Latency.getClockOffset());
+}
 
-	// Do the device input update.
-	using namespace nautilus::hid;
-	int frames = 2;
 
-	// Here we check for gamepad, because we know that a gamepad is connected.
-	// If we want to register same input for keys, then we have to check the values and
-	// apply our velocity change input...
-	//
+void SpaceGame_Client::handle(const nautilus::network::AcceptedPayload& accepted) {
 
-	float x_axis_dt = m_HIDManager->getButtonValue(Button::Move_Left_Float);
-	float y_axis_dt = m_HIDManager->getButtonValue(Button::Move_Up_Float);
-	float rotation = m_HIDManager->getButtonValue(Button::Turn_Left_Float);
+	using namespace std;
+	using namespace nautilus::network;
 
-	if (x_axis_dt != 0.0f) {
+	cout << color(colors::DARKMAGENTA);
+	cout << "Network Message: \"Client_Accepted\"" << endl;
 
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityX += x_axis_dt; // the delta value is positive if we press stick to rght, else negative
+	if (accepted.m_ProtocolVersion != protocolVersion()) {
 
+		cout << color(colors::RED);
+		cout << "Server speaks another protocol version, update the game." << white << endl;
+		Disconnect();
+		return;
 	}
-	if (y_axis_dt != 0.0f) {
 
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityY += y_axis_dt; // same here, values are plus or minus...
+	m_ServerTickRate = accepted.m_TickRate;
 
-	}
-	if (rotation != 0.0f) {
 
-		m_PlayerLobby[m_PlayerID].m_PlayerRotation -= rotation / 3.141f;
-	}
+	// Register ourselves in the server,
+	// by sending him the ship we want.
+	//
+	// Only the ship is ours to choose, the server places it and sets its health and armor.
+	// We get our player like everyone else around us, with "Game_AddPlayers".
+	int ship = 0;
+	cout << color(colors::WHITE);
+	cout << "Choose your ship: 0 - 3" << white << endl;
+	cin >> ship;
+	if (ship < 0 || ship > 3) ship = 0;
+
+	m_PlayerDesc.m_PlayerShip = (PlayerDescription::PlayerRepresentation)ship;
+
+	RegisterPayload registration;
+	registration.m_Player = m_PlayerDesc;
+	Send(makeMessage(Pool(), registration));
+}
 
-	if (m_HIDManager->isButtonPressed(Button::Confirm)) {
-		
-		m_PlayerLobby[m_PlayerID].m_PlayerRotation += (1.5708f * 2);
-	}
 
-	if (m_HIDManager->isButtonHeld(Button::Move_Down)) {
+void SpaceGame_Client::handle(const nautilus::network::AssignIDPayload& assign) {
 
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityY -= 1.0f;
+	using namespace std;
 
-	}
-	if (m_HIDManager->isButtonHeld(Button::Move_Up)) {
+	cout << color(colors::DARKMAGENTA);
+	cout << "Network Message: \"Client_AssignID\"" << endl;
 
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityY += 1.0f;
-	}
-	if (m_HIDManager->isButtonHeld(Button::Move_Right)) {
+	m_PlayerID = assign.m_PlayerID; // Server assigned us our Network GUID.
+}
 
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityX += 1.0f;
 
-	}
-	if (m_HIDManager->isButtonHeld(Button::Move_Left)) {
+void SpaceGame_Client::handle(const nautilus::network::AddPlayerPayload& add) {
 
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityX -= 1.0f;
+	using namespace std;
 
-	}
-	if (m_HIDManager->isButtonHeld(Button::Turn_Right)) {
+	cout << color(colors::DARKMAGENTA);
+	cout << "Network Message: \"Game_AddPlayer\"" << endl;
 
-		m_PlayerLobby[m_PlayerID].m_PlayerRotation -= 0.3f;
-	}
-	if (m_HIDManager->isButtonHeld(Button::Turn_Left)) {
+	_addPlayer(add.m_Player);
+}
 
-		m_PlayerLobby[m_PlayerID].m_PlayerRotation += 0.3f;
-	}
 
+void SpaceGame_Client::handle(const nautilus::network::AddPlayersPayload& add) {
 
+	using namespace std;
 
+	cout << color(colors::DARKMAGENTA);
+	cout << "Network Message: \"Game_AddPlayers\"" << endl;
 
-	// Update the positions and data of the ships on the client side,
-	// according to those on the server side.
+	// All players entering our area of interest in one tick,
+	// when joining this is everyone around us.
 	//
-	// Iterate over every ship in the Lobby.
-	//
-	for (auto& it : m_PlayerLobby) {
+	for (const auto& desc : add.m_Players) _addPlayer(desc);
+}
 
-		using namespace std;
-		cout << color(colors::CYAN);
-		cout << "Client Rendering Update: " << it.first << endl;
-		//if (m_PlayerID == it.first) {
-		//	cout << "Skipping local client player..." << white << endl;
-		//	continue;
-		//}
 
+void SpaceGame_Client::handle(const nautilus::network::RemovePlayerPayload& remove) {
 
-		// Get the associated entity with the iterated networked player.
-		//
-		std::string handle = "Ship_" + std::to_string(it.first);
-		Ref<CEntity> entity = m_SceneManager->getSceneEntity(handle);
+	using namespace std;
 
+	cout << color(colors::DARKMAGENTA);
+	cout << "Network Message: \"Game_RemovePlayer\"" << endl;
 
-		// Dead Reckoning.
-		// Try to predict the movement of the player.
-		// 
-		float dt = ImGui::GetIO().DeltaTime; // How long did we need for one frame, that is from last time we were here to now.
-		float latency = 1 / 100.0f; // Simulate networking latency with constant 100ms.
+	m_PlayerLobby.erase(remove.m_PlayerID);
+	m_RemoteStates.erase(remove.m_PlayerID);
 
-		float potentialX = it.second.m_PlayerPositionX + it.second.m_PlayerVelocityX * dt;
-		float potentialY = it.second.m_PlayerPositionY + it.second.m_PlayerVelocityY * dt;
+	// The ship is created again if the player comes back into our area of interest.
+	m_SceneManager->destroySceneEntity("Ship_" + std::to_string(remove.m_PlayerID));
+}
 
 
-		// Rendering position.
-		// position for rendering as defined in networked position
-		auto& transform = entity->getComponent<ComponentTransform>();
-		transform.m_Position = glm::vec2(potentialX, potentialY);
-		transform.m_Rotation = it.second.m_PlayerRotation;
+void SpaceGame_Client::handle(const nautilus::network::WorldSnapshotPayload& snapshot) {
 
+	using namespace std;
+	using namespace nautilus::network;
 
+	cout << color(colors::DARKMAGENTA);
+	cout << "Network Message: \"Game_WorldSnapshot\"" << endl;
 
+	// The server sends once per tick the state of all players,
+	// delta compressed against the last snapshot we acknowledged.
+	//
+	// Acknowledge the snapshot, so the server can send the next one as delta to it.
+	// If we do not have the baseline anymore, request a full state by acknowledging nothing.
+	// Only the newest acknowledgement matters, it replaces an older one not yet sent.
+	//
+	AckSnapshotPayload ack;
+	ack.m_Tick = snapshot.m_Decoded ? snapshot.m_Tick : 0;
+	SendDatagramState(makeMessage(Pool(), ack), stateKey(NetMsg::Client_AckSnapshot));
 
-		// Network position.
-		//
-		// We want to update the position only for our client,
-		// because other clients will do the same in theyre instance.
+	if (!snapshot.m_Decoded) return;
+
+	storeSnapshot(m_SnapshotHistory, snapshot.m_Tick, snapshot.m_Players);
+
+
+	// Server time of the snapshot, used to render the remote ships smoothly.
+	double serverTime = (double)snapshot.m_Tick / (double)std::max(m_ServerTickRate, 1u);
+	m_ServerClock.update(serverTime, _localTime());
+
+
+	for (const auto& desc : snapshot.m_Players) {
+
+		// Our own player is predicted, the server state is only the starting point
+		// for replaying the inputs the server did not apply yet.
 		//
-		if (m_PlayerID == it.first) {
+		if (desc.m_PlayerNetworkID == m_PlayerID) {
 
-			it.second.m_PlayerPositionX = potentialX;
-			it.second.m_PlayerPositionY = potentialY;
+			_reconcile(desc, snapshot.m_InputSequence);
+			continue;
 		}
+
+
+		// Snapshots arrive as datagrams and may overtake the reliable "Game_AddPlayer".
+		// Only update players we already know about, so each has a scene entity.
+		//
+		auto player = m_PlayerLobby.find(desc.m_PlayerNetworkID);
+		if (player == m_PlayerLobby.end()) continue;
+
+		player->second = desc;
+		m_RemoteStates[desc.m_PlayerNetworkID].push(serverTime, desc);
 	}
+}
 
 
 
 
-	// Send player description
-	// for this client instance.
-	//
-	// Other client instances will do the same.
-	//
-	PlayerDescription desc;
-	desc.m_PlayerArmor = m_PlayerLobby[m_PlayerID].m_PlayerArmor;
-	desc.m_PlayerHealth = m_PlayerLobby[m_PlayerID].m_PlayerHealth;
-	desc.m_PlayerPositionX = m_PlayerLobby[m_PlayerID].m_PlayerPositionX;
-	desc.m_PlayerPositionY = m_PlayerLobby[m_PlayerID].m_PlayerPositionY;
-	desc.m_PlayerNetworkID = m_PlayerLobby[m_PlayerID].m_PlayerNetworkID;
-	desc.m_PlayerShip = m_PlayerLobby[m_PlayerID].m_PlayerShip;
-	desc.m_PlayerVelocityX = m_PlayerLobby[m_PlayerID].m_PlayerVelocityX;
-	desc.m_PlayerVelocityY = m_PlayerLobby[m_PlayerID].m_PlayerVelocityY;
-	desc.m_PlayerRotation = m_PlayerLobby[m_PlayerID].m_PlayerRotation;
+// Update or insert a player in the lobby and give him an entity in the scene.
+//
+void SpaceGame_Client::_addPlayer(const nautilus::network::PlayerDescription& desc) {
 
+	using namespace nautilus::network;
 
-	cout << color(colors::CYAN);
-	cout << "Ship Rotation: " << desc.m_PlayerRotation << white << endl;
 
-	olc::net::message<NetMsg> msg;
-	msg.header.id = NetMsg::Game_UpdatePlayer;
-	msg << desc;
-	Send(msg);
+	m_PlayerLobby.insert_or_assign(desc.m_PlayerNetworkID, desc);
 
 
+	if (desc.m_PlayerNetworkID == m_PlayerID)
+	{
 
-	// Normalize velocity of player...
-	if (m_PlayerLobby[m_PlayerID].m_PlayerVelocityX >= 0.0f) {
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityX = (m_PlayerLobby[m_PlayerID].m_PlayerVelocityX - 0.3f <= 0.0f) ? 0.0f : m_PlayerLobby[m_PlayerID].m_PlayerVelocityX - 0.3f;
+		// Now we exist in game world
+		m_WaitingForConnection = false;
 	}
-	else {
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityX = (m_PlayerLobby[m_PlayerID].m_PlayerVelocityX + 0.3f >= 0.0f) ? 0.0f : m_PlayerLobby[m_PlayerID].m_PlayerVelocityX + 0.3f;
+
+
+	// Create a representation for 
+	// new added player.
+	// A player we know already has one, "Game_AddPlayers" may name the same player again.
+	if (m_SceneManager->getSceneEntity("Ship_" + std::to_string(desc.m_PlayerNetworkID))) return;
+
+	if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Fighter) {
+
+		// Populate current scene with object...
+		std::string network_id = std::to_string(desc.m_PlayerNetworkID);
+		if (m_SceneManager->populateActiveScene("Ship_" + network_id, "ship_wasp_class.png")) {
+
+		}
 	}
-	if (m_PlayerLobby[m_PlayerID].m_PlayerVelocityY >= 0.0f) {
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityY = (m_PlayerLobby[m_PlayerID].m_PlayerVelocityY - 0.3f <= 0.0f) ? 0.0f : m_PlayerLobby[m_PlayerID].m_PlayerVelocityY - 0.3f;
+	else if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Juggernaut) {
+
+		// Populate current scene with object...
+		std::string network_id = std::to_string(desc.m_PlayerNetworkID);
+		if (m_SceneManager->populateActiveScene("Ship_" + network_id, "spaceShips_005.png")) {
+
+		}
 	}
-	else {
-		m_PlayerLobby[m_PlayerID].m_PlayerVelocityY = (m_PlayerLobby[m_PlayerID].m_PlayerVelocityY + 0.3f >= 0.0f) ? 0.0f : m_PlayerLobby[m_PlayerID].m_PlayerVelocityY + 0.3f;
+	else if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Raider) {
 
+		// Populate current scene with object...
+		std::string network_id = std::to_string(desc.m_PlayerNetworkID);
+		if (m_SceneManager->populateActiveScene("Ship_" + network_id, "spaceShips_002.png")) {
+
+		}
 	}
+	else if (desc.m_PlayerShip == PlayerDescription::PlayerRepresentation::Interceptor) {
 
-}
+		// Populate current scene with object...
+		std::string network_id = std::to_string(desc.m_PlayerNetworkID);
+		if (m_SceneManager->populateActiveScene("Ship_" + network_id, "enemyRed3.png")) {
 
+		}
+	}
+}
 
 
 
@@ -394,7 +382,17 @@ void SpaceGame_Client::onUpdate(float dt) {
 void SpaceGame_Client::onInit() {
 	using namespace std;
 
-	if (!Connect("127.0.0.1", SERVER_PORT)) {
+	// Everything sent during a frame goes out together at the end of "onUpdate".
+	olc::net::connection_options options;
+	options.bManualFlush = true;
+	options.bNoDelay = true;
+
+	// Nor does the server make us allocate more for a message than its payload may be.
+	options.vecMaxMessageSizes = messageSizeLimits();
+	SetConnectionOptions(options);
+
+	// Connect with datagrams, high frequency state is sent unreliably.
+	if (!Connect("127.0.0.1", SERVER_PORT, true)) {
 
 		cout << color(colors::RED);
 		cout << "Connection failed." << white << endl;
@@ -476,23 +474,12 @@ void sceneMain(nautilus::graphics::CScene* scene, nautilus::core::Event* eEvent)
 
 
 		auto& className = it.second->getComponent<ComponentClassName>();
-		if (COMPARE_STRINGS(className.m_ClassName, "CSprite") == 0) {
-
-			auto& transformCmp = it.second->getComponent<ComponentTransform>();
-			auto& memoryCmp = it.second->getComponent<ComponentMemoryProtocol2D>();
-			auto& colorCmp = it.second->getComponent<ComponentGraphics>();
-			auto& textureCmp = it.second->getComponent<ComponentTexture2D>();
-
-
-			glm::mat4 model_transform = glm::mat4(1.0f);
-			model_transform = glm::translate(model_transform, glm::vec3(transformCmp.m_Position, 1.0f)) * glm::rotate(model_transform, transformCmp.m_Rotation, glm::vec3(0.0f, 0.0f, 1.0f)) * glm::scale(model_transform, glm::vec3(transformCmp.m_Scale, 1.0f));
+		if (COMPARE_STRINGS(className.m_ClassName, "CSprite") == 0 || COMPARE_STRINGS(className.m_ClassName, "CAnimatedSprite") == 0) {
 
+			if (COMPARE_STRINGS(className.m_ClassName, "CAnimatedSprite") == 0) {
 
-			BatchRenderer2D::draw(&memoryCmp, model_transform, &textureCmp, colorCmp.m_Color);
-		}
-		else if (COMPARE_STRINGS(className.m_ClassName, "CAnimatedSprite") == 0) {
-
-			static_cast<CAnimatedSprite*>(it.second.get())->play(1 / 30.0f);
+				static_cast<CAnimatedSprite*>(it.second.get())->play(1 / 30.0f);
+			}
 
 			auto& transformCmp = it.second->getComponent<ComponentTransform>();
 			auto& memoryCmp = it.second->getComponent<ComponentMemoryProtocol2D>();
@@ -500,16 +487,20 @@ void sceneMain(nautilus::graphics::CScene* scene, nautilus::core::Event* eEvent)
 			auto& textureCmp = it.second->getComponent<ComponentTexture2D>();
 
 
-			glm::mat4 model_transform = glm::mat4(1.0f);
-			model_transform = glm::translate(model_transform, glm::vec3(transformCmp.m_Position, 1.0f)) * glm::rotate(model_transform, transformCmp.m_Rotation, glm::vec3(0.0f, 0.0f, 1.0f)) * glm::scale(model_transform, glm::vec3(transformCmp.m_Scale, 1.0f));
+			SpriteInstance sprite;
+			sprite.m_Position = transformCmp.m_Position;
+			sprite.m_Scale = transformCmp.m_Scale;
+			sprite.m_Rotation = transformCmp.m_Rotation;
+			sprite.m_Color = colorCmp.m_Color;
+			sprite.m_Texture = &textureCmp;
+			sprite.setTextureCoords(memoryCmp);
 
 
-			BatchRenderer2D::draw(&memoryCmp, model_transform, &textureCmp, colorCmp.m_Color);
-
+			// Drawn sorted with the other sprites, the particles come on top.
+			BatchRenderer2D::submit(sprite, RenderLayer::World);
 		}
 		else if (COMPARE_STRINGS(className.m_ClassName, "CParticleSystem") == 0) {
 
-
 			static_cast<CParticleSystem*>(it.second.get())->emit();
 			static_cast<CParticleSystem*>(it.second.get())->onRender(1 / 30.0f);
 		}
@@ -45,7 +45,7 @@ public:
 
 	SpaceGame_Client() {
 
-		m_Timer = new nautilus::HRTimer();
+		m_Dispatcher.context().m_SnapshotHistory = &m_SnapshotHistory;
 	}
 
 
@@ -65,11 +65,27 @@ public:
 		ImGui::Begin("Statistics");
 		ImGui::Text("Average %.3f ms/frame (%.1f FPS) ", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		ImGui::Text("%.3f Frametime --- %.3f ms/frame --- (%.3f FPS) ", m_FPSTimer->getAverageFrametime(), m_FPSTimer->getAverageMillisecondsPerFrame(), m_FPSTimer->getAverageFPS());
-		ImGui::Text("Average %.3f ping (%.1f last ping) ", _getAveragePing(), m_LastPing);
+		ImGui::Text("Round trip %.1f ms (%.1f ms last), jitter %.1f ms ", m_Latency.getRtt() * 1000.0, m_Latency.getLastRtt() * 1000.0, m_Latency.getJitter() * 1000.0);
+		ImGui::Text("Server clock offset %.3f s (%u samples) ", m_Latency.getClockOffset(), m_Latency.getSampleCount());
 		ImGui::End();
 	}
 
 
+	// Round trip time, jitter and server clock offset measured with "Server_GetPing".
+	const nautilus::network::LatencyEstimator& getLatency() const { return m_Latency; }
+
+
+
+	// Handlers of the messages the server sends, see "MessageDispatcher".
+	void handle(const nautilus::network::PingPayload& ping);
+	void handle(const nautilus::network::AcceptedPayload& accepted);
+	void handle(const nautilus::network::AssignIDPayload& assign);
+	void handle(const nautilus::network::AddPlayerPayload& add);
+	void handle(const nautilus::network::AddPlayersPayload& add);
+	void handle(const nautilus::network::RemovePlayerPayload& remove);
+	void handle(const nautilus::network::WorldSnapshotPayload& snapshot);
+
+
 
 	void onRender(float dt) override {
 
@@ -81,10 +97,8 @@ private:
 
 	// Network statistics related.
 	// Measuring Ping.
-	//std::vector<float> m_PingVec;
-	nautilus::core::tsqueue<float> m_PingQueue;
-	nautilus::HRTimer* m_Timer = nullptr;
-	float m_LastPing = 0.0f;
+	nautilus::network::LatencyEstimator m_Latency;
+	uint64_t m_NextPing = 0;
 
 
 
@@ -97,6 +111,29 @@ private:
 	std::unordered_map<uint32_t, nautilus::network::PlayerDescription> m_PlayerLobby;
 
 
+	// Calls the "handle" for each message received.
+	nautilus::network::MessageDispatcher<SpaceGame_Client> m_Dispatcher;
+
+
+	// Snapshots received from the server, needed to decode the delta compressed snapshots.
+	nautilus::network::PlayerSnapshotHistory m_SnapshotHistory;
+
+
+	// Prediction of our own player.
+	// Inputs we applied locally, but the server did not yet, oldest first.
+	uint32_t m_InputSequence = 0;
+	uint32_t m_AppliedInputSequence = 0;
+	std::deque<nautilus::network::PlayerInput> m_PendingInputs;
+	nautilus::network::InputPayload m_Input;
+
+
+	// Interpolation of the remote players.
+	// The snapshots of each, stamped with the server time of theyre tick.
+	uint32_t m_ServerTickRate = 0;
+	nautilus::network::ServerClock m_ServerClock;
+	std::unordered_map<uint32_t, nautilus::network::InterpolationBuffer> m_RemoteStates;
+
+
 	bool m_WaitingForConnection = true;
 
 
@@ -106,18 +143,40 @@ private:
 
 private:
 
-	float _getAveragePing() {
+	void _addPlayer(const nautilus::network::PlayerDescription& desc);
+
+
+	// Seconds since some point in the past, only used for differences.
+	double _localTime() const {
+
+		return (double)nautilus::network::monotonicMicroseconds() / 1000000.0;
+	}
 
-		float p = 0.0f;
-		int size = m_PingQueue.count();
 
-		for (int i = 0; i < size; i++) {
+	// The server sent the state of our player including all inputs up to "inputSequence".
+	// Start from it and apply again the inputs the server did not get to yet,
+	// so our prediction is corrected without losing what we pressed since.
+	//
+	void _reconcile(const nautilus::network::PlayerDescription& server, uint32_t inputSequence) {
 
+		using namespace nautilus::network;
 
-			p += m_PingQueue.pop_front();
+		// Snapshots may arrive out of order, an older state is no correction.
+		if (inputSequence < m_AppliedInputSequence) return;
+		m_AppliedInputSequence = inputSequence;
+
+
+		while (!m_PendingInputs.empty() && m_PendingInputs.front().m_Sequence <= inputSequence) {
+
+			m_PendingInputs.pop_front();
 		}
 
-		return p / size;
+
+		auto player = m_PlayerLobby.find(m_PlayerID);
+		if (player == m_PlayerLobby.end()) return;
+
+		player->second = server;
+		for (const auto& input : m_PendingInputs) simulatePlayer(player->second, input);
 	}
 };
 
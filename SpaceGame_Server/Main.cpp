@@ -1,178 +1,218 @@
 
-#include"Main.h"
+#include"Server.h"
 
+#include<csignal>
 
-using namespace nautilus::network;
 
+#define SERVER_TICK_RATE 30 // Default ticks per second, can be overridden by first command line argument.
+#define SERVER_IO_THREADS 2 // Default count of network threads, can be overridden by second command line argument.
+#define SERVER_INTEREST_RADIUS 20.0f // Default distance in world units in which a client sees other ships, can be overridden by third command line argument.
+#define SERVER_SOCKET_BUFFER_SIZE 0 // Bytes of the send and receive buffer of each client socket, 0 keeps the system default.
+#define SERVER_SEND_QUEUE_MESSAGES 4096 // Messages waiting to be sent to a client before he is disconnected as too slow.
+#define SERVER_SEND_QUEUE_BYTES (4 << 20) // Bytes waiting to be sent to a client before he is disconnected as too slow.
+#define SERVER_JOURNAL_SIZE (1ull << 30) // Bytes preallocated for the journal of received messages, recording stops when it is full.
+#define SERVER_STATS_FILE "server_stats.jsonl" // Default file the statistics are written to, can be overridden with "--stats".
+#define SERVER_STATS_INTERVAL 5.0 // Seconds between two lines of statistics.
 
-#define SERVER_PORT 7777
 
-class SpaceGame_Server : public olc::net::server_interface<NetMsg> {
-public:
-
-	SpaceGame_Server() : olc::net::server_interface<NetMsg>(SERVER_PORT){
-
-	}
 
+// Set by Ctrl+C or a termination request, the server loop then stops and the journal is closed.
+static volatile std::sig_atomic_t g_StopRequested = 0;
 
+static void onStopSignal(int) {
 
-	bool OnClientConnect(std::shared_ptr<olc::net::connection<NetMsg>> client) override {
+	g_StopRequested = 1;
+}
 
-		return true;
-	}
 
+int main(int argc, char** argv) {
 
-	void OnClientValidated(std::shared_ptr<olc::net::connection<NetMsg>> client) override {
+	using namespace std;
 
-		using namespace olc;
-		net::message<NetMsg> msg;
 
-		msg.header.id = NetMsg::Client_Accepted;
-		client->Send(msg);
+	// Options may stand anywhere, the remaining arguments are read by position.
+	//
+	// --record <file>		Write everything received into a journal.
+	// --replay <file>		Feed a journal to the server instead of listening, then exit.
+	// --realtime			Replay as fast as it was recorded, not as fast as possible.
+	// --stats <file>		Write the statistics there instead of "server_stats.jsonl".
+	//
+	string statsPath = SERVER_STATS_FILE;
+	string recordPath;
+	string replayPath;
+	bool replayRealTime = false;
+	vector<const char*> args;
+
+	for (int i = 1; i < argc; i++) {
+
+		string arg = argv[i];
+
+		if (arg == "--record" && i + 1 < argc) recordPath = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+		else if (arg == "--realtime") replayRealTime = true;
+		else if (arg == "--stats" && i + 1 < argc) statsPath = argv[++i];
+		else args.push_back(argv[i]);
 	}
 
 
-	void OnClientDisconnect(std::shared_ptr<olc::net::connection<NetMsg>> client) override {
+	// A journal was recorded with some tick rate, the replay uses the same.
+	JournalReader journal;
+	if (!replayPath.empty() && !journal.open(replayPath)) {
 
-		using namespace std;
-
-		if (client) {
-
-			if (m_PlayerLobby.find(client->GetID()) != m_PlayerLobby.end()) {
-
-				auto& pd = m_PlayerLobby[client->GetID()];
-
-				m_PlayerLobby.erase(client->GetID());
-				m_GarbageIDs.push_back(client->GetID());
-			}
-		}
+		cout << color(colors::RED);
+		cout << "Could not read journal \"" << replayPath << "\"." << white << endl;
+		return 1;
 	}
 
+	if (!replayPath.empty() && journal.getProtocolVersion() != protocolVersion()) {
 
-	void OnMessage(std::shared_ptr<olc::net::connection<NetMsg>> client, olc::net::message<NetMsg>& msg) override {
-
-		using namespace std;
-		using namespace olc::net;
-		using namespace nautilus::network;
-
-
-		// Garbage collection.
-		if (m_GarbageIDs.size() > 0) {
-
-			for (auto it : m_GarbageIDs) {
-
-				olc::net::message<NetMsg> message;
-				message.header.id = NetMsg::Game_RemovePlayer;
-
-				message << it;
-
-				// Inform other players about removal of player.
-				MessageAllClients(message);
-
-			}
-
+		cout << color(colors::RED);
+		cout << "Journal \"" << replayPath << "\" was recorded with another version or encoding of the messages." << white << endl;
+		return 1;
+	}
 
-			m_GarbageIDs.clear();
-		}
 
+	// Ticks per second of the server simulation, e.g. 20, 30 or 60.
+	int tickRate = SERVER_TICK_RATE;
+	if (args.size() > 0) {
 
+		tickRate = atoi(args[0]);
+		if (tickRate <= 0) tickRate = SERVER_TICK_RATE;
+	}
+	if (!replayPath.empty()) tickRate = (int)journal.getTickRate();
 
 
+	// Threads serving the sockets, the game itself runs on this thread.
+	int ioThreads = SERVER_IO_THREADS;
+	if (args.size() > 1) {
 
-		if (msg.header.id == NetMsg::Client_RegisterWithServer) {
+		ioThreads = atoi(args[1]);
+		if (ioThreads <= 0) ioThreads = SERVER_IO_THREADS;
+	}
 
-			// Store player in Lobby.
-			PlayerDescription desc;
-			msg >> desc;
 
+	// Distance around a player in which he sees other ships.
+	// Must be the same as when recording for a replay to end up the same.
+	float interestRadius = SERVER_INTEREST_RADIUS;
+	if (args.size() > 2) {
 
-			desc.m_PlayerNetworkID = client->GetID(); // Give him an ID.
-			m_PlayerLobby.insert_or_assign(desc.m_PlayerNetworkID, desc);
+		interestRadius = (float)atof(args[2]);
+		if (interestRadius <= 0.0f) interestRadius = SERVER_INTEREST_RADIUS;
+	}
 
 
-			// Inform the client that server gave him an ID.
-			message<NetMsg> messageSend;
-			messageSend.header.id = NetMsg::Client_AssignID;
-			messageSend << desc.m_PlayerNetworkID;
-			MessageClient(client, messageSend);
+	SpaceGame_Server server((uint32_t)tickRate, ioThreads, interestRadius);
 
 
+	if (!replayPath.empty()) {
 
-			// Inform all clients that a Player was added.
-			message<NetMsg> messageAddPlayer;
-			messageAddPlayer.header.id = NetMsg::Game_AddPlayer;
-			messageAddPlayer << desc;
-			MessageAllClients(messageAddPlayer);
+		cout << color(colors::YELLOW);
+		cout << "Replaying \"" << replayPath << "\" at " << tickRate << " Hz" << (replayRealTime ? " in real time." : ".") << white << endl;
 
+		server.Replay(journal, replayRealTime);
+		return 0;
+	}
 
-			// Inform new incomming player about all players currently in lobby.
-			// We send for the client the instance that he will control too, in order
-			// that he is ABLE to control an entity, that is alter its components etc.
-			//
-			for (const auto& player : m_PlayerLobby) {
 
+	if (!recordPath.empty()) {
 
-				message<NetMsg> messageAddOtherPlayers;
-				messageAddOtherPlayers.header.id = NetMsg::Game_AddPlayer;
-				messageAddOtherPlayers << player.second;
-				MessageClient(client, messageAddOtherPlayers);
+		if (!server.StartJournal(recordPath, SERVER_JOURNAL_SIZE)) {
 
-			}
-		}
-		else if (msg.header.id == NetMsg::Client_UnregisterWithServer) {
-			return;
+			cout << color(colors::RED);
+			cout << "Could not create journal \"" << recordPath << "\"." << white << endl;
+			return 1;
 		}
-		else if (msg.header.id == NetMsg::Game_UpdatePlayer) {
 
+		cout << color(colors::YELLOW);
+		cout << "Recording into: \"" << recordPath << "\"." << white << endl;
+	}
 
-			message<NetMsg> temp = msg;
-			PlayerDescription desc;
-			temp >> desc;
+	// Everything sent to a client during a tick goes out together when the tick is done,
+	// see "Flush" below. As we batch ourselves, the sockets do not need to wait for more data.
+	olc::net::connection_options options;
+	options.bManualFlush = true;
+	options.bNoDelay = true;
+	options.nSendBufferSize = SERVER_SOCKET_BUFFER_SIZE;
+	options.nReceiveBufferSize = SERVER_SOCKET_BUFFER_SIZE;
 
-			using namespace std;
-			cout << color(colors::GREEN);
-			cout << "Player \"" << client->GetID() << "\" Position: (" << desc.m_PlayerPositionX <<  ":" << desc.m_PlayerPositionY << ")" << endl << endl;
-			cout << "Player \"" << client->GetID() << "\" Velocity: (" << desc.m_PlayerVelocityX << ":" << desc.m_PlayerVelocityY << ")" << white << endl;
+	// A client not reading what we send is dropped, before he takes up the memory of the server.
+	options.nMaxQueuedMessages = SERVER_SEND_QUEUE_MESSAGES;
+	options.nMaxQueuedBytes = SERVER_SEND_QUEUE_BYTES;
 
-			// Just redirect the message to all clients.
-			MessageAllClients(msg);
-		}
+	// A message larger than its payload may be closes the connection, before anything is allocated for it.
+	options.vecMaxMessageSizes = messageSizeLimits();
+	server.SetConnectionOptions(options);
 
+	if (!server.StartStats(statsPath, SERVER_STATS_INTERVAL)) {
 
+		cout << color(colors::RED);
+		cout << "Could not open statistics file \"" << statsPath << "\"." << white << endl;
 	}
 
+	if (!server.Start()) {
 
-private:
+		cout << color(colors::RED);
+		cout << "Could not listen on port " << SERVER_PORT << "." << white << endl;
+		return 1;
+	}
 
+	cout << color(colors::YELLOW);
+	cout << "Listening on: \"" << server.GetIpAddress() << "\":\"" << SERVER_PORT << "\". " << white << endl;
+	cout << color(colors::YELLOW);
+	cout << "Tick rate: " << tickRate << " Hz." << white << endl;
+	cout << color(colors::YELLOW);
+	cout << "Network threads: " << ioThreads << "." << white << endl;
+	cout << color(colors::YELLOW);
+	cout << "Interest radius: " << interestRadius << "." << white << endl;
+	cout << color(colors::YELLOW);
+	cout << "Statistics into: \"" << statsPath << "\" every " << SERVER_STATS_INTERVAL << " s." << white << endl;
 
-	// Server has map of all entities.
-	std::map<uint32_t, PlayerDescription> m_PlayerLobby;
-	std::vector<uint32_t> m_GarbageIDs;
 
+	// Fixed rate server loop.
+	// Each tick we process all messages which arrived since the last tick,
+	// send out the world snapshots and sleep until the next tick is due.
+	//
+	// Runs until Ctrl+C or a termination request.
+	//
+	const auto tickDuration = chrono::microseconds(1000000 / tickRate);
+	auto nextTick = chrono::steady_clock::now();
 
-private:
+	signal(SIGINT, onStopSignal);
+	signal(SIGTERM, onStopSignal);
 
-};
+	while (!g_StopRequested) {
 
+		nextTick += tickDuration;
 
+		uint64_t tickStart = monotonicMicroseconds();
 
-int main() {
+		server.Update(-1, false);
+		server.Tick();
+		server.Flush();
 
-	using namespace std;
+		server.RecordTick(monotonicMicroseconds() - tickStart);
 
-	SpaceGame_Server server;
-	server.Start();
 
-	cout << color(colors::YELLOW);
-	cout << "Listening on: \"" << server.GetIpAddress() << "\":\"" << SERVER_PORT << "\". " << white << endl;
-	
+		// If we are behind schedule, do not try to catch up with
+		// several ticks in a row, just continue from now on.
+		auto now = chrono::steady_clock::now();
+		if (now > nextTick) {
 
-	while (1) {
+			nextTick = now;
+		}
+		else {
 
-		server.Update(-1, true);
+			this_thread::sleep_until(nextTick);
+		}
 	}
 
+
+	// Cuts the journal file down to what was recorded.
+	server.StopJournal();
 	server.Stop();
 
+	cout << color(colors::YELLOW);
+	cout << "Stopped after " << server.GetTickCount() << " ticks." << white << endl;
+
 	return 0;
 }
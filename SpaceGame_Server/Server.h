@@ -0,0 +1,712 @@
+#pragma once
+
+#include"Main.h"
+
+
+using namespace nautilus::network;
+
+
+#define SERVER_PORT 7777
+#define SERVER_STATS_FILE_SIZE (16 << 20) // Bytes after which the statistics file is moved aside for a new one.
+#define SERVER_STATS_FILES 4 // Count of moved aside statistics files kept.
+#define SERVER_INPUT_SLACK_MS 250 // Milliseconds of input a client may send ahead of the server clock, at least the longest input (g_InputDeltaTimeMax).
+#define SERVER_SPAWN_RADIUS 5.0f // Players are placed on a circle this large around the origin.
+
+
+
+// Health and armor each ship starts with, by "PlayerDescription::PlayerRepresentation".
+struct ShipStats {
+
+	uint32_t m_Health;
+	uint32_t m_Armor;
+};
+
+static const ShipStats g_ShipStats[] = {
+
+	{ 10, 10 }, // Fighter.
+	{ 15, 35 }, // Juggernaut.
+	{ 15, 15 }, // Raider.
+	{ 10, 5 } // Interceptor.
+};
+
+
+
+// The authoritative game server, "main" only parses the options and runs the tick loop.
+// The tests run it in process on another port.
+//
+class SpaceGame_Server : public olc::net::server_interface<NetMsg> {
+public:
+
+	// The server listens for datagrams too, state updates are exchanged unreliably.
+	SpaceGame_Server(uint32_t tickRate, size_t ioThreads, float interestRadius, uint16_t port = SERVER_PORT) : olc::net::server_interface<NetMsg>(port, true, ioThreads),
+		m_TickRate(tickRate), m_TickStart(monotonicMicroseconds()), m_InterestRadius(interestRadius), m_InterestGrid(interestRadius) {
+
+	}
+
+
+
+	bool OnClientConnect(std::shared_ptr<olc::net::connection<NetMsg>> client) override {
+
+		return true;
+	}
+
+
+	void OnClientValidated(std::shared_ptr<olc::net::connection<NetMsg>> client) override {
+
+		// The client needs the tick rate to know the server time of a snapshot,
+		// which is the tick count divided by the tick rate.
+		AcceptedPayload accepted;
+		accepted.m_TickRate = m_TickRate;
+		accepted.m_ProtocolVersion = protocolVersion();
+		client->Send(makeMessage(Pool(), accepted));
+	}
+
+
+	void OnClientDisconnect(std::shared_ptr<olc::net::connection<NetMsg>> client) override {
+
+		using namespace std;
+
+		if (client) {
+
+			if (m_Journal.isOpen()) m_Journal.writeDisconnect(client->GetID());
+
+
+			// Clients which had the player in interest are informed
+			// with the next tick, as it left the interest of everyone.
+			// Disconnects are looked for at the start of each tick, so this is the tick they are noticed in.
+			auto player = m_ClientPlayers.find(client->GetID());
+			if (player != m_ClientPlayers.end()) {
+
+				m_PlayerLobby.remove(player->second);
+				m_ClientPlayers.erase(player);
+			}
+		}
+	}
+
+
+	void OnMessage(std::shared_ptr<olc::net::connection<NetMsg>> client, olc::net::message<NetMsg>& msg) override {
+
+		// Record the message before handling it.
+		if (m_Journal.isOpen()) _journalMessage(client, msg);
+
+		// Messages too short, too long or of a type we do not handle are dropped.
+		m_Dispatcher.dispatch(*this, msg, client);
+	}
+
+
+
+	// Handlers of the messages clients send, called by "OnMessage" through the dispatcher.
+	// See "NetworkRegistry.h" for the payloads.
+	//
+	using Client = std::shared_ptr<olc::net::connection<NetMsg>>;
+
+
+	void handle(const RegisterPayload& registration, const Client& client) {
+
+		// The client only chooses his ship, everything else of the player belongs to the server,
+		// else a client could place himself anywhere or refill his health by registering again.
+		// A player registers once, registering again is ignored.
+		if (_findPlayer(client)) return;
+
+
+		PlayerDescription desc;
+		desc.m_PlayerShip = registration.m_Player.m_PlayerShip;
+
+		size_t ship = (size_t)desc.m_PlayerShip;
+		if (ship >= sizeof(g_ShipStats) / sizeof(g_ShipStats[0])) {
+
+			desc.m_PlayerShip = PlayerDescription::PlayerRepresentation::Fighter;
+			ship = 0;
+		}
+
+		desc.m_PlayerHealth = g_ShipStats[ship].m_Health;
+		desc.m_PlayerArmor = g_ShipStats[ship].m_Armor;
+
+
+		// Spread the players over the spawn circle, by the golden angle, so the next one is never close to the last one.
+		// Taken from the count of players, so a replay places them the same.
+		const float angle = 2.39996f * (float)m_PlayerLobby.size();
+		desc.m_PlayerPositionX = SERVER_SPAWN_RADIUS * std::cos(angle);
+		desc.m_PlayerPositionY = SERVER_SPAWN_RADIUS * std::sin(angle);
+
+
+		// Store player in Lobby.
+		// Give him an ID, which is the handle of his slot in the lobby.
+		LobbyPlayer newPlayer;
+		newPlayer.m_Client = client;
+
+		uint32_t handle = m_PlayerLobby.add(std::move(newPlayer));
+		if (handle == PlayerLobby::InvalidHandle) return;
+
+		desc.m_PlayerNetworkID = handle;
+		m_PlayerLobby.find(handle)->m_Description = desc;
+		m_ClientPlayers[client->GetID()] = handle;
+
+
+		// Inform the client that server gave him an ID.
+		AssignIDPayload assign;
+		assign.m_PlayerID = desc.m_PlayerNetworkID;
+		client->Send(makeMessage(Pool(), assign));
+
+
+		// The new player and the players around him are added
+		// with the next tick, see the area of interest in "Tick".
+		// Thus the client gets his own player too, in order
+		// that he is ABLE to control an entity, that is alter its components etc.
+		//
+		// He gets all of them in one "Game_AddPlayers" message, and each client
+		// around him gets one message with the new player, no matter how full the lobby is.
+	}
+
+
+	void handle(const PingPayload& ping, const Client& client) {
+
+		// Send the clock of the client back with ours, the client measures the round trip time
+		// with his, and the offset of our clock, see "LatencyEstimator".
+		//
+		// Our clock is the time of the snapshots, so the client can align them with his own clock.
+		//
+		PingPayload reply = ping;
+		reply.m_ServerTime = serverMicroseconds();
+		client->Send(makeMessage(Pool(), reply));
+	}
+
+
+	void handle(const AckSnapshotPayload& ack, const Client& client) {
+
+		// The client received the snapshot of given tick,
+		// next snapshots for him can be sent as delta to it.
+		//
+		// Acks may arrive out of order, we only move forward.
+		//
+		LobbyPlayer* player = _findPlayer(client);
+		if (!player) return;
+
+		uint32_t& acked = player->m_AckedTick;
+		if (ack.m_Tick > acked || ack.m_Tick == 0) acked = ack.m_Tick;
+	}
+
+
+	void handle(const InputPayload& input, const Client& client) {
+
+		// The server is the authority over the ships, clients only send what theyre players pressed.
+		// Each input is applied once and in order, the newest inputs are repeated
+		// by the client in each message, so we skip the ones we already applied.
+		//
+		// The resulting state is sent to everyone with the next world snapshot,
+		// together with the last input applied, so the client can correct his prediction.
+		//
+		// The client says how long each input lasted, but a player can not fly more time than passed on the server.
+		// Inputs over the time budget wait for the next tick, the client sends them again.
+		// Inputs without duration are dropped, so each input applied costs at least "g_InputDeltaTimeMinMs".
+		//
+		LobbyPlayer* player = _findPlayer(client);
+		if (!player) return;
+
+
+		uint32_t& applied = player->m_InputSequence;
+
+		for (const auto& it : input.m_Inputs) {
+
+			if (it.m_Sequence <= applied) continue;
+
+			if (it.m_DeltaTimeMs < g_InputDeltaTimeMinMs) {
+
+				applied = it.m_Sequence;
+				continue;
+			}
+
+			uint64_t duration = (uint64_t)it.m_DeltaTimeMs * 1000;
+			if (duration > player->m_InputBudget) break;
+
+			player->m_InputBudget -= duration;
+
+			simulatePlayer(player->m_Description, it);
+			applied = it.m_Sequence;
+		}
+	}
+
+
+	// Called once per server tick, after all pending messages were processed by "Update".
+	//
+	// Sends every client exactly one world snapshot message with the state of the players
+	// within his area of interest. Thus the count of messages sent per tick grows linearly with count of clients,
+	// while the size of each message depends only on how many players are close to the client.
+	//
+	// Players entering the area of interest of a client are sent together with one "Game_AddPlayers",
+	// players leaving it, or the game, with "Game_RemovePlayer".
+	//
+	// The snapshot is delta compressed against the last snapshot the client acknowledged.
+	//
+	void Tick() {
+
+		using namespace olc::net;
+
+		m_TickCount++;
+		m_TickStart = monotonicMicroseconds();
+
+
+		// Clients which disconnected since the last tick are removed before anything is sent,
+		// so everyone who had them in interest is told with this tick.
+		RemoveDisconnectedClients();
+
+
+		// Recorded after the disconnects, so a replay removes the players before the same tick.
+		if (m_Journal.isOpen()) m_Journal.writeTick(m_TickCount);
+
+
+		// Put all players in the grid, so finding the players
+		// around a client does not look at every player.
+		m_InterestGrid.clear();
+		for (size_t i = 0; i < m_PlayerLobby.size(); i++) {
+
+			const PlayerDescription& desc = m_PlayerLobby.at(i).m_Description;
+			m_InterestGrid.insert(m_PlayerLobby.handleAt(i), desc.m_PlayerPositionX, desc.m_PlayerPositionY);
+		}
+
+
+		// Nothing below removes players, so the lobby can be iterated directly.
+		for (size_t i = 0; i < m_PlayerLobby.size(); i++) {
+
+			LobbyPlayer& player = m_PlayerLobby.at(i);
+			connection<NetMsg>& client = *player.m_Client;
+
+
+			// The time of this tick may be spent on inputs until the next one.
+			// Counted in ticks, not by the clock, so a replay applies the same inputs.
+			const uint64_t tickMicroseconds = 1000000 / m_TickRate;
+			player.m_InputBudget = std::min<uint64_t>(player.m_InputBudget + tickMicroseconds, tickMicroseconds + SERVER_INPUT_SLACK_MS * 1000);
+
+
+			// Players in the area of interest of the client.
+			// Ordered by id, as the snapshot and the players the client knows are.
+			m_InterestQuery.clear();
+			m_InterestGrid.query(player.m_Description.m_PlayerPositionX, player.m_Description.m_PlayerPositionY, m_InterestRadius, m_InterestQuery);
+			std::sort(m_InterestQuery.begin(), m_InterestQuery.end());
+
+			m_VisiblePlayers.clear();
+			for (auto id : m_InterestQuery) {
+
+				m_VisiblePlayers.push_back(m_PlayerLobby.find(id)->m_Description);
+			}
+
+
+			// Compare with the players the client knew until now.
+			std::vector<uint32_t>& known = player.m_Interest;
+
+			m_InterestEnter.clear();
+			m_InterestLeave.clear();
+
+			auto k = known.begin();
+			auto v = m_VisiblePlayers.begin();
+			while (k != known.end() || v != m_VisiblePlayers.end()) {
+
+				if (v == m_VisiblePlayers.end() || (k != known.end() && *k < v->m_PlayerNetworkID)) {
+
+					m_InterestLeave.push_back(*k++);
+				}
+				else if (k == known.end() || v->m_PlayerNetworkID < *k) {
+
+					m_InterestEnter.push_back(v->m_PlayerNetworkID);
+					v++;
+				}
+				else {
+
+					k++;
+					v++;
+				}
+			}
+
+			known.clear();
+			for (const auto& desc : m_VisiblePlayers) known.push_back(desc.m_PlayerNetworkID);
+
+
+			// Each client has his own history, as each client sees other players.
+			// If the client did not acknowledge any snapshot we still remember, he gets the full state.
+			//
+			PlayerSnapshotHistory& history = player.m_SnapshotHistory;
+
+			const PlayerSnapshot* baseline = history.find(player.m_AckedTick);
+			uint32_t baselineTick = baseline ? player.m_AckedTick : 0;
+
+
+			// The message is taken from the pool and handed over to the connection.
+			// The visible players and the slots of the history keep theyre memory from tick to tick,
+			// so once they have grown to the count of players around, building and sending snapshots does not allocate.
+			//
+			// The snapshot tells the client too which of his inputs the state includes.
+			//
+			message<NetMsg> snapshot = Pool().acquire(NetMsg::Game_WorldSnapshot);
+			writeSnapshot(snapshot, m_TickCount, baselineTick, baseline, m_VisiblePlayers, player.m_InputSequence);
+
+
+			// Remember what we sent, the client will acknowledge it
+			// and we can send the next snapshots as delta to it.
+			// Only now, as it may go into the slot of the baseline.
+			storeSnapshot(history, m_TickCount, m_VisiblePlayers);
+
+
+			// Enter and leave notifications are reliable,
+			// so the client always has an entity for the players in his snapshots.
+			//
+			// Sent straight to the connection, a client disconnecting meanwhile
+			// is removed at the start of the next tick.
+			//
+			// All players entering are sent in one message, for a client just joined that is everyone around him.
+			//
+			if (!m_InterestEnter.empty()) {
+
+				m_EnteringPlayers.m_Players.clear();
+				for (auto id : m_InterestEnter) m_EnteringPlayers.m_Players.push_back(m_PlayerLobby.find(id)->m_Description);
+
+				client.Send(makeMessage(Pool(), m_EnteringPlayers));
+			}
+
+			for (auto id : m_InterestLeave) {
+
+				RemovePlayerPayload remove;
+				remove.m_PlayerID = id;
+				client.Send(makeMessage(Pool(), remove));
+			}
+
+
+			// Snapshots are sent as datagrams, a lost snapshot is replaced by the next one.
+			// As the client acknowledges only what it received, the delta stays valid.
+			//
+			// For the same reason a snapshot still waiting for a slow client is replaced by this one,
+			// if it has to go through the stream.
+			client.SendDatagramState(std::move(snapshot), stateKey(NetMsg::Game_WorldSnapshot));
+		}
+	}
+
+
+	uint32_t GetTickCount() const { return m_TickCount; }
+
+
+
+	// Record every message received, each tick and each disconnect into a journal file,
+	// which "Replay" can feed to a server again.
+	//
+	// The file is preallocated with "capacity" bytes and mapped into memory,
+	// so recording never waits for the disk.
+	//
+	bool StartJournal(const std::string& path, uint64_t capacity) {
+
+		return m_Journal.open(path, capacity, m_TickRate, protocolVersion());
+	}
+
+
+	void StopJournal() {
+
+		m_Journal.close();
+	}
+
+
+
+	// Write statistics of the server every "interval" seconds into a file, one JSON object per line:
+	//
+	// "time"					Unix time in seconds the line was written.
+	// "interval"				Seconds the line covers.
+	// "ticks", "tick_ms"		Count of ticks and percentiles of theyre duration in milliseconds, receiving and sending included.
+	// "incoming"				Messages waiting in the incoming queue at the start of a tick, average and maximum.
+	// "connections", "players"	Currently connected and registered.
+	// "in", "out"				Messages and bytes per second of all clients.
+	// "queued"					Messages and bytes waiting to be written to the clients, sum and largest of one client.
+	// "clients"				Per client: id, the same per second rates and what is queued for him.
+	//
+	// The file is moved aside when it gets too large, see "RollingFile".
+	//
+	bool StartStats(const std::string& path, double interval) {
+
+		m_StatsInterval = (uint64_t)(interval * 1000000.0);
+		m_StatsStart = monotonicMicroseconds();
+		return m_StatsFile.open(path, SERVER_STATS_FILE_SIZE, SERVER_STATS_FILES);
+	}
+
+
+	// Called after each tick with how long it took, receiving and sending included.
+	void RecordTick(uint64_t microseconds) {
+
+		if (!m_StatsFile.isOpen()) return;
+
+		m_TickDurations.add((double)microseconds / 1000.0);
+
+		size_t incoming = GetLastUpdateMessages();
+		m_IncomingTotal += incoming;
+		m_IncomingMax = std::max(m_IncomingMax, incoming);
+
+
+		uint64_t now = monotonicMicroseconds();
+		if (now - m_StatsStart >= m_StatsInterval) {
+
+			_writeStats((double)(now - m_StatsStart) / 1000000.0);
+			m_StatsStart = now;
+		}
+	}
+
+
+
+	// Feed a journal to the server, in place of the network.
+	//
+	// Messages, ticks and disconnects happen in the order they were recorded, so the world ends up the same.
+	// The clients are stand ins only having the id of the recorded connection, whatever is sent to them is dropped.
+	//
+	// With "realTime" the records are spaced as they were recorded,
+	// otherwise they are processed as fast as possible, e.g. to benchmark the server.
+	//
+	void Replay(JournalReader& journal, bool realTime) {
+
+		using namespace std;
+		using namespace olc::net;
+
+
+		std::unordered_map<uint32_t, std::shared_ptr<connection<NetMsg>>> clients;
+
+		JournalRecordHeader record;
+		message<NetMsg> msg;
+
+		uint64_t messages = 0;
+		uint64_t ticks = 0;
+		uint64_t tickMicroseconds = 0;
+
+		const auto start = chrono::steady_clock::now();
+
+		while (journal.next(record, msg)) {
+
+			if (realTime) this_thread::sleep_until(start + chrono::microseconds(record.m_Time));
+
+
+			if (record.m_Type == JournalRecord::Message) {
+
+				auto& client = clients[record.m_ConnectionID];
+				if (!client) client = CreateDetachedConnection(record.m_ConnectionID);
+
+				OnMessage(client, msg);
+				messages++;
+			}
+			else if (record.m_Type == JournalRecord::Tick) {
+
+				uint64_t tickStart = monotonicMicroseconds();
+				Tick();
+				tickMicroseconds += monotonicMicroseconds() - tickStart;
+				ticks++;
+			}
+			else if (record.m_Type == JournalRecord::Disconnect) {
+
+				auto client = clients.find(record.m_ConnectionID);
+				if (client != clients.end()) {
+
+					OnClientDisconnect(client->second);
+					clients.erase(client);
+				}
+			}
+		}
+
+
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		cout << color(colors::YELLOW);
+		cout << "Replayed " << messages << " messages and " << ticks << " ticks in " << seconds << " s";
+		if (ticks > 0) cout << ", " << (double)tickMicroseconds / ticks << " us per tick";
+		cout << ". " << m_PlayerLobby.size() << " players left." << white << endl;
+	}
+
+
+	// Server time in microseconds.
+	// The snapshot of a tick is stamped with the tick count divided by the tick rate,
+	// in between the time since the last tick is added.
+	//
+	uint64_t serverMicroseconds() const {
+
+		return (uint64_t)m_TickCount * 1000000 / m_TickRate + (monotonicMicroseconds() - m_TickStart);
+	}
+
+
+private:
+
+
+	// A registered client and his player.
+	struct LobbyPlayer {
+
+		std::shared_ptr<olc::net::connection<NetMsg>> m_Client;
+		PlayerDescription m_Description;
+
+
+		// Delta compression.
+		// The last snapshots we sent him and the newest tick he acknowledged.
+		PlayerSnapshotHistory m_SnapshotHistory;
+		uint32_t m_AckedTick = 0;
+
+
+		// Prediction.
+		// The sequence of the last input applied to his player,
+		// and the microseconds of input he may still send, see "Tick".
+		uint32_t m_InputSequence = 0;
+		uint64_t m_InputBudget = 0;
+
+
+		// Area of interest.
+		// The ids of the players he knows about, ordered.
+		std::vector<uint32_t> m_Interest;
+	};
+
+	using PlayerLobby = SlotTable<LobbyPlayer>;
+
+
+	// Server has a table of all players, the network id of a player is the handle of his slot.
+	// Clients are found by the id of theyre connection.
+	PlayerLobby m_PlayerLobby;
+	std::unordered_map<uint32_t, PlayerLobby::Handle> m_ClientPlayers;
+
+
+	// Count of ticks processed since server start.
+	uint32_t m_TickCount = 0;
+	uint32_t m_TickRate;
+	uint64_t m_TickStart;
+
+
+	// Recording of what was received, see "StartJournal".
+	JournalWriter m_Journal;
+	bool m_JournalFullReported = false;
+
+
+	// Statistics, see "StartStats".
+	// The traffic counters of the connections only grow, the rates are the difference to the last line.
+	RollingFile m_StatsFile;
+	uint64_t m_StatsInterval = 0;
+	uint64_t m_StatsStart = 0;
+	DurationSamples m_TickDurations;
+	uint64_t m_IncomingTotal = 0;
+	size_t m_IncomingMax = 0;
+	std::unordered_map<uint32_t, olc::net::connection_stats> m_LastClientStats;
+	std::unordered_map<uint32_t, olc::net::connection_stats> m_ClientStats;
+
+
+	// Area of interest.
+	// A client is only informed about players within the radius around his own player.
+	float m_InterestRadius;
+	InterestGrid m_InterestGrid;
+
+
+	// Scratch containers reused each tick.
+	std::vector<uint32_t> m_InterestQuery;
+	std::vector<uint32_t> m_InterestEnter;
+	std::vector<uint32_t> m_InterestLeave;
+	PlayerSnapshot m_VisiblePlayers;
+	AddPlayersPayload m_EnteringPlayers;
+
+
+	// Calls the "handle" for each message received.
+	MessageDispatcher<SpaceGame_Server, const Client&> m_Dispatcher;
+
+
+private:
+
+	void _journalMessage(const std::shared_ptr<olc::net::connection<NetMsg>>& client, const olc::net::message<NetMsg>& msg) {
+
+		m_Journal.writeMessage(client->GetID(), msg);
+
+		if (m_Journal.isFull() && !m_JournalFullReported) {
+
+			m_JournalFullReported = true;
+			std::cout << color(colors::RED) << "Journal is full, recording stopped." << white << std::endl;
+		}
+	}
+
+
+	void _writeStats(double seconds) {
+
+		using namespace std;
+		using namespace olc::net;
+
+
+		// Traffic of each client since the last line.
+		m_ClientStats.clear();
+		for (auto& client : m_deqConnections) {
+
+			if (client) m_ClientStats[client->GetID()] = client->GetStats();
+		}
+
+
+		uint64_t ticks = m_TickDurations.count();
+
+		ostringstream line;
+		line.precision(6);
+		line << "{\"time\":" << chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+		line << ",\"interval\":" << seconds;
+		line << ",\"tick_rate\":" << m_TickRate;
+		line << ",\"ticks\":" << ticks;
+		line << ",\"tick_ms\":{\"p50\":" << m_TickDurations.percentile(0.5) << ",\"p90\":" << m_TickDurations.percentile(0.9)
+			<< ",\"p99\":" << m_TickDurations.percentile(0.99) << ",\"max\":" << m_TickDurations.max() << "}";
+		line << ",\"incoming\":{\"avg\":" << (ticks > 0 ? (double)m_IncomingTotal / ticks : 0.0) << ",\"max\":" << m_IncomingMax << "}";
+		line << ",\"connections\":" << m_ClientStats.size();
+		line << ",\"players\":" << m_PlayerLobby.size();
+
+
+		connection_stats total;
+		uint64_t queuedMessagesMax = 0;
+		uint64_t queuedBytesMax = 0;
+
+		ostringstream clients;
+		clients.precision(6);
+		bool first = true;
+
+		for (const auto& it : m_ClientStats) {
+
+			const connection_stats& now = it.second;
+
+			connection_stats last;
+			auto lastIt = m_LastClientStats.find(it.first);
+			if (lastIt != m_LastClientStats.end()) last = lastIt->second;
+
+			connection_stats delta;
+			delta.nMessagesIn = now.nMessagesIn - last.nMessagesIn;
+			delta.nMessagesOut = now.nMessagesOut - last.nMessagesOut;
+			delta.nBytesIn = now.nBytesIn - last.nBytesIn;
+			delta.nBytesOut = now.nBytesOut - last.nBytesOut;
+
+			total.nMessagesIn += delta.nMessagesIn;
+			total.nMessagesOut += delta.nMessagesOut;
+			total.nBytesIn += delta.nBytesIn;
+			total.nBytesOut += delta.nBytesOut;
+			total.nQueuedMessages += now.nQueuedMessages;
+			total.nQueuedBytes += now.nQueuedBytes;
+			queuedMessagesMax = std::max(queuedMessagesMax, now.nQueuedMessages);
+			queuedBytesMax = std::max(queuedBytesMax, now.nQueuedBytes);
+
+			clients << (first ? "" : ",") << "{\"id\":" << it.first;
+			_writeTraffic(clients, delta, seconds);
+			clients << ",\"queued\":{\"messages\":" << now.nQueuedMessages << ",\"bytes\":" << now.nQueuedBytes << "}}";
+			first = false;
+		}
+
+		_writeTraffic(line, total, seconds);
+		line << ",\"queued\":{\"messages\":" << total.nQueuedMessages << ",\"bytes\":" << total.nQueuedBytes
+			<< ",\"max_messages\":" << queuedMessagesMax << ",\"max_bytes\":" << queuedBytesMax << "}";
+		line << ",\"clients\":[" << clients.str() << "]}";
+
+		m_StatsFile.writeLine(line.str());
+
+
+		// Start the next interval.
+		// Clients which left are forgotten along the way.
+		std::swap(m_LastClientStats, m_ClientStats);
+		m_TickDurations.clear();
+		m_IncomingTotal = 0;
+		m_IncomingMax = 0;
+	}
+
+
+	static void _writeTraffic(std::ostringstream& out, const olc::net::connection_stats& delta, double seconds) {
+
+		out << ",\"in\":{\"messages\":" << delta.nMessagesIn / seconds << ",\"bytes\":" << delta.nBytesIn / seconds << "}";
+		out << ",\"out\":{\"messages\":" << delta.nMessagesOut / seconds << ",\"bytes\":" << delta.nBytesOut / seconds << "}";
+	}
+
+
+	LobbyPlayer* _findPlayer(const std::shared_ptr<olc::net::connection<NetMsg>>& client) {
+
+		auto it = m_ClientPlayers.find(client->GetID());
+		return (it == m_ClientPlayers.end()) ? nullptr : m_PlayerLobby.find(it->second);
+	}
+};
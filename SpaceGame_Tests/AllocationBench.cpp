@@ -0,0 +1,227 @@
+#include"Main.h"
+
+#include"../SpaceGame_Server/Server.h"
+
+#include<atomic>
+#include<cstdlib>
+#include<new>
+#include<thread>
+
+
+using namespace nautilus::network;
+
+
+#define ALLOCATION_PORT 7791
+#define ALLOCATION_MESSAGES 10000 // Messages per measured round.
+#define ALLOCATION_WARMUP_ROUNDS 3 // Rounds before measuring, until the pools and queues have grown to theyre size.
+#define ALLOCATION_BATCH 50 // Messages sent before the server and the client catch up.
+#define ALLOCATION_PLAYERS 16 // Players in the server of the tick test, all within interest of each other.
+#define ALLOCATION_TICKS 100 // Ticks measured, after as many to warm up.
+
+
+
+// Every allocation of the test program is counted.
+//
+static std::atomic<size_t> g_Allocations{ 0 };
+
+void* operator new(size_t size) {
+
+	g_Allocations++;
+
+	void* p = std::malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+
+	return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+
+
+// Sends every message back to the client it came from, taken from the pool like the game server does.
+//
+class EchoServer : public olc::net::server_interface<NetMsg> {
+public:
+
+	EchoServer(bool datagrams) : olc::net::server_interface<NetMsg>(ALLOCATION_PORT, true), m_Datagrams(datagrams) {}
+
+
+	bool OnClientConnect(std::shared_ptr<olc::net::connection<NetMsg>>) override { return true; }
+
+
+	void OnMessage(std::shared_ptr<olc::net::connection<NetMsg>> client, olc::net::message<NetMsg>& msg) override {
+
+		auto echo = Pool().acquire(msg.header.id);
+		echo.header = msg.header;
+		echo.body.assign(msg.body.begin(), msg.body.end());
+
+		if (m_Datagrams) MessageClientDatagram(client, std::move(echo));
+		else MessageClient(client, std::move(echo));
+	}
+
+
+private:
+
+	bool m_Datagrams = false;
+};
+
+
+
+// Send "count" player updates to the server and take the echoes, returns how many came back.
+//
+static size_t _echoRound(EchoServer& server, olc::net::client_interface<NetMsg>& client, bool datagrams, size_t count) {
+
+	using namespace std;
+
+
+	PlayerDescription desc;
+	size_t received = 0;
+
+	auto receive = [&]() {
+
+		server.Update(-1, false);
+
+		while (!client.Incoming().empty()) {
+
+			client.Pool().release(client.Incoming().pop_front().msg);
+			received++;
+		}
+	};
+
+
+	for (size_t i = 0; i < count; i++) {
+
+		auto msg = client.Pool().acquire(NetMsg::Game_UpdatePlayer);
+		writePlayerDescription(msg, desc);
+
+		if (datagrams) client.SendDatagram(std::move(msg));
+		else client.Send(std::move(msg));
+
+		if (i % ALLOCATION_BATCH == ALLOCATION_BATCH - 1) {
+
+			this_thread::sleep_for(chrono::milliseconds(2));
+			receive();
+		}
+	}
+
+	this_thread::sleep_for(chrono::milliseconds(100));
+	receive();
+
+	return received;
+}
+
+
+static bool _measureAllocations(bool datagrams) {
+
+	using namespace std;
+
+
+	EchoServer server(datagrams);
+	TEST_CHECK(server.Start());
+
+	olc::net::client_interface<NetMsg> client;
+	TEST_CHECK(client.Connect("127.0.0.1", ALLOCATION_PORT, datagrams));
+
+	this_thread::sleep_for(chrono::milliseconds(300));
+	TEST_CHECK(client.IsConnected());
+
+
+	for (int i = 0; i < ALLOCATION_WARMUP_ROUNDS; i++) _echoRound(server, client, datagrams, ALLOCATION_MESSAGES);
+
+	size_t before = g_Allocations;
+	size_t received = _echoRound(server, client, datagrams, ALLOCATION_MESSAGES);
+	size_t allocations = g_Allocations - before;
+
+
+	cout << color(colors::CYAN);
+	cout << (datagrams ? "Datagrams: " : "Stream: ") << received << " of " << ALLOCATION_MESSAGES << " messages echoed, "
+		<< allocations << " allocations per " << ALLOCATION_MESSAGES << " messages." << white << endl;
+
+
+	// Datagrams may get lost, but on loopback most arrive.
+	TEST_CHECK(received >= ALLOCATION_MESSAGES * 9 / 10);
+
+	// Copying each message into a new buffer, as before the pool, would be
+	// several allocations per message. Whatever asio allocates is far less.
+	TEST_CHECK(allocations < ALLOCATION_MESSAGES / 10);
+
+	return true;
+}
+
+
+
+// Allocations while the client sends messages and the server echoes them,
+// once everything has grown to its size.
+//
+bool benchMessageAllocations() {
+
+	return _measureAllocations(false) && _measureAllocations(true);
+}
+
+
+
+// Allocations of the server building and sending the snapshots of a tick, once the scratch containers and
+// the snapshot histories have grown to the count of players. Each client acknowledges every snapshot,
+// as on a good connection, so the snapshots are deltas.
+//
+// The server is fed like "Replay" does, without network, so nothing else allocates meanwhile.
+//
+bool benchTickAllocations() {
+
+	using namespace std;
+
+
+	SpaceGame_Server server(30, 1, 20.0f, ALLOCATION_PORT);
+
+	vector<shared_ptr<olc::net::connection<NetMsg>>> clients;
+	for (uint32_t i = 0; i < ALLOCATION_PLAYERS; i++) {
+
+		clients.push_back(server.CreateDetachedConnection(i + 1));
+
+		RegisterPayload registration;
+		registration.m_Player.m_PlayerShip = (PlayerDescription::PlayerRepresentation)(i % 4);
+
+		auto msg = makeMessage(server.Pool(), registration);
+		server.OnMessage(clients.back(), msg);
+	}
+
+
+	auto acknowledge = [&]() {
+
+		for (auto& client : clients) {
+
+			AckSnapshotPayload ack;
+			ack.m_Tick = server.GetTickCount();
+
+			auto msg = makeMessage(server.Pool(), ack);
+			server.OnMessage(client, msg);
+			server.Pool().release(std::move(msg));
+		}
+	};
+
+	for (int i = 0; i < ALLOCATION_TICKS; i++) {
+
+		server.Tick();
+		acknowledge();
+	}
+
+
+	size_t allocations = 0;
+	for (int i = 0; i < ALLOCATION_TICKS; i++) {
+
+		size_t before = g_Allocations;
+		server.Tick();
+		allocations += g_Allocations - before;
+
+		acknowledge();
+	}
+
+
+	cout << color(colors::CYAN);
+	cout << ALLOCATION_PLAYERS << " players: " << allocations << " allocations in " << ALLOCATION_TICKS << " ticks." << white << endl;
+
+	TEST_CHECK(allocations == 0);
+
+	return true;
+}
@@ -0,0 +1,435 @@
+#include"Main.h"
+
+#include<cmath>
+#include<random>
+#include<thread>
+
+
+using namespace nautilus::network;
+
+
+#define ENCODING_SAMPLES 20000 // Random values encoded per test.
+#define ENCODING_SEED 3 // Same values on every run.
+#define ENCODING_PORT 7793
+
+
+
+// Largest error quantizing with the given range and bits may make, half a step plus float rounding.
+static float _quantizationError(float min, float max, uint32_t bits) {
+
+	return (max - min) / (float)((1ull << bits) - 1) * 0.5f + 1e-4f;
+}
+
+
+// Difference of two angles, independent of full turns.
+static float _angleDifference(float a, float b) {
+
+	float d = std::fmod(std::fabs(a - b), 6.28318530718f);
+	return std::min(d, 6.28318530718f - d);
+}
+
+
+static PlayerDescription _randomPlayer(std::mt19937& random) {
+
+	std::uniform_real_distribution<float> position(g_WorldMin, g_WorldMax);
+	std::uniform_real_distribution<float> velocity(-g_VelocityMax, g_VelocityMax);
+	std::uniform_real_distribution<float> rotation(-20.0f, 20.0f);
+
+	PlayerDescription desc;
+	desc.m_PlayerNetworkID = random();
+	desc.m_PlayerHealth = random() % 70000;
+	desc.m_PlayerArmor = random() % 100;
+	desc.m_PlayerPositionX = position(random);
+	desc.m_PlayerPositionY = position(random);
+	desc.m_PlayerVelocityX = velocity(random);
+	desc.m_PlayerVelocityY = velocity(random);
+	desc.m_PlayerRotation = rotation(random);
+	desc.m_PlayerShip = (PlayerDescription::PlayerRepresentation)(random() % 4);
+
+	return desc;
+}
+
+
+// Whether "decoded" is "desc" within what the encoding keeps.
+// The raw encoding keeps everything, the quantized one saturates health and armor and rounds the floats.
+static bool _samePlayer(const PlayerDescription& desc, const PlayerDescription& decoded, WireEncoding encoding) {
+
+	if (encoding == WireEncoding::Raw) return std::memcmp(&decoded, &desc, sizeof(PlayerDescription)) == 0;
+
+	const float positionError = _quantizationError(g_WorldMin, g_WorldMax, g_PositionBits);
+	const float velocityError = _quantizationError(-g_VelocityMax, g_VelocityMax, g_VelocityBits);
+	const float rotationError = _quantizationError(0.0f, 6.28318530718f, g_RotationBits);
+
+	return decoded.m_PlayerNetworkID == desc.m_PlayerNetworkID &&
+		decoded.m_PlayerHealth == std::min<uint32_t>(desc.m_PlayerHealth, (1u << g_HealthBits) - 1) &&
+		decoded.m_PlayerArmor == std::min<uint32_t>(desc.m_PlayerArmor, (1u << g_HealthBits) - 1) &&
+		std::fabs(decoded.m_PlayerPositionX - desc.m_PlayerPositionX) <= positionError &&
+		std::fabs(decoded.m_PlayerPositionY - desc.m_PlayerPositionY) <= positionError &&
+		std::fabs(decoded.m_PlayerVelocityX - desc.m_PlayerVelocityX) <= velocityError &&
+		std::fabs(decoded.m_PlayerVelocityY - desc.m_PlayerVelocityY) <= velocityError &&
+		_angleDifference(decoded.m_PlayerRotation, desc.m_PlayerRotation) <= rotationError &&
+		decoded.m_PlayerShip == desc.m_PlayerShip;
+}
+
+
+
+// Values of every width come out of the bit stream as they went in,
+// and reading past the end is noticed.
+//
+bool testBitStreamRoundTrip() {
+
+	std::mt19937 random(ENCODING_SEED);
+
+	std::vector<std::pair<uint32_t, uint32_t>> written;
+
+	olc::net::message<NetMsg> msg;
+	{
+		olc::net::bit_writer<NetMsg> out(msg);
+
+		for (int i = 0; i < ENCODING_SAMPLES; i++) {
+
+			uint32_t bits = 1 + random() % 32;
+			uint32_t value = (bits == 32) ? (uint32_t)random() : (uint32_t)random() & ((1u << bits) - 1);
+
+			out.write(value, bits);
+			written.push_back({ value, bits });
+		}
+	}
+
+	TEST_CHECK(msg.header.size == msg.size());
+
+
+	olc::net::bit_reader<NetMsg> in(msg);
+	for (const auto& it : written) {
+
+		TEST_CHECK(in.read(it.second) == it.first);
+	}
+
+	TEST_CHECK(in.good());
+
+
+	// The padding of the last byte is less than 8 bits, more than that fails.
+	in.read(8);
+	TEST_CHECK(!in.good());
+
+	return true;
+}
+
+
+
+// A player description written and read again, in both encodings.
+// Writing the decoded description again gives the same bytes, so passing it on loses nothing more.
+//
+bool testPlayerDescriptionRoundTrip() {
+
+	std::mt19937 random(ENCODING_SEED);
+
+
+	for (int i = 0; i < ENCODING_SAMPLES; i++) {
+
+		PlayerDescription desc = _randomPlayer(random);
+
+
+		setWireEncoding(NetMsg::Game_UpdatePlayer, WireEncoding::Quantized);
+
+		olc::net::message<NetMsg> quantized;
+		quantized.header.id = NetMsg::Game_UpdatePlayer;
+		writePlayerDescription(quantized, desc);
+
+		PlayerDescription decoded;
+		TEST_CHECK(readPlayerDescription(quantized, decoded));
+		TEST_CHECK(_samePlayer(desc, decoded, WireEncoding::Quantized));
+
+		olc::net::message<NetMsg> again;
+		again.header.id = NetMsg::Game_UpdatePlayer;
+		writePlayerDescription(again, decoded);
+		TEST_CHECK(again.body == quantized.body);
+
+
+		setWireEncoding(NetMsg::Game_UpdatePlayer, WireEncoding::Raw);
+
+		olc::net::message<NetMsg> raw;
+		raw.header.id = NetMsg::Game_UpdatePlayer;
+		writePlayerDescription(raw, desc);
+
+		TEST_CHECK(readPlayerDescription(raw, decoded));
+		TEST_CHECK(_samePlayer(desc, decoded, WireEncoding::Raw));
+
+
+		// A truncated message is refused.
+		quantized.body.pop_back();
+		quantized.header.size = quantized.size();
+		TEST_CHECK(!readPlayerDescription(quantized, decoded));
+	}
+
+	setWireEncoding(NetMsg::Game_UpdatePlayer, WireEncoding::Quantized);
+
+	return true;
+}
+
+
+
+// Many players in one message, as a client gets them when joining, in both encodings.
+//
+bool testPlayerDescriptionsRoundTrip() {
+
+	std::mt19937 random(ENCODING_SEED);
+
+	std::vector<PlayerDescription> players;
+	for (int i = 0; i < 1000; i++) players.push_back(_randomPlayer(random));
+
+
+	for (auto encoding : { WireEncoding::Raw, WireEncoding::Quantized }) {
+
+		setWireEncoding(NetMsg::Game_AddPlayers, encoding);
+
+		olc::net::message<NetMsg> msg;
+		msg.header.id = NetMsg::Game_AddPlayers;
+		writePlayerDescriptions(msg, players.begin(), players.end());
+
+		std::vector<PlayerDescription> decoded;
+		TEST_CHECK(readPlayerDescriptions(msg, decoded));
+		TEST_CHECK(decoded.size() == players.size());
+
+		for (size_t i = 0; i < players.size(); i++) TEST_CHECK(_samePlayer(players[i], decoded[i], encoding));
+
+
+		// Empty is fine too.
+		olc::net::message<NetMsg> empty;
+		empty.header.id = NetMsg::Game_AddPlayers;
+		writePlayerDescriptions(empty, players.begin(), players.begin());
+
+		TEST_CHECK(readPlayerDescriptions(empty, decoded));
+		TEST_CHECK(decoded.empty());
+	}
+
+	setWireEncoding(NetMsg::Game_AddPlayers, WireEncoding::Quantized);
+
+	return true;
+}
+
+
+
+// Full and delta snapshots give back the players, in both encodings,
+// and the quantized ones are smaller.
+//
+bool testSnapshotRoundTrip() {
+
+	using namespace std;
+
+
+	size_t sizes[2][2] = {};
+
+	for (auto encoding : { WireEncoding::Raw, WireEncoding::Quantized }) {
+
+		setWireEncoding(NetMsg::Game_WorldSnapshot, encoding);
+
+		std::mt19937 random(ENCODING_SEED);
+
+		PlayerSnapshot players;
+		for (int i = 0; i < 32; i++) players.push_back(_randomPlayer(random));
+
+		sortSnapshot(players);
+
+
+		// Full state.
+		olc::net::message<NetMsg> full;
+		full.header.id = NetMsg::Game_WorldSnapshot;
+		writeSnapshot(full, 1, 0, nullptr, players, 7);
+
+		PlayerSnapshotHistory history;
+		PlayerSnapshot decoded;
+		uint32_t tick = 0;
+		uint32_t inputSequence = 0;
+
+		TEST_CHECK(readSnapshot(full, history, tick, decoded, inputSequence));
+		TEST_CHECK(tick == 1 && inputSequence == 7);
+		TEST_CHECK(decoded.size() == players.size());
+
+		for (size_t i = 0; i < players.size(); i++) TEST_CHECK(_samePlayer(players[i], decoded[i], encoding));
+
+		storeSnapshot(history, 1, decoded);
+
+
+		// Delta to it, only the positions of half of the players changed.
+		PlayerSnapshot moved = decoded;
+		bool odd = false;
+		for (auto& desc : moved) {
+
+			if (odd) desc.m_PlayerPositionX += 0.5f;
+			odd = !odd;
+		}
+
+		olc::net::message<NetMsg> delta;
+		delta.header.id = NetMsg::Game_WorldSnapshot;
+		writeSnapshot(delta, 2, 1, history.find(1), moved, 8);
+
+		PlayerSnapshot decodedDelta;
+		TEST_CHECK(readSnapshot(delta, history, tick, decodedDelta, inputSequence));
+		TEST_CHECK(tick == 2 && inputSequence == 8);
+		TEST_CHECK(decodedDelta.size() == moved.size());
+
+		for (size_t i = 0; i < moved.size(); i++) TEST_CHECK(_samePlayer(moved[i], decodedDelta[i], encoding));
+
+
+		// Without the baseline the delta can not be read.
+		PlayerSnapshotHistory empty;
+		TEST_CHECK(!readSnapshot(delta, empty, tick, decodedDelta, inputSequence));
+
+
+		size_t index = (encoding == WireEncoding::Quantized) ? 1 : 0;
+		sizes[index][0] = full.size();
+		sizes[index][1] = delta.size();
+	}
+
+	setWireEncoding(NetMsg::Game_WorldSnapshot, WireEncoding::Quantized);
+
+
+	cout << color(colors::CYAN);
+	cout << "32 players, full snapshot: " << sizes[0][0] << " B raw, " << sizes[1][0] << " B quantized. "
+		<< "Delta with 16 moved: " << sizes[0][1] << " B raw, " << sizes[1][1] << " B quantized." << white << endl;
+
+	TEST_CHECK(sizes[1][0] < sizes[0][0]);
+	TEST_CHECK(sizes[1][1] < sizes[0][1]);
+
+	return true;
+}
+
+
+
+
+// Both sides compare the version of the protocol, which changes with the wire encoding of any message type,
+// so a server measuring the raw encoding does not accept a client sending quantized messages.
+//
+bool testProtocolVersionEncoding() {
+
+	uint32_t quantized = protocolVersion();
+
+	for (auto id : { NetMsg::Client_RegisterWithServer, NetMsg::Game_UpdatePlayer, NetMsg::Game_WorldSnapshot }) {
+
+		setWireEncoding(id, WireEncoding::Raw);
+		TEST_CHECK(protocolVersion() != quantized);
+
+		setWireEncoding(id, WireEncoding::Quantized);
+		TEST_CHECK(protocolVersion() == quantized);
+	}
+
+
+	// Which message type is raw matters too.
+	setWireEncoding(NetMsg::Game_AddPlayer, WireEncoding::Raw);
+	uint32_t addPlayer = protocolVersion();
+	setWireEncoding(NetMsg::Game_AddPlayer, WireEncoding::Quantized);
+
+	setWireEncoding(NetMsg::Game_AddPlayers, WireEncoding::Raw);
+	uint32_t addPlayers = protocolVersion();
+	setWireEncoding(NetMsg::Game_AddPlayers, WireEncoding::Quantized);
+
+	TEST_CHECK(addPlayer != addPlayers);
+	TEST_CHECK(protocolVersion() == quantized);
+
+	return true;
+}
+
+
+// Counts the messages that get through, with the size limits the game server has.
+//
+class SizeLimitServer : public olc::net::server_interface<NetMsg> {
+public:
+
+	SizeLimitServer() : olc::net::server_interface<NetMsg>(ENCODING_PORT, false) {}
+
+
+	bool OnClientConnect(std::shared_ptr<olc::net::connection<NetMsg>>) override { return true; }
+
+
+	void OnMessage(std::shared_ptr<olc::net::connection<NetMsg>>, olc::net::message<NetMsg>&) override { m_Messages++; }
+
+
+	size_t m_Messages = 0;
+};
+
+
+// Send "msg" as it is, the header too, and tell whether the server kept the connection
+// and took the message.
+//
+static bool _sendHeader(SizeLimitServer& server, olc::net::message<NetMsg>&& msg) {
+
+	using namespace std;
+
+
+	olc::net::client_interface<NetMsg> client;
+	if (!client.Connect("127.0.0.1", ENCODING_PORT)) return false;
+
+	this_thread::sleep_for(chrono::milliseconds(200));
+	if (!client.IsConnected()) return false;
+
+	size_t before = server.m_Messages;
+
+	client.Send(std::move(msg));
+
+	this_thread::sleep_for(chrono::milliseconds(200));
+	server.Update(-1, false);
+
+	return client.IsConnected() && server.m_Messages == before + 1;
+}
+
+
+
+// A header announcing more than the payload of its id may be, or more than any message may be,
+// closes the connection before the body is read, so a peer can not make the other side allocate it.
+//
+bool testOversizedMessageHeader() {
+
+	SizeLimitServer server;
+
+	olc::net::connection_options options;
+	options.vecMaxMessageSizes = messageSizeLimits();
+	server.SetConnectionOptions(options);
+
+	TEST_CHECK(server.Start());
+
+
+	// A valid message gets through.
+	PlayerDescription desc;
+	olc::net::message<NetMsg> valid;
+	valid.header.id = NetMsg::Game_UpdatePlayer;
+	writePlayerDescription(valid, desc);
+
+	TEST_CHECK(_sendHeader(server, std::move(valid)));
+
+
+	// Near 4 GB announced, without a body following.
+	olc::net::message<NetMsg> huge;
+	huge.header.id = NetMsg::Game_UpdatePlayer;
+	huge.header.size = 0xFFFFFFF0;
+
+	TEST_CHECK(!_sendHeader(server, std::move(huge)));
+
+
+	// One byte more than the payload may be, with the body.
+	olc::net::message<NetMsg> larger;
+	larger.header.id = NetMsg::Game_UpdatePlayer;
+	larger.body.resize(payloadMaxSize<UpdatePlayerPayload>() + 1);
+	larger.header.size = larger.size();
+
+	TEST_CHECK(!_sendHeader(server, std::move(larger)));
+
+
+	// An id no payload has.
+	olc::net::message<NetMsg> unknown;
+	unknown.header.id = (NetMsg)g_NetMsgCount;
+
+	TEST_CHECK(!_sendHeader(server, std::move(unknown)));
+
+
+	// The server still serves others.
+	olc::net::message<NetMsg> after;
+	after.header.id = NetMsg::Game_UpdatePlayer;
+	writePlayerDescription(after, desc);
+
+	TEST_CHECK(_sendHeader(server, std::move(after)));
+
+	server.Stop();
+
+	return true;
+}
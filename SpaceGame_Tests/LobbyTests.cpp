@@ -0,0 +1,60 @@
+#include"Main.h"
+
+
+using namespace nautilus::network;
+
+
+
+// A removed item is not found by its handle, nor by a handle with the next generation of its slot,
+// which is the handle the slot gives out when reused. Once reused, only the new handle finds the new item.
+//
+bool testSlotTableRemove() {
+
+	SlotTable<int> table;
+
+	SlotTable<int>::Handle first = table.add(1);
+	SlotTable<int>::Handle second = table.add(2);
+	SlotTable<int>::Handle third = table.add(3);
+
+	TEST_CHECK(first != SlotTable<int>::InvalidHandle);
+	TEST_CHECK(table.find(second) && *table.find(second) == 2);
+
+
+	// The generation is in the high 16 bits of a handle.
+	SlotTable<int>::Handle next = second + (1u << 16);
+
+	TEST_CHECK(table.remove(second));
+	TEST_CHECK(!table.remove(second));
+
+	TEST_CHECK(!table.contains(second));
+	TEST_CHECK(!table.contains(next));
+	TEST_CHECK(table.find(second) == nullptr);
+	TEST_CHECK(table.find(next) == nullptr);
+	TEST_CHECK(!table.remove(next));
+
+	// The others are unaffected, although the last one moved into the gap.
+	TEST_CHECK(table.size() == 2);
+	TEST_CHECK(table.find(first) && *table.find(first) == 1);
+	TEST_CHECK(table.find(third) && *table.find(third) == 3);
+
+
+	// The slot is reused with the next generation.
+	SlotTable<int>::Handle reused = table.add(4);
+
+	TEST_CHECK(reused == next);
+	TEST_CHECK(table.find(reused) && *table.find(reused) == 4);
+	TEST_CHECK(table.find(second) == nullptr);
+
+
+	// Emptied, nothing is found.
+	TEST_CHECK(table.remove(first) && table.remove(third) && table.remove(reused));
+	TEST_CHECK(table.empty());
+
+	for (SlotTable<int>::Handle handle : { first, second, third, reused, next + (1u << 16) }) {
+
+		TEST_CHECK(!table.contains(handle));
+		TEST_CHECK(table.find(handle) == nullptr);
+	}
+
+	return true;
+}
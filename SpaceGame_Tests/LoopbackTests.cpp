@@ -0,0 +1,321 @@
+#include"Main.h"
+
+#include"../SpaceGame_Server/Server.h"
+
+#include<thread>
+
+
+#define LOOPBACK_PORT 7790 // Not the port of the game, so the tests can run next to a server.
+#define LOOPBACK_TICK_RATE 30
+#define LOOPBACK_IO_THREADS 2
+#define LOOPBACK_INTEREST_RADIUS 20.0f
+#define LOOPBACK_JOIN_TICKS 150 // Ticks the clients have to join, before the test fails.
+#define LOOPBACK_TICKS 30 // Ticks measured for each count of clients.
+#define LOOPBACK_STATES 1000 // State updates sent in the datagram loss test.
+#define LOOPBACK_LOSS 0.3f // Fraction of datagrams dropped in the datagram loss test.
+
+
+
+// A client doing only what is needed to be in the game:
+// it registers, acknowledges the snapshots and counts them.
+//
+class LoopbackClient : public olc::net::client_interface<NetMsg> {
+public:
+
+	LoopbackClient() {
+
+		m_Dispatcher.context().m_SnapshotHistory = &m_SnapshotHistory;
+	}
+
+
+	void onUpdate() {
+
+		while (!Incoming().empty()) {
+
+			auto msg = Incoming().pop_front().msg;
+
+			m_Dispatcher.dispatch(*this, msg);
+
+			Pool().release(std::move(msg));
+		}
+	}
+
+
+	void handle(const AcceptedPayload&) {
+
+		// Everyone starts at the origin, so each client has all others in interest.
+		RegisterPayload registration;
+		Send(makeMessage(Pool(), registration));
+	}
+
+
+	void handle(const AssignIDPayload& assign) {
+
+		m_PlayerID = assign.m_PlayerID;
+	}
+
+
+	void handle(const AddPlayersPayload& add) {
+
+		for (const auto& desc : add.m_Players) {
+
+			if (desc.m_PlayerNetworkID == m_PlayerID) m_Registered = true;
+		}
+	}
+
+
+	void handle(const WorldSnapshotPayload& snapshot) {
+
+		AckSnapshotPayload ack;
+		ack.m_Tick = snapshot.m_Decoded ? snapshot.m_Tick : 0;
+		SendDatagramState(makeMessage(Pool(), ack), stateKey(NetMsg::Client_AckSnapshot));
+
+		if (snapshot.m_Decoded) storeSnapshot(m_SnapshotHistory, snapshot.m_Tick, snapshot.m_Players);
+
+		m_Snapshots++;
+	}
+
+
+	bool isRegistered() const { return m_Registered; }
+
+	uint64_t m_Snapshots = 0;
+
+
+private:
+
+	uint32_t m_PlayerID = 0;
+	bool m_Registered = false;
+
+	PlayerSnapshotHistory m_SnapshotHistory;
+	MessageDispatcher<LoopbackClient> m_Dispatcher;
+};
+
+
+
+// Run a server with "clientCount" clients on loopback, and count what the clients receive
+// during "LOOPBACK_TICKS" ticks once all joined.
+//
+static bool _runLoopback(uint32_t clientCount, double& messagesPerTick, double& snapshotsPerTick) {
+
+	using namespace std;
+
+
+	// Set up like "main" of the server does.
+	SpaceGame_Server server(LOOPBACK_TICK_RATE, LOOPBACK_IO_THREADS, LOOPBACK_INTEREST_RADIUS, LOOPBACK_PORT);
+
+	olc::net::connection_options options;
+	options.bManualFlush = true;
+	options.bNoDelay = true;
+	options.vecMaxMessageSizes = messageSizeLimits();
+	server.SetConnectionOptions(options);
+
+	TEST_CHECK(server.Start());
+
+
+	vector<unique_ptr<LoopbackClient>> clients;
+	for (uint32_t i = 0; i < clientCount; i++) {
+
+		clients.push_back(make_unique<LoopbackClient>());
+		TEST_CHECK(clients.back()->Connect("127.0.0.1", LOOPBACK_PORT, true));
+	}
+
+
+	// One server tick, then the clients handle what arrived meanwhile.
+	const auto tickDuration = chrono::microseconds(1000000 / LOOPBACK_TICK_RATE);
+
+	auto tick = [&]() {
+
+		server.Update(-1, false);
+		server.Tick();
+		server.Flush();
+
+		this_thread::sleep_for(tickDuration);
+
+		for (auto& client : clients) client->onUpdate();
+	};
+
+	auto registered = [&]() {
+
+		for (auto& client : clients) {
+
+			if (!client->isRegistered()) return false;
+		}
+
+		return true;
+	};
+
+
+	for (int i = 0; i < LOOPBACK_JOIN_TICKS && !registered(); i++) tick();
+	TEST_CHECK(registered());
+
+	// Let the last ones joining be announced to everyone.
+	for (int i = 0; i < 5; i++) tick();
+
+
+	uint64_t messagesBefore = 0;
+	for (auto& client : clients) {
+
+		messagesBefore += client->GetStats().nMessagesIn;
+		client->m_Snapshots = 0;
+	}
+
+	for (int i = 0; i < LOOPBACK_TICKS; i++) tick();
+
+	uint64_t messages = 0;
+	uint64_t snapshots = 0;
+	for (auto& client : clients) {
+
+		messages += client->GetStats().nMessagesIn;
+		snapshots += client->m_Snapshots;
+	}
+
+	messagesPerTick = (double)(messages - messagesBefore) / LOOPBACK_TICKS;
+	snapshotsPerTick = (double)snapshots / LOOPBACK_TICKS;
+
+
+	// Once the clients are gone, so are theyre datagram tokens.
+	TEST_CHECK(server.GetDatagramConnectionCount() == clientCount);
+
+	clients.clear();
+	for (int i = 0; i < 5; i++) tick();
+
+	TEST_CHECK(server.GetDatagramConnectionCount() == 0);
+
+	return true;
+}
+
+
+
+// The server sends each client one world snapshot per tick, however many players there are.
+// So the messages sent per tick grow linearly with the clients, not with the square of them
+// as when every update of a player was relayed to everybody.
+//
+bool testSnapshotMessagesPerTick() {
+
+	using namespace std;
+
+
+	for (uint32_t clientCount : { 1u, 2u, 4u, 8u, 16u }) {
+
+		double messagesPerTick = 0.0;
+		double snapshotsPerTick = 0.0;
+		TEST_CHECK(_runLoopback(clientCount, messagesPerTick, snapshotsPerTick));
+
+
+		cout << color(colors::CYAN);
+		cout << clientCount << " clients: " << messagesPerTick << " messages per tick, "
+			<< messagesPerTick / clientCount << " per client, " << snapshotsPerTick << " snapshots per tick." << white << endl;
+
+
+		// Snapshots are datagrams, on loopback hardly any get lost.
+		TEST_CHECK(snapshotsPerTick <= clientCount);
+		TEST_CHECK(snapshotsPerTick >= 0.9 * clientCount);
+
+		// Nothing else is sent while nobody moves, only the snapshots.
+		TEST_CHECK(messagesPerTick / clientCount <= 1.5);
+	}
+
+	return true;
+}
+
+
+
+// Keeps the newest state of one player a client sends, as the game server does,
+// and remembers which states arrived.
+//
+class StateServer : public olc::net::server_interface<NetMsg> {
+public:
+
+	StateServer() : olc::net::server_interface<NetMsg>(LOOPBACK_PORT, true) {}
+
+
+	bool OnClientConnect(std::shared_ptr<olc::net::connection<NetMsg>>) override { return true; }
+
+
+	void OnMessage(std::shared_ptr<olc::net::connection<NetMsg>>, olc::net::message<NetMsg>& msg) override {
+
+		PlayerDescription desc;
+		if (msg.header.id != NetMsg::Game_UpdatePlayer || !readPlayerDescription(msg, desc)) return;
+
+		// An older state never replaces a newer one.
+		if (!m_Received.empty() && desc.m_PlayerNetworkID <= m_Received.back()) m_Stale++;
+		else m_Latest = desc;
+
+		m_Received.push_back(desc.m_PlayerNetworkID);
+	}
+
+
+	PlayerDescription m_Latest;
+	std::vector<uint32_t> m_Received;
+	size_t m_Stale = 0;
+};
+
+
+
+// State sent as datagrams, with a part of them lost on the way. The receiver only ever
+// gets newer states, the latest one it got is what it keeps, and gaps do not stop it.
+//
+bool testDatagramLoss() {
+
+	using namespace std;
+
+
+	StateServer server;
+	TEST_CHECK(server.Start());
+
+	olc::net::client_interface<NetMsg> client;
+	client.SetDatagramLoss(LOOPBACK_LOSS);
+	TEST_CHECK(client.Connect("127.0.0.1", LOOPBACK_PORT, true));
+
+	this_thread::sleep_for(chrono::milliseconds(300));
+	TEST_CHECK(client.IsConnected());
+
+
+	// Each state carries its number in the id, so the receiver can tell what it missed.
+	for (uint32_t i = 1; i <= LOOPBACK_STATES; i++) {
+
+		PlayerDescription desc;
+		desc.m_PlayerNetworkID = i;
+
+		auto msg = client.Pool().acquire(NetMsg::Game_UpdatePlayer);
+		writePlayerDescription(msg, desc);
+		client.SendDatagramState(std::move(msg), stateKey(NetMsg::Game_UpdatePlayer));
+
+		if (i % 50 == 0) {
+
+			this_thread::sleep_for(chrono::milliseconds(2));
+			server.Update(-1, false);
+		}
+	}
+
+	this_thread::sleep_for(chrono::milliseconds(100));
+	server.Update(-1, false);
+
+
+	size_t gaps = 0;
+	for (size_t i = 1; i < server.m_Received.size(); i++) {
+
+		if (server.m_Received[i] != server.m_Received[i - 1] + 1) gaps++;
+	}
+
+	cout << color(colors::CYAN);
+	cout << server.m_Received.size() << " of " << LOOPBACK_STATES << " states arrived with " << LOOPBACK_LOSS * 100.0f << "% loss, "
+		<< gaps << " gaps, the latest kept is " << server.m_Latest.m_PlayerNetworkID << "." << white << endl;
+
+
+	// Some got lost, most arrived, and after every gap the newer states were taken.
+	TEST_CHECK(server.m_Stale == 0);
+	TEST_CHECK(gaps > 0);
+	TEST_CHECK(server.m_Received.size() < LOOPBACK_STATES);
+	TEST_CHECK(server.m_Received.size() >= LOOPBACK_STATES / 2);
+	TEST_CHECK(server.m_Received.back() > LOOPBACK_STATES * 9 / 10);
+	TEST_CHECK(server.m_Latest.m_PlayerNetworkID == server.m_Received.back());
+
+	// Still connected, losing datagrams does not break the stream.
+	TEST_CHECK(client.IsConnected());
+
+	client.Disconnect();
+	server.Stop();
+
+	return true;
+}
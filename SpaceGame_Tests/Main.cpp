@@ -0,0 +1,81 @@
+#include"Main.h"
+
+
+
+// All tests and benchmarks, in the order they run.
+//
+static const TestCase g_Tests[] = {
+
+	{ "encoding_bit_stream", testBitStreamRoundTrip },
+	{ "encoding_player_description", testPlayerDescriptionRoundTrip },
+	{ "encoding_player_descriptions", testPlayerDescriptionsRoundTrip },
+	{ "encoding_snapshot", testSnapshotRoundTrip },
+	{ "encoding_protocol_version", testProtocolVersionEncoding },
+	{ "encoding_oversized_header", testOversizedMessageHeader },
+	{ "renderer_batch_splitting", testRendererBatchSplitting },
+	{ "renderer_texture_slots", testRendererTextureSlots },
+	{ "renderer_draw_counts", testRendererDrawCounts },
+	{ "renderer_blend_modes", testRendererBlendModes },
+	{ "renderer_layers", testRendererLayers },
+	{ "prediction_frame_rate", testPredictionFrameRate },
+	{ "prediction_zero_duration", testPredictionZeroDuration },
+	{ "lobby_slot_table_remove", testSlotTableRemove },
+	{ "loopback_snapshot_messages", testSnapshotMessagesPerTick },
+	{ "loopback_datagram_loss", testDatagramLoss },
+	{ "bench_message_allocations", benchMessageAllocations },
+	{ "bench_tick_allocations", benchTickAllocations },
+	{ "bench_queue_contention", benchQueueContention },
+	{ "bench_io_thread_throughput", benchIOThreadThroughput },
+};
+
+
+
+int main(int argc, char** argv) {
+
+	using namespace std;
+
+
+	// Without arguments everything runs, otherwise only the tests starting with one of the arguments,
+	// e.g. "SpaceGame_Tests loopback".
+	//
+	auto selected = [&](const string& name) {
+
+		if (argc < 2) return true;
+
+		for (int i = 1; i < argc; i++) {
+
+			if (name.compare(0, strlen(argv[i]), argv[i]) == 0) return true;
+		}
+
+		return false;
+	};
+
+
+	int passed = 0;
+	int failed = 0;
+
+	for (const auto& test : g_Tests) {
+
+		if (!selected(test.m_Name)) continue;
+
+		cout << color(colors::YELLOW);
+		cout << "[" << test.m_Name << "]" << white << endl;
+
+		if (test.m_Function()) {
+
+			passed++;
+		}
+		else {
+
+			failed++;
+			cout << color(colors::RED);
+			cout << "[" << test.m_Name << "] failed." << white << endl;
+		}
+	}
+
+
+	cout << color(failed > 0 ? colors::RED : colors::GREEN);
+	cout << passed << " passed, " << failed << " failed." << white << endl;
+
+	return failed > 0 ? 1 : 0;
+}
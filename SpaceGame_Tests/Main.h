@@ -0,0 +1,77 @@
+#pragma once
+
+// Headless tests and benchmarks.
+// No window and no GPU are needed, the network tests talk over loopback.
+//
+#include"EngineInterface.h"
+
+#include<iostream>
+#include<string>
+#include<cstring>
+#include<vector>
+#include<chrono>
+#include<algorithm>
+
+
+
+// A test returns false if one of its checks failed.
+// Benchmarks print what they measured and only fail if something is plainly wrong.
+//
+using TestFunction = bool(*)();
+
+
+struct TestCase {
+
+	const char* m_Name;
+	TestFunction m_Function;
+};
+
+
+// Stop the test with a message if the condition does not hold.
+#define TEST_CHECK(condition) if (!(condition)) { std::cout << color(colors::RED) << "Check failed: " << #condition << " (" << __FILE__ << ":" << __LINE__ << ")" << white << std::endl; return false; }
+
+
+// Time in microseconds, only used for differences.
+inline uint64_t testMicroseconds() {
+
+	using namespace std::chrono;
+	return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+// See "LoopbackTests.cpp".
+bool testSnapshotMessagesPerTick();
+bool testDatagramLoss();
+
+// See "EncodingTests.cpp".
+bool testBitStreamRoundTrip();
+bool testPlayerDescriptionRoundTrip();
+bool testPlayerDescriptionsRoundTrip();
+bool testSnapshotRoundTrip();
+bool testProtocolVersionEncoding();
+bool testOversizedMessageHeader();
+
+// See "RendererTests.cpp".
+bool testRendererBatchSplitting();
+bool testRendererTextureSlots();
+bool testRendererDrawCounts();
+bool testRendererBlendModes();
+bool testRendererLayers();
+
+// See "PredictionTests.cpp".
+bool testPredictionFrameRate();
+bool testPredictionZeroDuration();
+
+// See "LobbyTests.cpp".
+bool testSlotTableRemove();
+
+// See "AllocationBench.cpp".
+bool benchMessageAllocations();
+bool benchTickAllocations();
+
+// See "QueueBench.cpp".
+bool benchQueueContention();
+
+// See "ThroughputBench.cpp".
+bool benchIOThreadThroughput();
@@ -0,0 +1,104 @@
+#include"Main.h"
+
+#include<cmath>
+
+
+using namespace nautilus::network;
+
+
+#define PREDICTION_TOLERANCE 1e-3f // Float rounding over many inputs.
+
+
+
+// Whether the ship moved the same in both.
+static bool _sameMotion(const PlayerDescription& a, const PlayerDescription& b) {
+
+	return std::fabs(a.m_PlayerPositionX - b.m_PlayerPositionX) <= PREDICTION_TOLERANCE &&
+		std::fabs(a.m_PlayerPositionY - b.m_PlayerPositionY) <= PREDICTION_TOLERANCE &&
+		std::fabs(a.m_PlayerVelocityX - b.m_PlayerVelocityX) <= PREDICTION_TOLERANCE &&
+		std::fabs(a.m_PlayerVelocityY - b.m_PlayerVelocityY) <= PREDICTION_TOLERANCE &&
+		std::fabs(a.m_PlayerRotation - b.m_PlayerRotation) <= PREDICTION_TOLERANCE;
+}
+
+
+// Apply "count" inputs of "dt" seconds each, all with the same move and turn.
+static PlayerDescription _simulate(PlayerDescription desc, int count, float dt, float moveX, float moveY, float turn) {
+
+	for (int i = 0; i < count; i++) simulatePlayer(desc, makePlayerInput(i + 1, moveX, moveY, turn, false, dt));
+
+	return desc;
+}
+
+
+
+// The same time of input moves a ship the same, however it is split into frames.
+// So a client with a higher frame rate, or one sending more inputs, is not faster.
+//
+bool testPredictionFrameRate() {
+
+	using namespace std;
+
+
+	PlayerDescription start;
+	start.m_PlayerPositionX = 10.0f;
+	start.m_PlayerPositionY = -20.0f;
+	start.m_PlayerVelocityX = 30.0f;
+	start.m_PlayerVelocityY = -5.0f;
+
+
+	// 1 x 16 ms and 16 x 1 ms.
+	PlayerDescription once = _simulate(start, 1, 0.016f, 1.5f, -0.5f, 0.3f);
+	PlayerDescription split = _simulate(start, 16, 0.001f, 1.5f, -0.5f, 0.3f);
+
+	TEST_CHECK(_sameMotion(once, split));
+	TEST_CHECK(once.m_PlayerPositionX != start.m_PlayerPositionX);
+
+
+	// A second at 4, 10, 50 and 250 inputs per second.
+	PlayerDescription reference = _simulate(start, 4, 0.25f, -2.0f, 1.0f, -0.5f);
+
+	for (int frames : { 10, 50, 250 }) {
+
+		PlayerDescription second = _simulate(start, frames, 1.0f / frames, -2.0f, 1.0f, -0.5f);
+
+		cout << color(colors::CYAN);
+		cout << frames << " inputs per second: at " << second.m_PlayerPositionX << ", " << second.m_PlayerPositionY
+			<< ", 4 per second: at " << reference.m_PlayerPositionX << ", " << reference.m_PlayerPositionY << "." << white << endl;
+
+		TEST_CHECK(_sameMotion(reference, second));
+	}
+
+
+	// Without input the ship comes to rest.
+	PlayerDescription coasting = _simulate(start, 100, 0.1f, 0.0f, 0.0f, 0.0f);
+	TEST_CHECK(coasting.m_PlayerVelocityX == 0.0f && coasting.m_PlayerVelocityY == 0.0f);
+
+	return true;
+}
+
+
+
+// Inputs without duration do not move the ship, however many there are.
+// The shortest input a client makes has a duration.
+//
+bool testPredictionZeroDuration() {
+
+	PlayerDescription start;
+	start.m_PlayerVelocityX = 10.0f;
+
+	PlayerInput input = makePlayerInput(1, g_InputMoveMax, g_InputMoveMax, g_InputTurnMax, false, 0.1f);
+	input.m_DeltaTimeMs = 0;
+
+	PlayerDescription desc = start;
+	for (int i = 0; i < 255; i++) simulatePlayer(desc, input);
+
+	TEST_CHECK(_sameMotion(desc, start));
+	TEST_CHECK(desc.m_PlayerVelocityX == start.m_PlayerVelocityX);
+
+
+	TEST_CHECK(makePlayerInput(1, 0.0f, 0.0f, 0.0f, false, 0.0f).m_DeltaTimeMs == g_InputDeltaTimeMinMs);
+	TEST_CHECK(makePlayerInput(1, 0.0f, 0.0f, 0.0f, false, 0.0001f).m_DeltaTimeMs == g_InputDeltaTimeMinMs);
+	TEST_CHECK(makePlayerInput(1, 0.0f, 0.0f, 0.0f, false, 10.0f).m_DeltaTimeMs == (uint8_t)(g_InputDeltaTimeMax * 1000.0f));
+
+	return true;
+}
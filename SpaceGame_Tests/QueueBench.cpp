@@ -0,0 +1,145 @@
+#include"Main.h"
+
+#include<atomic>
+#include<thread>
+
+
+using namespace nautilus::network;
+
+
+#define QUEUE_MESSAGES 100000 // Messages each producer pushes.
+#define QUEUE_ROUNDS 3 // Best of these rounds counts, as other processes may get in the way.
+
+
+
+// The incoming queue the connections shared before, locked for each message,
+// and the consumer locking again for each "empty" and "pop_front".
+//
+static void _drainLocked(olc::net::tsqueue<olc::net::owned_message<NetMsg>>& queue, std::vector<olc::net::owned_message<NetMsg>>& out) {
+
+	while (!queue.empty()) out.push_back(queue.pop_front());
+}
+
+
+// The incoming queue now, the consumer takes everything pending at once.
+//
+static void _drainLockFree(olc::net::mpsc_queue<olc::net::owned_message<NetMsg>>& queue, std::vector<olc::net::owned_message<NetMsg>>& out) {
+
+	queue.drain(out);
+}
+
+
+
+// Messages per second through "Queue" with "producers" threads pushing like the I/O threads do,
+// while the game thread drains. Fails if a message is lost or the order of a producer is broken.
+//
+template<typename Queue, typename Drain>
+static bool _measureQueue(size_t producers, Drain drain, double& messagesPerSecond) {
+
+	using namespace std;
+
+
+	// The messages are made before, so only the queue is measured.
+	vector<vector<olc::net::owned_message<NetMsg>>> messages(producers);
+	for (uint32_t p = 0; p < producers; p++) {
+
+		messages[p].resize(QUEUE_MESSAGES);
+		for (uint32_t i = 0; i < QUEUE_MESSAGES; i++) messages[p][i].msg << p << i;
+	}
+
+
+	Queue queue;
+	atomic<bool> go{ false };
+
+	vector<thread> threads;
+	for (size_t p = 0; p < producers; p++) {
+
+		threads.emplace_back([&, p]() {
+
+			while (!go) this_thread::yield();
+
+			for (auto& msg : messages[p]) queue.push_back(std::move(msg));
+		});
+	}
+
+
+	vector<uint32_t> next(producers, 0);
+	vector<olc::net::owned_message<NetMsg>> batch;
+	batch.reserve(QUEUE_MESSAGES);
+
+	size_t received = 0;
+	bool ordered = true;
+
+	uint64_t start = testMicroseconds();
+	go = true;
+
+	while (received < producers * QUEUE_MESSAGES) {
+
+		batch.clear();
+		drain(queue, batch);
+
+		for (const auto& it : batch) {
+
+			uint32_t producer = 0;
+			uint32_t sequence = 0;
+
+			olc::net::message_reader<NetMsg> in(it.msg);
+			in >> producer >> sequence;
+
+			if (!in.good() || producer >= producers || sequence != next[producer]) ordered = false;
+			else next[producer]++;
+
+			received++;
+		}
+	}
+
+	uint64_t duration = testMicroseconds() - start;
+
+	for (auto& t : threads) t.join();
+
+
+	TEST_CHECK(ordered);
+
+	messagesPerSecond = (double)received * 1000000.0 / (double)std::max<uint64_t>(duration, 1);
+
+	return true;
+}
+
+
+
+// Incoming queue throughput with 1, 2, 4 and 8 producers,
+// the lock-free queue drained in batches against the locked one.
+//
+bool benchQueueContention() {
+
+	using namespace std;
+
+
+	using Message = olc::net::owned_message<NetMsg>;
+
+	for (size_t producers : { 1, 2, 4, 8 }) {
+
+		double locked = 0.0;
+		double lockFree = 0.0;
+
+		for (int i = 0; i < QUEUE_ROUNDS; i++) {
+
+			double messagesPerSecond = 0.0;
+
+			TEST_CHECK(_measureQueue<olc::net::tsqueue<Message>>(producers, _drainLocked, messagesPerSecond));
+			locked = std::max(locked, messagesPerSecond);
+
+			TEST_CHECK(_measureQueue<olc::net::mpsc_queue<Message>>(producers, _drainLockFree, messagesPerSecond));
+			lockFree = std::max(lockFree, messagesPerSecond);
+		}
+
+
+		cout << color(colors::CYAN);
+		cout << producers << " producers: " << (uint64_t)locked << " messages per second locked, "
+			<< (uint64_t)lockFree << " lock-free (" << lockFree / locked << "x)." << white << endl;
+
+		TEST_CHECK(lockFree > 0.0 && locked > 0.0);
+	}
+
+	return true;
+}
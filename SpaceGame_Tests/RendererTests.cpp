@@ -0,0 +1,506 @@
+#include"Main.h"
+
+#include<cmath>
+#include<random>
+
+
+using namespace nautilus::graphics;
+
+
+#define RENDERER_MAX_QUADS 20000 // Quads of one batch, see "RenderData2D::maxQuads".
+#define RENDERER_MAX_TEXTURES 32 // Texture slots of one batch, the first has the default texture.
+#define RENDERER_SEED 5
+
+
+
+// The batch renderer drawing into a "RecordingRenderBackend2D", as long as this lives.
+// So the tests run without a window and a GPU.
+//
+class RecordingRenderer {
+public:
+
+	RecordingRenderer() : m_Backend(true, true) {
+
+		BatchRenderer2D::setBackend(&m_Backend);
+		BatchRenderer2D::init();
+	}
+
+	~RecordingRenderer() {
+
+		BatchRenderer2D::shutDown();
+		BatchRenderer2D::setBackend(nullptr);
+	}
+
+
+	RecordingRenderBackend2D m_Backend;
+};
+
+
+
+// One batch as the backend got it: the vertices uploaded, the textures bound and the indices drawn.
+//
+struct RecordedBatch {
+
+	int m_Bytes = 0;
+	size_t m_DataOffset = 0;
+
+	std::vector<GLuint> m_Textures; // By slot.
+
+	int m_Indices = 0;
+
+
+	int quads() const { return m_Bytes / (4 * (int)sizeof(QuadVertex)); }
+
+	const QuadVertex* vertices(const RecordingRenderBackend2D& backend) const {
+
+		return (const QuadVertex*)(backend.getVertexData().data() + m_DataOffset);
+	}
+};
+
+
+// Split the recorded commands into batches.
+// Returns false if they are not in the order the batch renderer must send them.
+//
+static bool _recordedBatches(const RecordingRenderBackend2D& backend, std::vector<RecordedBatch>& batches) {
+
+	batches.clear();
+
+	bool inBatch = false;
+
+	for (const auto& command : backend.getCommands()) {
+
+		switch (command.m_Type) {
+		case RenderCommand::Type::UnmapVertices:
+
+			if (inBatch) return false;
+
+			batches.emplace_back();
+			batches.back().m_Bytes = command.m_Count;
+			batches.back().m_DataOffset = command.m_DataOffset;
+			inBatch = true;
+			break;
+
+		case RenderCommand::Type::BindTexture:
+
+			if (!inBatch || command.m_Count != (int)batches.back().m_Textures.size()) return false;
+
+			batches.back().m_Textures.push_back(command.m_Texture);
+			break;
+
+		case RenderCommand::Type::DrawIndexed:
+
+			if (!inBatch || command.m_Count != batches.back().quads() * 6) return false;
+
+			batches.back().m_Indices = command.m_Count;
+			inBatch = false;
+			break;
+
+		default:
+
+			// Scenes and blend modes only come between batches.
+			if (inBatch) return false;
+			break;
+		}
+	}
+
+	return !inBatch;
+}
+
+
+// Index of the sprite drawn by the quad, as the tests place sprite i at x = i.
+static int _spriteOfQuad(const QuadVertex* quad) {
+
+	float x = 0.0f;
+	for (int i = 0; i < 4; i++) x += quad[i].Position.x;
+
+	return (int)std::lround(x / 4.0f);
+}
+
+
+// "count" sprites of scale 1, sprite i at x = i, with the textures in turn.
+static std::vector<SpriteInstance> _spriteRow(size_t count, std::vector<ComponentTexture2D>& textures) {
+
+	std::vector<SpriteInstance> sprites(count);
+
+	for (size_t i = 0; i < count; i++) {
+
+		sprites[i].m_Position = glm::vec2((float)i, 0.0f);
+		sprites[i].m_Texture = textures.empty() ? nullptr : &textures[i % textures.size()];
+	}
+
+	return sprites;
+}
+
+
+// Textures told apart only by theyre handle, which is 1 + index.
+static std::vector<ComponentTexture2D> _textures(size_t count) {
+
+	std::vector<ComponentTexture2D> textures(count);
+	for (size_t i = 0; i < count; i++) textures[i].SetHandle((GLuint)(1 + i));
+
+	return textures;
+}
+
+
+
+// A scene of more quads than fit into a batch is drawn in full batches and the rest,
+// each with theyre own upload and draw call.
+//
+bool testRendererBatchSplitting() {
+
+	RecordingRenderer renderer;
+
+	std::vector<ComponentTexture2D> textures;
+	std::vector<SpriteInstance> sprites = _spriteRow(2 * RENDERER_MAX_QUADS + 100, textures);
+
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	BatchRenderer2D::drawSprites(sprites);
+	BatchRenderer2D::endScene();
+
+
+	const BatchRenderer2DStats& stats = BatchRenderer2D::getStats();
+	TEST_CHECK(stats.m_Batches == 3);
+	TEST_CHECK(stats.m_Quads == sprites.size());
+	TEST_CHECK(stats.m_QuadCapacityFlushes == 2);
+	TEST_CHECK(stats.m_TextureSlotOverflows == 0);
+
+
+	std::vector<RecordedBatch> batches;
+	TEST_CHECK(_recordedBatches(renderer.m_Backend, batches));
+	TEST_CHECK(batches.size() == 3);
+
+	TEST_CHECK(batches[0].quads() == RENDERER_MAX_QUADS);
+	TEST_CHECK(batches[1].quads() == RENDERER_MAX_QUADS);
+	TEST_CHECK(batches[2].quads() == 100);
+
+
+	// Every sprite is drawn once, in the order it was given.
+	int next = 0;
+	for (const auto& batch : batches) {
+
+		TEST_CHECK(batch.m_Textures.size() == 1 && batch.m_Textures[0] == 0);
+
+		const QuadVertex* vertices = batch.vertices(renderer.m_Backend);
+		for (int i = 0; i < batch.quads(); i++) TEST_CHECK(_spriteOfQuad(&vertices[4 * i]) == next++);
+	}
+
+	TEST_CHECK(next == (int)sprites.size());
+
+	return true;
+}
+
+
+
+// More textures than slots split the batch, and each quad samples the slot its texture is bound to.
+//
+bool testRendererTextureSlots() {
+
+	RecordingRenderer renderer;
+
+	// The first batch has room for 31 textures besides the default one, as has the second.
+	std::vector<ComponentTexture2D> textures = _textures(64);
+	std::vector<SpriteInstance> sprites = _spriteRow(3 * textures.size(), textures);
+
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	BatchRenderer2D::drawSprites(sprites);
+	BatchRenderer2D::endScene();
+
+
+	const BatchRenderer2DStats& stats = BatchRenderer2D::getStats();
+	TEST_CHECK(stats.m_QuadCapacityFlushes == 0);
+	TEST_CHECK(stats.m_TextureSlotOverflows == stats.m_Batches - 1);
+
+
+	std::vector<RecordedBatch> batches;
+	TEST_CHECK(_recordedBatches(renderer.m_Backend, batches));
+	TEST_CHECK(batches.size() == stats.m_Batches);
+
+	for (const auto& batch : batches) {
+
+		TEST_CHECK(batch.m_Textures.size() <= RENDERER_MAX_TEXTURES);
+		TEST_CHECK(batch.m_Textures[0] == 0);
+
+
+		// A texture is bound to one slot only.
+		for (size_t i = 0; i < batch.m_Textures.size(); i++) {
+
+			for (size_t j = i + 1; j < batch.m_Textures.size(); j++) TEST_CHECK(batch.m_Textures[i] != batch.m_Textures[j]);
+		}
+
+
+		const QuadVertex* vertices = batch.vertices(renderer.m_Backend);
+		for (int i = 0; i < batch.quads(); i++) {
+
+			const SpriteInstance& sprite = sprites[_spriteOfQuad(&vertices[4 * i])];
+
+			for (int k = 0; k < 4; k++) {
+
+				int slot = (int)vertices[4 * i + k].TextureIndex;
+
+				TEST_CHECK(slot > 0 && slot < (int)batch.m_Textures.size());
+				TEST_CHECK(batch.m_Textures[slot] == sprite.m_Texture->GetSlot());
+			}
+		}
+	}
+
+	return true;
+}
+
+
+
+// Draw calls, indices and uploaded bytes the backend got are what the stats tell,
+// a scene drawing nothing draws nothing, and "draw" with a matrix gives the quads "drawSprites" gives.
+//
+bool testRendererDrawCounts() {
+
+	RecordingRenderer renderer;
+
+	std::mt19937 random(RENDERER_SEED);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<ComponentTexture2D> textures = _textures(4);
+	std::vector<SpriteInstance> sprites = _spriteRow(1000, textures);
+
+	for (auto& sprite : sprites) {
+
+		sprite.m_Position.y = 100.0f * unit(random);
+		sprite.m_Scale = glm::vec2(1.0f + unit(random), 1.0f + unit(random));
+		sprite.m_Rotation = 3.0f * unit(random);
+		sprite.m_Color = glm::vec4(0.1f, 0.2f, 0.3f, 0.4f);
+		sprite.m_TextureRect = glm::vec4(0.25f, 0.5f, 0.75f, 1.0f);
+	}
+
+
+	// Nothing drawn.
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	BatchRenderer2D::endScene();
+
+	TEST_CHECK(BatchRenderer2D::getStats().m_Batches == 0);
+	TEST_CHECK(renderer.m_Backend.getCounters().m_Scenes == 1);
+	TEST_CHECK(renderer.m_Backend.getCounters().m_DrawCalls == 0);
+
+
+	// The same sprites with "drawSprites" and with "draw".
+	renderer.m_Backend.clear();
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	BatchRenderer2D::drawSprites(sprites);
+	BatchRenderer2D::endScene();
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	for (const auto& sprite : sprites) {
+
+		ComponentMemoryProtocol2D memoryProtocol;
+		memoryProtocol.m_TextureCoords[0] = glm::vec2(sprite.m_TextureRect.x, sprite.m_TextureRect.y);
+		memoryProtocol.m_TextureCoords[1] = glm::vec2(sprite.m_TextureRect.z, sprite.m_TextureRect.y);
+		memoryProtocol.m_TextureCoords[2] = glm::vec2(sprite.m_TextureRect.z, sprite.m_TextureRect.w);
+		memoryProtocol.m_TextureCoords[3] = glm::vec2(sprite.m_TextureRect.x, sprite.m_TextureRect.w);
+
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(sprite.m_Position, sprite.m_Depth));
+		model = glm::rotate(model, sprite.m_Rotation, glm::vec3(0.0f, 0.0f, 1.0f));
+		model = glm::scale(model, glm::vec3(sprite.m_Scale, 1.0f));
+
+		BatchRenderer2D::draw(&memoryProtocol, model, sprite.m_Texture, sprite.m_Color);
+	}
+	BatchRenderer2D::endScene();
+
+
+	const RenderBackendCounters& counters = renderer.m_Backend.getCounters();
+	TEST_CHECK(counters.m_Scenes == 2);
+	TEST_CHECK(counters.m_DrawCalls == 2);
+	TEST_CHECK(counters.m_Uploads == 2);
+	TEST_CHECK(counters.m_Indices == 2 * 6 * sprites.size());
+	TEST_CHECK(counters.m_UploadedBytes == 2 * 4 * sizeof(QuadVertex) * sprites.size());
+	TEST_CHECK(counters.m_TextureBinds == 2 * (1 + textures.size()));
+	TEST_CHECK(counters.m_BlendModeChanges == 0);
+
+
+	std::vector<RecordedBatch> batches;
+	TEST_CHECK(_recordedBatches(renderer.m_Backend, batches));
+	TEST_CHECK(batches.size() == 2);
+	TEST_CHECK(batches[0].m_Textures == batches[1].m_Textures);
+
+	const float* a = (const float*)batches[0].vertices(renderer.m_Backend);
+	const float* b = (const float*)batches[1].vertices(renderer.m_Backend);
+
+	for (size_t i = 0; i < batches[0].m_Bytes / sizeof(float); i++) TEST_CHECK(std::fabs(a[i] - b[i]) < 1e-3f);
+
+	return true;
+}
+
+
+
+// Changing the blend mode draws what is there with the old one,
+// setting the same mode again changes nothing and each scene ends with alpha blending.
+//
+bool testRendererBlendModes() {
+
+	RecordingRenderer renderer;
+
+	std::vector<ComponentTexture2D> textures;
+	std::vector<SpriteInstance> sprites = _spriteRow(30, textures);
+
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+
+	BatchRenderer2D::drawSprites(&sprites[0], 10);
+	BatchRenderer2D::setBlendMode(BlendMode::Additive);
+	BatchRenderer2D::drawSprites(&sprites[10], 10);
+	BatchRenderer2D::setBlendMode(BlendMode::Additive);
+	BatchRenderer2D::drawSprites(&sprites[20], 10);
+
+	BatchRenderer2D::endScene();
+
+
+	const BatchRenderer2DStats& stats = BatchRenderer2D::getStats();
+	TEST_CHECK(stats.m_Batches == 2);
+	TEST_CHECK(stats.m_BlendModeChanges == 1);
+
+
+	// Scene, alpha batch, additive, additive batch, back to alpha.
+	const std::vector<RenderCommand>& commands = renderer.m_Backend.getCommands();
+
+	std::vector<RenderCommand::Type> types;
+	std::vector<int> modes;
+	for (const auto& command : commands) {
+
+		if (command.m_Type == RenderCommand::Type::BindTexture) continue;
+
+		types.push_back(command.m_Type);
+		if (command.m_Type == RenderCommand::Type::SetBlendMode) modes.push_back(command.m_Count);
+	}
+
+	const std::vector<RenderCommand::Type> expected = {
+		RenderCommand::Type::BeginScene,
+		RenderCommand::Type::UnmapVertices, RenderCommand::Type::DrawIndexed,
+		RenderCommand::Type::SetBlendMode,
+		RenderCommand::Type::UnmapVertices, RenderCommand::Type::DrawIndexed,
+		RenderCommand::Type::SetBlendMode
+	};
+
+	TEST_CHECK(types == expected);
+	TEST_CHECK(modes.size() == 2 && modes[0] == (int)BlendMode::Additive && modes[1] == (int)BlendMode::Alpha);
+
+
+	std::vector<RecordedBatch> batches;
+	TEST_CHECK(_recordedBatches(renderer.m_Backend, batches));
+	TEST_CHECK(batches.size() == 2 && batches[0].quads() == 10 && batches[1].quads() == 20);
+
+
+	// The next scene starts with alpha blending again, without telling the backend.
+	renderer.m_Backend.clear();
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	BatchRenderer2D::drawSprites(sprites);
+	BatchRenderer2D::setBlendMode(BlendMode::Alpha);
+	BatchRenderer2D::endScene();
+
+	TEST_CHECK(renderer.m_Backend.getCounters().m_BlendModeChanges == 0);
+	TEST_CHECK(renderer.m_Backend.getCounters().m_DrawCalls == 1);
+
+	return true;
+}
+
+
+
+// Submitted sprites are drawn layer after layer, within a layer by blend mode and texture,
+// and those with the same key in the order they came. Sorting so gives fewer batches than drawing as submitted.
+//
+bool testRendererLayers() {
+
+	RecordingRenderer renderer;
+
+	std::mt19937 random(RENDERER_SEED);
+
+	std::vector<ComponentTexture2D> textures = _textures(64);
+	std::vector<SpriteInstance> sprites = _spriteRow(5000, textures);
+
+	std::vector<RenderLayer> layers(sprites.size());
+	std::vector<BlendMode> blends(sprites.size());
+
+	for (size_t i = 0; i < sprites.size(); i++) {
+
+		sprites[i].m_Texture = &textures[random() % textures.size()];
+		layers[i] = (RenderLayer)(64 * (random() % 4));
+		blends[i] = (random() % 8 == 0) ? BlendMode::Additive : BlendMode::Alpha;
+	}
+
+
+	// As submitted.
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	BatchRenderer2D::drawSprites(sprites);
+	BatchRenderer2D::endScene();
+
+	uint32_t unsortedBatches = BatchRenderer2D::getStats().m_Batches;
+
+
+	// Sorted.
+	renderer.m_Backend.clear();
+
+	BatchRenderer2D::beginScene(glm::mat4(1.0f));
+	for (size_t i = 0; i < sprites.size(); i++) BatchRenderer2D::submit(sprites[i], layers[i], blends[i]);
+	BatchRenderer2D::endScene();
+
+	const BatchRenderer2DStats& stats = BatchRenderer2D::getStats();
+	TEST_CHECK(stats.m_QueuedSprites == sprites.size());
+	TEST_CHECK(stats.m_Quads == sprites.size());
+
+
+	std::cout << color(colors::CYAN);
+	std::cout << sprites.size() << " sprites of " << textures.size() << " textures: " << unsortedBatches << " batches as submitted, "
+		<< stats.m_Batches << " sorted, " << stats.m_BlendModeChanges << " blend mode changes." << white << std::endl;
+
+	TEST_CHECK(stats.m_Batches < unsortedBatches);
+
+
+	// Which blend mode each batch was drawn with.
+	std::vector<RecordedBatch> batches;
+	TEST_CHECK(_recordedBatches(renderer.m_Backend, batches));
+
+	std::vector<BlendMode> batchBlends;
+	BlendMode blend = BlendMode::Alpha;
+	for (const auto& command : renderer.m_Backend.getCommands()) {
+
+		if (command.m_Type == RenderCommand::Type::SetBlendMode) blend = (BlendMode)command.m_Count;
+		if (command.m_Type == RenderCommand::Type::DrawIndexed) batchBlends.push_back(blend);
+	}
+
+	TEST_CHECK(batchBlends.size() == batches.size());
+
+
+	std::vector<bool> drawn(sprites.size(), false);
+	int previous = -1;
+
+	for (size_t b = 0; b < batches.size(); b++) {
+
+		const QuadVertex* vertices = batches[b].vertices(renderer.m_Backend);
+
+		for (int i = 0; i < batches[b].quads(); i++) {
+
+			int sprite = _spriteOfQuad(&vertices[4 * i]);
+
+			TEST_CHECK(sprite >= 0 && sprite < (int)sprites.size() && !drawn[sprite]);
+			drawn[sprite] = true;
+
+			TEST_CHECK(blends[sprite] == batchBlends[b]);
+
+
+			if (previous >= 0) {
+
+				uint64_t before = RenderQueue2D::makeSortKey(layers[previous], blends[previous], 0, sprites[previous].m_Texture, sprites[previous].m_Depth);
+				uint64_t after = RenderQueue2D::makeSortKey(layers[sprite], blends[sprite], 0, sprites[sprite].m_Texture, sprites[sprite].m_Depth);
+
+				TEST_CHECK(layers[previous] <= layers[sprite]);
+				TEST_CHECK(before < after || (before == after && previous < sprite));
+			}
+
+			previous = sprite;
+		}
+	}
+
+	TEST_CHECK(std::find(drawn.begin(), drawn.end(), false) == drawn.end());
+
+	return true;
+}
@@ -0,0 +1,134 @@
+#include"Main.h"
+
+#include<atomic>
+#include<thread>
+
+
+using namespace nautilus::network;
+
+
+#define THROUGHPUT_PORT 7792
+#define THROUGHPUT_CLIENTS 32 // Each with a thread of its own, sending as fast as the server echoes.
+#define THROUGHPUT_IN_FLIGHT 64 // Messages a client sends before it waits for the echoes.
+#define THROUGHPUT_WARMUP_MS 1000
+#define THROUGHPUT_MEASURE_MS 2000
+
+
+
+// Sends every message straight back, so the I/O threads do all the work.
+//
+class ThroughputServer : public olc::net::server_interface<NetMsg> {
+public:
+
+	ThroughputServer(size_t ioThreads) : olc::net::server_interface<NetMsg>(THROUGHPUT_PORT, false, ioThreads) {}
+
+
+	bool OnClientConnect(std::shared_ptr<olc::net::connection<NetMsg>>) override { return true; }
+
+
+	void OnMessage(std::shared_ptr<olc::net::connection<NetMsg>> client, olc::net::message<NetMsg>& msg) override {
+
+		MessageClient(client, std::move(msg));
+	}
+};
+
+
+
+// Messages per second echoed by a server with "ioThreads" threads.
+//
+static bool _measureThroughput(size_t ioThreads, double& messagesPerSecond) {
+
+	using namespace std;
+
+
+	ThroughputServer server(ioThreads);
+	TEST_CHECK(server.Start());
+
+	vector<unique_ptr<olc::net::client_interface<NetMsg>>> clients;
+	for (int i = 0; i < THROUGHPUT_CLIENTS; i++) {
+
+		clients.push_back(make_unique<olc::net::client_interface<NetMsg>>());
+		TEST_CHECK(clients.back()->Connect("127.0.0.1", THROUGHPUT_PORT));
+	}
+
+	this_thread::sleep_for(chrono::milliseconds(500));
+
+
+	atomic<bool> running{ true };
+	atomic<uint64_t> echoed{ 0 };
+
+
+	// The game thread only hands the messages back.
+	thread game([&]() { while (running) server.Update(-1, false); });
+
+
+	vector<thread> senders;
+	for (auto& it : clients) {
+
+		senders.emplace_back([&, client = it.get()]() {
+
+			PlayerDescription desc;
+			int inFlight = 0;
+
+			while (running) {
+
+				for (; inFlight < THROUGHPUT_IN_FLIGHT; inFlight++) {
+
+					auto msg = client->Pool().acquire(NetMsg::Game_UpdatePlayer);
+					writePlayerDescription(msg, desc);
+					client->Send(std::move(msg));
+				}
+
+				while (!client->Incoming().empty()) {
+
+					client->Pool().release(client->Incoming().pop_front().msg);
+					inFlight--;
+					echoed++;
+				}
+
+				this_thread::yield();
+			}
+		});
+	}
+
+
+	this_thread::sleep_for(chrono::milliseconds(THROUGHPUT_WARMUP_MS));
+
+	uint64_t before = echoed;
+	uint64_t start = testMicroseconds();
+
+	this_thread::sleep_for(chrono::milliseconds(THROUGHPUT_MEASURE_MS));
+
+	messagesPerSecond = (double)(echoed - before) * 1000000.0 / (double)(testMicroseconds() - start);
+
+
+	running = false;
+	game.join();
+	for (auto& sender : senders) sender.join();
+
+	return true;
+}
+
+
+
+// Echo throughput of the server with 1, 2, 4 and 8 I/O threads,
+// for as many clients as the machine can keep busy.
+//
+bool benchIOThreadThroughput() {
+
+	using namespace std;
+
+
+	for (size_t ioThreads : { 1, 2, 4, 8 }) {
+
+		double messagesPerSecond = 0.0;
+		TEST_CHECK(_measureThroughput(ioThreads, messagesPerSecond));
+
+		cout << color(colors::CYAN);
+		cout << ioThreads << " I/O threads: " << (uint64_t)messagesPerSecond << " messages per second echoed." << white << endl;
+
+		TEST_CHECK(messagesPerSecond > 0.0);
+	}
+
+	return true;
+}
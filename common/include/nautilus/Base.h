@@ -59,8 +59,10 @@ namespace nautilus {
 #include<thread>
 #include<string>
 #include<map>
+#include<unordered_map>
 #include<chrono>
 #include<array>
+#include<cmath>
 
 
 
@@ -54,7 +54,9 @@ namespace nautilus {
 				m_FilePath = fileName; // Save path for resource manager.
 
 				// Create texture object.
+				Release();
 				glGenTextures(1, &m_TextureHandle);
+				m_OwnsTexture = true;
 
 
 				glBindTexture(GL_TEXTURE_2D, m_TextureHandle);
@@ -92,6 +94,15 @@ namespace nautilus {
 			}
 		}
 
+		void ComponentTexture2D::Release() {
+
+			if (m_OwnsTexture && m_TextureHandle != 0) glDeleteTextures(1, &m_TextureHandle);
+
+			m_TextureHandle = 0;
+			m_OwnsTexture = false;
+		}
+
+
 		void ComponentTexture2D::Bind(GLuint texUint) {
 
             // To bind try too...
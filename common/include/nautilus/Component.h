@@ -75,6 +75,13 @@ namespace nautilus {
 			void Unbind(GLuint texUint = 0);
 			GLuint GetSlot() const { return m_TextureHandle; }
 
+			// Use a texture created elsewhere, or without a GPU only as id for the batch renderer.
+			void SetHandle(GLuint handle) { m_TextureHandle = handle; m_OwnsTexture = false; }
+
+			// Free the texture loaded by "LoadTexture".
+			// A texture given with "SetHandle" belongs to someone else and is kept.
+			void Release();
+
 
 
 			glm::vec2 GetSize()const { return m_Size; }
@@ -82,7 +89,8 @@ namespace nautilus {
 
 		private:
 
-			GLuint m_TextureHandle;
+			GLuint m_TextureHandle = 0;
+			bool m_OwnsTexture = false;
 
 			glm::vec2 m_Size = glm::vec2(0.0f);
 		};
@@ -0,0 +1,294 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// How a "PlayerDescription" is written into a message.
+		//
+		// Raw copies the struct as it is in memory.
+		// Quantized packs each field into as few bits as its range needs, see "writePlayerQuantized".
+		//
+		enum class WireEncoding : uint8_t {
+
+			Raw,
+			Quantized
+		};
+
+
+		// The encoding is chosen per message type.
+		// Client and server must use the same choice, so change it only on both sides alike,
+		// e.g. to measure the size of the raw encoding.
+		//
+		inline std::map<NetMsg, WireEncoding>& wireEncodings() {
+
+			static std::map<NetMsg, WireEncoding> encodings = {
+
+				{ NetMsg::Client_RegisterWithServer, WireEncoding::Quantized },
+				{ NetMsg::Game_AddPlayer, WireEncoding::Quantized },
+				{ NetMsg::Game_AddPlayers, WireEncoding::Quantized },
+				{ NetMsg::Game_UpdatePlayer, WireEncoding::Quantized },
+				{ NetMsg::Game_WorldSnapshot, WireEncoding::Quantized },
+			};
+
+			return encodings;
+		}
+
+
+		inline WireEncoding getWireEncoding(NetMsg id) {
+
+			auto it = wireEncodings().find(id);
+			return (it == wireEncodings().end()) ? WireEncoding::Raw : it->second;
+		}
+
+
+		inline void setWireEncoding(NetMsg id, WireEncoding encoding) {
+
+			wireEncodings()[id] = encoding;
+		}
+
+
+
+		// Ranges of the quantized fields.
+		// Values outside are clamped.
+		//
+		static const float g_WorldMin = -2048.0f;
+		static const float g_WorldMax = 2048.0f;
+		static const uint32_t g_PositionBits = 20; // ~0.004 world units.
+
+		static const float g_VelocityMax = 256.0f;
+		static const uint32_t g_VelocityBits = 16; // ~0.008 world units per second.
+
+		static const uint32_t g_RotationBits = 16; // ~0.0001 radians.
+
+		static const uint32_t g_HealthBits = 16;
+		static const uint32_t g_ShipBits = 2;
+
+		// Bits of a whole quantized player description, see "writePlayerQuantized".
+		static const uint32_t g_PlayerQuantizedBits = 32 + 2 * g_HealthBits + 2 * g_PositionBits + 2 * g_VelocityBits + g_RotationBits + g_ShipBits;
+
+
+
+		// Map a value in [min, max] to an integer with the given count of bits, and back.
+		// Quantizing a dequantized value gives the same integer again,
+		// so values can be passed on without losing more precision.
+		//
+		inline uint32_t quantize(float value, float min, float max, uint32_t bits) {
+
+			const uint32_t steps = (1u << bits) - 1;
+
+			if (!(value > min)) return 0; // NaN too.
+			if (value >= max) return steps;
+
+			return (uint32_t)std::lround((value - min) / (max - min) * steps);
+		}
+
+
+		inline float dequantize(uint32_t value, float min, float max, uint32_t bits) {
+
+			const uint32_t steps = (1u << bits) - 1;
+
+			return min + (max - min) * ((float)value / (float)steps);
+		}
+
+
+		// Rotation wraps around, so any angle is mapped into [0, 2pi).
+		//
+		inline uint32_t quantizeRotation(float radians) {
+
+			const float twoPi = 6.28318530718f;
+			const uint32_t steps = 1u << g_RotationBits;
+
+			float turns = radians / twoPi;
+			turns -= std::floor(turns);
+
+			return (uint32_t)std::lround(turns * steps) & (steps - 1);
+		}
+
+
+		inline float dequantizeRotation(uint32_t value) {
+
+			const float twoPi = 6.28318530718f;
+			const uint32_t steps = 1u << g_RotationBits;
+
+			return twoPi * ((float)value / (float)steps);
+		}
+
+
+		inline uint32_t saturate(uint32_t value, uint32_t bits) {
+
+			const uint32_t max = (1u << bits) - 1;
+			return (value > max) ? max : value;
+		}
+
+
+
+		// Quantized fields of a player, one by one.
+		// Writer and reader must stay in the same order with the same bit counts.
+		//
+		inline void writeHealthQuantized(olc::net::bit_writer<NetMsg>& out, uint32_t v) { out.write(saturate(v, g_HealthBits), g_HealthBits); }
+		inline void writePositionQuantized(olc::net::bit_writer<NetMsg>& out, float v) { out.write(quantize(v, g_WorldMin, g_WorldMax, g_PositionBits), g_PositionBits); }
+		inline void writeVelocityQuantized(olc::net::bit_writer<NetMsg>& out, float v) { out.write(quantize(v, -g_VelocityMax, g_VelocityMax, g_VelocityBits), g_VelocityBits); }
+		inline void writeRotationQuantized(olc::net::bit_writer<NetMsg>& out, float v) { out.write(quantizeRotation(v), g_RotationBits); }
+
+		// Only the four playable ships fit, an invalid ship is sent as the default "Fighter".
+		inline void writeShipQuantized(olc::net::bit_writer<NetMsg>& out, PlayerDescription::PlayerRepresentation v) {
+
+			int ship = (int)v;
+			out.write((ship < 0 || ship > 3) ? 0 : (uint32_t)ship, g_ShipBits);
+		}
+
+
+		inline uint32_t readHealthQuantized(olc::net::bit_reader<NetMsg>& in) { return in.read(g_HealthBits); }
+		inline float readPositionQuantized(olc::net::bit_reader<NetMsg>& in) { return dequantize(in.read(g_PositionBits), g_WorldMin, g_WorldMax, g_PositionBits); }
+		inline float readVelocityQuantized(olc::net::bit_reader<NetMsg>& in) { return dequantize(in.read(g_VelocityBits), -g_VelocityMax, g_VelocityMax, g_VelocityBits); }
+		inline float readRotationQuantized(olc::net::bit_reader<NetMsg>& in) { return dequantizeRotation(in.read(g_RotationBits)); }
+		inline PlayerDescription::PlayerRepresentation readShipQuantized(olc::net::bit_reader<NetMsg>& in) { return (PlayerDescription::PlayerRepresentation)in.read(g_ShipBits); }
+
+
+
+		// Whole player description, quantized.
+		// 32 bit id, 16 bit health and armor, 20 bit positions,
+		// 16 bit velocities and rotation and 2 bit ship. 154 bits instead of 288.
+		//
+		inline void writePlayerQuantized(olc::net::bit_writer<NetMsg>& out, const PlayerDescription& desc) {
+
+			out.write(desc.m_PlayerNetworkID, 32);
+			writeHealthQuantized(out, desc.m_PlayerHealth);
+			writePositionQuantized(out, desc.m_PlayerPositionX);
+			writePositionQuantized(out, desc.m_PlayerPositionY);
+			writeHealthQuantized(out, desc.m_PlayerArmor);
+			writeVelocityQuantized(out, desc.m_PlayerVelocityX);
+			writeVelocityQuantized(out, desc.m_PlayerVelocityY);
+			writeRotationQuantized(out, desc.m_PlayerRotation);
+			writeShipQuantized(out, desc.m_PlayerShip);
+		}
+
+
+		inline void readPlayerQuantized(olc::net::bit_reader<NetMsg>& in, PlayerDescription& desc) {
+
+			desc.m_PlayerNetworkID = in.read(32);
+			desc.m_PlayerHealth = readHealthQuantized(in);
+			desc.m_PlayerPositionX = readPositionQuantized(in);
+			desc.m_PlayerPositionY = readPositionQuantized(in);
+			desc.m_PlayerArmor = readHealthQuantized(in);
+			desc.m_PlayerVelocityX = readVelocityQuantized(in);
+			desc.m_PlayerVelocityY = readVelocityQuantized(in);
+			desc.m_PlayerRotation = readRotationQuantized(in);
+			desc.m_PlayerShip = readShipQuantized(in);
+		}
+
+
+
+		// Write a player description into the message,
+		// in the encoding chosen for the type of the message.
+		//
+		inline void writePlayerDescription(olc::net::message<NetMsg>& msg, const PlayerDescription& desc) {
+
+			if (getWireEncoding(msg.header.id) == WireEncoding::Quantized) {
+
+				olc::net::bit_writer<NetMsg> out(msg);
+				writePlayerQuantized(out, desc);
+			}
+			else {
+
+				msg << desc;
+			}
+		}
+
+
+		// Read a player description written by "writePlayerDescription".
+		// Returns false if the message is too short.
+		//
+		inline bool readPlayerDescription(const olc::net::message<NetMsg>& msg, PlayerDescription& desc) {
+
+			if (getWireEncoding(msg.header.id) == WireEncoding::Quantized) {
+
+				olc::net::bit_reader<NetMsg> in(msg);
+				readPlayerQuantized(in, desc);
+				return in.good();
+			}
+			else {
+
+				olc::net::message_reader<NetMsg> in(msg);
+				in >> desc;
+				return in.good();
+			}
+		}
+
+
+
+		// Most players one "Game_AddPlayers" message carries.
+		static const uint32_t g_PlayersPerMessageMax = 0xFFFF;
+
+
+		// Write many player descriptions into one message, e.g. all players
+		// a client gets to know when joining, instead of one message for each.
+		//
+		// Layout: count, and the descriptions as "writePlayerDescription" writes them.
+		// Quantized this is 16 bits for the count and 154 bits per player, packed without gaps.
+		//
+		template<typename Iterator>
+		inline void writePlayerDescriptions(olc::net::message<NetMsg>& msg, Iterator first, Iterator last) {
+
+			uint32_t count = (uint32_t)std::min<size_t>((size_t)std::distance(first, last), g_PlayersPerMessageMax);
+
+			if (getWireEncoding(msg.header.id) == WireEncoding::Quantized) {
+
+				olc::net::bit_writer<NetMsg> out(msg);
+
+				out.write(count, 16);
+				for (uint32_t i = 0; i < count; i++, ++first) writePlayerQuantized(out, *first);
+			}
+			else {
+
+				msg << count;
+				for (uint32_t i = 0; i < count; i++, ++first) msg << *first;
+			}
+		}
+
+
+		// Read the descriptions written by "writePlayerDescriptions" into "out".
+		// Returns false if the message is malformed.
+		//
+		inline bool readPlayerDescriptions(const olc::net::message<NetMsg>& msg, std::vector<PlayerDescription>& out) {
+
+			out.clear();
+
+			if (getWireEncoding(msg.header.id) == WireEncoding::Quantized) {
+
+				olc::net::bit_reader<NetMsg> in(msg);
+
+				uint32_t count = in.read(16);
+				for (uint32_t i = 0; i < count && in.good(); i++) {
+
+					PlayerDescription desc;
+					readPlayerQuantized(in, desc);
+					if (in.good()) out.push_back(desc);
+				}
+
+				return in.good();
+			}
+			else {
+
+				olc::net::message_reader<NetMsg> in(msg);
+
+				uint32_t count = 0;
+				in >> count;
+				for (uint32_t i = 0; i < count && in.good(); i++) {
+
+					PlayerDescription desc;
+					in >> desc;
+					if (in.good()) out.push_back(desc);
+				}
+
+				return in.good();
+			}
+		}
+
+	}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Uniform grid over the game world for area of interest queries.
+		//
+		// Each player is put into the cell containing its position,
+		// cells are hashed, so the world does not need bounds.
+		// Finding all players around a point only looks at the cells
+		// the interest radius overlaps, not at every player.
+		//
+		// The grid is cheap to rebuild, so the server rebuilds it every tick.
+		//
+		class InterestGrid {
+		public:
+
+			InterestGrid(float cellSize) : m_CellSize(cellSize > 0.0f ? cellSize : 1.0f) {}
+
+
+			void clear() {
+
+				// Cells nobody was in since the last rebuild are dropped, so the grid does not keep every cell ever visited.
+				// The others keep theyre vectors, so rebuilding each tick does not allocate.
+				for (auto it = m_Cells.begin(); it != m_Cells.end();) {
+
+					if (it->second.empty()) {
+
+						it = m_Cells.erase(it);
+					}
+					else {
+
+						it->second.clear();
+						++it;
+					}
+				}
+			}
+
+
+			size_t cellCount() const { return m_Cells.size(); }
+
+
+			void insert(uint32_t id, float x, float y) {
+
+				m_Cells[_key(_cell(x), _cell(y))].push_back({ id, x, y });
+			}
+
+
+			// Append the ids of all players within "radius" of the point to "out".
+			//
+			void query(float x, float y, float radius, std::vector<uint32_t>& out) const {
+
+				const float radiusSquared = radius * radius;
+
+				int32_t minX = _cell(x - radius), maxX = _cell(x + radius);
+				int32_t minY = _cell(y - radius), maxY = _cell(y + radius);
+
+				for (int32_t cx = minX; cx <= maxX; cx++) {
+					for (int32_t cy = minY; cy <= maxY; cy++) {
+
+						auto cell = m_Cells.find(_key(cx, cy));
+						if (cell == m_Cells.end()) continue;
+
+						for (const auto& entry : cell->second) {
+
+							float dx = entry.x - x;
+							float dy = entry.y - y;
+							if (dx * dx + dy * dy <= radiusSquared) out.push_back(entry.id);
+						}
+					}
+				}
+			}
+
+
+		private:
+
+			struct Entry {
+
+				uint32_t id;
+				float x;
+				float y;
+			};
+
+
+			float m_CellSize;
+			std::unordered_map<uint64_t, std::vector<Entry>> m_Cells;
+
+
+		private:
+
+			int32_t _cell(float v) const {
+
+				return (int32_t)std::floor(v / m_CellSize);
+			}
+
+			static uint64_t _key(int32_t cx, int32_t cy) {
+
+				return ((uint64_t)(uint32_t)cx << 32) | (uint64_t)(uint32_t)cy;
+			}
+		};
+
+	}
+
+}
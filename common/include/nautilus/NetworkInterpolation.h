@@ -0,0 +1,200 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Count of states remembered for each remote player.
+		// At 20 ticks per second this is more than a second of movement.
+		//
+		static const uint32_t g_InterpolationBufferSize = 32;
+
+
+
+		// Estimate of the server time on the client.
+		//
+		// Snapshots are stamped with the server time of theyre tick,
+		// the difference to the local time they arrive at is smoothed,
+		// so uneven arrival of the datagrams does not move the estimate much.
+		//
+		// This includes the latency of the snapshots. Once the offset is measured
+		// with pings, see "LatencyEstimator", that one is used instead.
+		//
+		class ServerClock {
+		public:
+
+			void update(double serverTime, double localTime) {
+
+				if (m_Measured) return;
+
+				double offset = serverTime - localTime;
+
+				// First sample, or the server time jumped, e.g. after a stall.
+				if (!m_Synchronized || std::abs(offset - m_Offset) > 1.0) {
+
+					m_Offset = offset;
+					m_Synchronized = true;
+					return;
+				}
+
+				m_Offset += (offset - m_Offset) * 0.1;
+			}
+
+
+			// Offset of the server clock measured otherwise.
+			void synchronize(double offset) {
+
+				m_Offset = offset;
+				m_Synchronized = true;
+				m_Measured = true;
+			}
+
+
+			double serverTime(double localTime) const {
+
+				return localTime + m_Offset;
+			}
+
+
+			bool isSynchronized() const { return m_Synchronized; }
+
+
+		private:
+
+			double m_Offset = 0.0;
+			bool m_Synchronized = false;
+			bool m_Measured = false;
+		};
+
+
+
+		// States of one remote player received with the snapshots, stamped with the server time.
+		//
+		// The player is rendered a little in the past, between two states we already have,
+		// so it moves smoothly no matter how unevenly the snapshots arrive.
+		// If the newest state is older than the render time, e.g. because datagrams were lost,
+		// the player is moved on with its velocity, but only for a limited time.
+		//
+		// The states are kept in a ring, so receiving snapshots does not allocate.
+		//
+		class InterpolationBuffer {
+		public:
+
+			// Add the state of given server time.
+			// States older than the newest one are ignored, they arrived out of order.
+			//
+			void push(double time, const PlayerDescription& state) {
+
+				if (m_Count > 0 && time <= _at(m_Count - 1).m_Time) return;
+
+				m_States[(m_First + m_Count) % g_InterpolationBufferSize] = { time, state };
+
+				if (m_Count < g_InterpolationBufferSize) m_Count++;
+				else m_First = (m_First + 1) % g_InterpolationBufferSize;
+			}
+
+
+			// State at given server time.
+			// "maxExtrapolation" is how many seconds the player is moved on past the newest state.
+			// Returns false if no state was received yet.
+			//
+			bool sample(double time, float maxExtrapolation, PlayerDescription& out) const {
+
+				if (m_Count == 0) return false;
+
+
+				// Older than all we have, keep the oldest state.
+				if (time <= _at(0).m_Time) {
+
+					out = _at(0).m_State;
+					return true;
+				}
+
+
+				// Newer than all we have, move on with the velocity.
+				const TimedState& newest = _at(m_Count - 1);
+				if (time >= newest.m_Time) {
+
+					float ahead = std::min((float)(time - newest.m_Time), maxExtrapolation);
+
+					out = newest.m_State;
+					out.m_PlayerPositionX += out.m_PlayerVelocityX * ahead;
+					out.m_PlayerPositionY += out.m_PlayerVelocityY * ahead;
+					return true;
+				}
+
+
+				// Between two states.
+				uint32_t i = m_Count - 1;
+				while (i > 0 && _at(i - 1).m_Time > time) i--;
+
+				const TimedState& from = _at(i - 1);
+				const TimedState& to = _at(i);
+
+				float t = (float)((time - from.m_Time) / (to.m_Time - from.m_Time));
+
+				out = to.m_State;
+				out.m_PlayerPositionX = _lerp(from.m_State.m_PlayerPositionX, to.m_State.m_PlayerPositionX, t);
+				out.m_PlayerPositionY = _lerp(from.m_State.m_PlayerPositionY, to.m_State.m_PlayerPositionY, t);
+				out.m_PlayerVelocityX = _lerp(from.m_State.m_PlayerVelocityX, to.m_State.m_PlayerVelocityX, t);
+				out.m_PlayerVelocityY = _lerp(from.m_State.m_PlayerVelocityY, to.m_State.m_PlayerVelocityY, t);
+				out.m_PlayerRotation = _lerpAngle(from.m_State.m_PlayerRotation, to.m_State.m_PlayerRotation, t);
+
+				return true;
+			}
+
+
+			void clear() {
+
+				m_First = 0;
+				m_Count = 0;
+			}
+
+
+		private:
+
+			struct TimedState {
+
+				double m_Time = 0.0;
+				PlayerDescription m_State;
+			};
+
+
+			std::array<TimedState, g_InterpolationBufferSize> m_States;
+			uint32_t m_First = 0;
+			uint32_t m_Count = 0;
+
+
+		private:
+
+			// i-th state, oldest first.
+			const TimedState& _at(uint32_t i) const {
+
+				return m_States[(m_First + i) % g_InterpolationBufferSize];
+			}
+
+
+			static float _lerp(float a, float b, float t) {
+
+				return a + (b - a) * t;
+			}
+
+
+			// Rotations are not wrapped, take the shorter way around.
+			static float _lerpAngle(float a, float b, float t) {
+
+				const float twoPi = 6.28318530718f;
+
+				float delta = b - a;
+				delta -= twoPi * std::round(delta / twoPi);
+
+				return a + delta * t;
+			}
+		};
+
+	}
+
+}
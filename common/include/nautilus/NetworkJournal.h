@@ -0,0 +1,367 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+#include<string>
+#include<cstring>
+#include<cstddef>
+
+#ifdef _WIN32
+#include<windows.h>
+#else
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+#endif
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// A file mapped into memory.
+		//
+		// Writing is copying into memory, the system writes the pages to disk on its own,
+		// so the thread writing never waits for the disk.
+		//
+		class MappedFile {
+		public:
+
+			~MappedFile() { close(); }
+
+
+			// Create the file with the given size, or open an existing one with its size.
+			// Returns false if the file could not be opened or mapped.
+			//
+			bool open(const std::string& path, bool write, uint64_t size = 0) {
+
+				close();
+
+#ifdef _WIN32
+				m_File = CreateFileA(path.c_str(), write ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, nullptr,
+					write ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (m_File == INVALID_HANDLE_VALUE) return false;
+
+				if (!write) {
+
+					LARGE_INTEGER fileSize;
+					if (!GetFileSizeEx(m_File, &fileSize)) { close(); return false; }
+					size = (uint64_t)fileSize.QuadPart;
+				}
+
+				if (size == 0) { close(); return false; }
+
+				m_Mapping = CreateFileMappingA(m_File, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(size >> 32), (DWORD)size, nullptr);
+				if (!m_Mapping) { close(); return false; }
+
+				m_Data = (uint8_t*)MapViewOfFile(m_Mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)size);
+				if (!m_Data) { close(); return false; }
+#else
+				m_File = ::open(path.c_str(), write ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+				if (m_File < 0) return false;
+
+				if (write) {
+
+					if (ftruncate(m_File, (off_t)size) != 0) { close(); return false; }
+				}
+				else {
+
+					struct stat info;
+					if (fstat(m_File, &info) != 0) { close(); return false; }
+					size = (uint64_t)info.st_size;
+				}
+
+				if (size == 0) { close(); return false; }
+
+				void* data = mmap(nullptr, (size_t)size, write ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, m_File, 0);
+				if (data == MAP_FAILED) { close(); return false; }
+
+				m_Data = (uint8_t*)data;
+#endif
+
+				m_Size = size;
+				m_Write = write;
+				return true;
+			}
+
+
+			// Unmap and close the file.
+			// A written file is cut to "usedSize", if given, so the unused preallocated part is not kept.
+			//
+			void close(uint64_t usedSize = 0) {
+
+#ifdef _WIN32
+				if (m_Data) UnmapViewOfFile(m_Data);
+				if (m_Mapping) CloseHandle(m_Mapping);
+
+				if (m_File != INVALID_HANDLE_VALUE) {
+
+					if (m_Write && usedSize > 0) {
+
+						LARGE_INTEGER end;
+						end.QuadPart = (LONGLONG)usedSize;
+						if (SetFilePointerEx(m_File, end, nullptr, FILE_BEGIN)) SetEndOfFile(m_File);
+					}
+
+					CloseHandle(m_File);
+				}
+
+				m_File = INVALID_HANDLE_VALUE;
+				m_Mapping = nullptr;
+#else
+				if (m_Data) munmap(m_Data, (size_t)m_Size);
+
+				if (m_File >= 0) {
+
+					if (m_Write && usedSize > 0) (void)ftruncate(m_File, (off_t)usedSize);
+					::close(m_File);
+				}
+
+				m_File = -1;
+#endif
+
+				m_Data = nullptr;
+				m_Size = 0;
+				m_Write = false;
+			}
+
+
+			uint8_t* data() const { return m_Data; }
+			uint64_t size() const { return m_Size; }
+			bool isOpen() const { return m_Data != nullptr; }
+
+
+		private:
+
+#ifdef _WIN32
+			HANDLE m_File = INVALID_HANDLE_VALUE;
+			HANDLE m_Mapping = nullptr;
+#else
+			int m_File = -1;
+#endif
+
+			uint8_t* m_Data = nullptr;
+			uint64_t m_Size = 0;
+			bool m_Write = false;
+		};
+
+
+
+		// Journal of the messages a server received, for playing them back later.
+		//
+		// Layout: a "JournalHeader", followed by records one after another,
+		// each a "JournalRecordHeader" followed by the body of the message, if any.
+		//
+		// Besides the messages the journal has a record for each tick and each disconnect,
+		// so playing it back calls "OnMessage", "Tick" and "OnClientDisconnect" in the same order as the server did.
+		//
+		static const uint32_t g_JournalMagic = 0x4E524A4E; // "NJRN"
+		static const uint32_t g_JournalVersion = 1;
+
+
+		enum class JournalRecord : uint32_t {
+
+			None,
+			Message,
+			Tick,
+			Disconnect
+		};
+
+
+		struct JournalHeader {
+
+			uint32_t m_Magic = g_JournalMagic;
+			uint32_t m_Version = g_JournalVersion;
+			uint32_t m_TickRate = 0;
+
+			// Version of the messages recorded, see "protocolVersion".
+			uint32_t m_ProtocolVersion = 0;
+
+			// Bytes of the file in use, header included.
+			// Updated after each record, so a journal of a crashed server can be read up to its last record.
+			uint64_t m_UsedSize = 0;
+		};
+
+
+		struct JournalRecordHeader {
+
+			// Microseconds since the journal was opened.
+			uint64_t m_Time = 0;
+
+			JournalRecord m_Type = JournalRecord::None;
+
+			// Connection the message came from or which disconnected,
+			// the tick number for a tick.
+			uint32_t m_ConnectionID = 0;
+
+			NetMsg m_MessageID = NetMsg::Server_GetStatus;
+			uint32_t m_MessageSize = 0;
+		};
+
+
+
+		// Appends records to a preallocated journal file.
+		//
+		// The whole file is mapped, appending a record only copies it into memory.
+		// The file does not grow, once it is full further records are dropped, see "isFull".
+		//
+		class JournalWriter {
+		public:
+
+			~JournalWriter() { close(); }
+
+
+			bool open(const std::string& path, uint64_t capacity, uint32_t tickRate, uint32_t protocolVersion) {
+
+				if (capacity < sizeof(JournalHeader)) return false;
+				if (!m_File.open(path, true, capacity)) return false;
+
+				m_Header.m_TickRate = tickRate;
+				m_Header.m_ProtocolVersion = protocolVersion;
+				m_Header.m_UsedSize = sizeof(JournalHeader);
+				std::memcpy(m_File.data(), &m_Header, sizeof(JournalHeader));
+
+				m_Start = std::chrono::steady_clock::now();
+				m_Full = false;
+				return true;
+			}
+
+
+			// Cut the file to what was written.
+			void close() {
+
+				if (m_File.isOpen()) m_File.close(m_Header.m_UsedSize);
+			}
+
+
+			void writeMessage(uint32_t connectionID, const olc::net::message<NetMsg>& msg) {
+
+				_write(JournalRecord::Message, connectionID, msg.header.id, msg.body.data(), (uint32_t)msg.body.size());
+			}
+
+
+			void writeTick(uint32_t tick) {
+
+				_write(JournalRecord::Tick, tick, NetMsg::Server_GetStatus, nullptr, 0);
+			}
+
+
+			void writeDisconnect(uint32_t connectionID) {
+
+				_write(JournalRecord::Disconnect, connectionID, NetMsg::Server_GetStatus, nullptr, 0);
+			}
+
+
+			bool isOpen() const { return m_File.isOpen(); }
+
+			// True once a record did not fit anymore.
+			bool isFull() const { return m_Full; }
+
+			uint64_t getUsedSize() const { return m_Header.m_UsedSize; }
+
+
+		private:
+
+			MappedFile m_File;
+			JournalHeader m_Header;
+			std::chrono::steady_clock::time_point m_Start;
+			bool m_Full = false;
+
+
+		private:
+
+			void _write(JournalRecord type, uint32_t connectionID, NetMsg id, const uint8_t* body, uint32_t size) {
+
+				if (!m_File.isOpen() || m_Full) return;
+
+				uint64_t recordSize = sizeof(JournalRecordHeader) + size;
+				if (m_Header.m_UsedSize + recordSize > m_File.size()) {
+
+					m_Full = true;
+					return;
+				}
+
+
+				JournalRecordHeader record;
+				record.m_Time = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_Start).count();
+				record.m_Type = type;
+				record.m_ConnectionID = connectionID;
+				record.m_MessageID = id;
+				record.m_MessageSize = size;
+
+				uint8_t* out = m_File.data() + m_Header.m_UsedSize;
+				std::memcpy(out, &record, sizeof(JournalRecordHeader));
+				if (size > 0) std::memcpy(out + sizeof(JournalRecordHeader), body, size);
+
+				m_Header.m_UsedSize += recordSize;
+				std::memcpy(m_File.data() + offsetof(JournalHeader, m_UsedSize), &m_Header.m_UsedSize, sizeof(uint64_t));
+			}
+		};
+
+
+
+		// Reads the records of a journal written by "JournalWriter", front to back.
+		//
+		class JournalReader {
+		public:
+
+			// Returns false if the file is no journal.
+			bool open(const std::string& path) {
+
+				if (!m_File.open(path, false)) return false;
+				if (m_File.size() < sizeof(JournalHeader)) { m_File.close(); return false; }
+
+				std::memcpy(&m_Header, m_File.data(), sizeof(JournalHeader));
+
+				if (m_Header.m_Magic != g_JournalMagic || m_Header.m_Version != g_JournalVersion) {
+
+					m_File.close();
+					return false;
+				}
+
+				// A journal not closed properly still has its preallocated size.
+				m_End = std::min<uint64_t>(m_Header.m_UsedSize, m_File.size());
+				m_Position = sizeof(JournalHeader);
+				return true;
+			}
+
+
+			// Next record, with the message filled in for a message record.
+			// Returns false at the end of the journal.
+			//
+			bool next(JournalRecordHeader& record, olc::net::message<NetMsg>& msg) {
+
+				if (m_Position + sizeof(JournalRecordHeader) > m_End) return false;
+
+				std::memcpy(&record, m_File.data() + m_Position, sizeof(JournalRecordHeader));
+				if (m_Position + sizeof(JournalRecordHeader) + record.m_MessageSize > m_End) return false;
+
+				const uint8_t* body = m_File.data() + m_Position + sizeof(JournalRecordHeader);
+
+				msg.header.id = record.m_MessageID;
+				msg.body.assign(body, body + record.m_MessageSize);
+				msg.header.size = record.m_MessageSize;
+
+				m_Position += sizeof(JournalRecordHeader) + record.m_MessageSize;
+				return true;
+			}
+
+
+			uint32_t getTickRate() const { return m_Header.m_TickRate; }
+
+			// Messages of another version can not be read by the handlers anymore.
+			uint32_t getProtocolVersion() const { return m_Header.m_ProtocolVersion; }
+
+
+		private:
+
+			MappedFile m_File;
+			JournalHeader m_Header;
+			uint64_t m_Position = 0;
+			uint64_t m_End = 0;
+		};
+
+	}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Microseconds of a monotonic clock, only used for differences.
+		//
+		inline uint64_t monotonicMicroseconds() {
+
+			using namespace std::chrono;
+			return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+		}
+
+
+
+		// Measures the round trip time to the server and the offset of the server clock.
+		//
+		// The client sends "Server_GetPing" with its clock, the server appends his clock and sends it back:
+		// [uint64_t client microseconds][uint64_t server microseconds], read front to back.
+		//
+		// Round trip time and jitter are smoothed as for the retransmission timer of TCP (RFC 6298),
+		// jitter being the smoothed deviation of the round trip time.
+		//
+		// The offset of the server clock assumes the reply took as long as the request.
+		// Samples with a long round trip were likely delayed on one way only, so the offset
+		// is taken from the sample with the shortest round trip of the last few.
+		//
+		class LatencyEstimator {
+		public:
+
+			// Add one echo, times in microseconds.
+			// "clientSent" and "clientReceived" of the client clock, "server" of the server clock.
+			//
+			void addSample(uint64_t clientSent, uint64_t server, uint64_t clientReceived) {
+
+				if (clientReceived < clientSent) return;
+
+				double rtt = (double)(clientReceived - clientSent) / 1000000.0;
+				double offset = (double)server / 1000000.0 - ((double)clientSent + (double)clientReceived) / 2000000.0;
+
+
+				if (m_SampleCount == 0) {
+
+					m_SmoothedRtt = rtt;
+					m_RttVariation = rtt / 2.0;
+				}
+				else {
+
+					const double alpha = 1.0 / 8.0;
+					const double beta = 1.0 / 4.0;
+
+					m_RttVariation = (1.0 - beta) * m_RttVariation + beta * std::abs(m_SmoothedRtt - rtt);
+					m_SmoothedRtt = (1.0 - alpha) * m_SmoothedRtt + alpha * rtt;
+				}
+
+				m_LastRtt = rtt;
+				m_SampleCount++;
+
+
+				m_Offsets[m_NextOffset] = { rtt, offset };
+				m_NextOffset = (m_NextOffset + 1) % m_Offsets.size();
+
+				double bestRtt = rtt;
+				m_ClockOffset = offset;
+
+				for (uint32_t i = 0; i < std::min<uint32_t>(m_SampleCount, (uint32_t)m_Offsets.size()); i++) {
+
+					if (m_Offsets[i].rtt < bestRtt) {
+
+						bestRtt = m_Offsets[i].rtt;
+						m_ClockOffset = m_Offsets[i].offset;
+					}
+				}
+			}
+
+
+			// Smoothed round trip time in seconds.
+			double getRtt() const { return m_SmoothedRtt; }
+
+			// Smoothed deviation of the round trip time in seconds.
+			double getJitter() const { return m_RttVariation; }
+
+			double getLastRtt() const { return m_LastRtt; }
+
+			// Add to the client clock to get the server clock, in seconds.
+			double getClockOffset() const { return m_ClockOffset; }
+
+			uint32_t getSampleCount() const { return m_SampleCount; }
+
+
+		private:
+
+			struct OffsetSample {
+
+				double rtt = 0.0;
+				double offset = 0.0;
+			};
+
+
+			double m_SmoothedRtt = 0.0;
+			double m_RttVariation = 0.0;
+			double m_LastRtt = 0.0;
+			double m_ClockOffset = 0.0;
+			uint32_t m_SampleCount = 0;
+
+			std::array<OffsetSample, 8> m_Offsets;
+			uint32_t m_NextOffset = 0;
+		};
+
+	}
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Dense array of items addressed by generation checked handles.
+		//
+		// Adding, removing and finding an item is constant time.
+		// The items themselves are kept packed in one vector, in no particular order,
+		// so going over all of them touches only live items.
+		//
+		// A handle is the index of its slot in the low 16 bits and the generation of the slot in the high 16 bits.
+		// Removing an item increases the generation of its slot, so an old handle
+		// never finds the item which reuses the slot later.
+		// A free slot points at no item, so neither does a handle guessing its next generation.
+		// Handle 0 is never given out.
+		//
+		template<typename T>
+		class SlotTable {
+		public:
+
+			using Handle = uint32_t;
+
+			static const Handle InvalidHandle = 0;
+
+
+			Handle add(T&& item) {
+
+				uint32_t index;
+
+				if (!m_FreeSlots.empty()) {
+
+					index = m_FreeSlots.back();
+					m_FreeSlots.pop_back();
+				}
+				else {
+
+					if (m_Slots.size() > 0xFFFF) return InvalidHandle;
+
+					index = (uint32_t)m_Slots.size();
+					m_Slots.push_back({ FreeSlot, 1 });
+				}
+
+
+				Slot& slot = m_Slots[index];
+				slot.m_Dense = (uint32_t)m_Items.size();
+
+				Handle handle = _makeHandle(index, slot.m_Generation);
+
+				m_Items.push_back(std::move(item));
+				m_Handles.push_back(handle);
+
+				return handle;
+			}
+
+
+			// Returns false if the handle is not valid (anymore).
+			bool remove(Handle handle) {
+
+				if (!contains(handle)) return false;
+
+				Slot& slot = m_Slots[_index(handle)];
+				uint32_t dense = slot.m_Dense;
+				uint32_t last = (uint32_t)m_Items.size() - 1;
+
+
+				// Move the last item into the gap, so the items stay packed.
+				if (dense != last) {
+
+					m_Items[dense] = std::move(m_Items[last]);
+					m_Handles[dense] = m_Handles[last];
+					m_Slots[_index(m_Handles[dense])].m_Dense = dense;
+				}
+
+				m_Items.pop_back();
+				m_Handles.pop_back();
+
+
+				slot.m_Dense = FreeSlot;
+				slot.m_Generation++;
+				if (slot.m_Generation == 0) slot.m_Generation = 1;
+
+				m_FreeSlots.push_back(_index(handle));
+
+				return true;
+			}
+
+
+			bool contains(Handle handle) const {
+
+				uint32_t index = _index(handle);
+				return index < m_Slots.size() && m_Slots[index].m_Dense != FreeSlot && m_Slots[index].m_Generation == _generation(handle);
+			}
+
+
+			// Returns nullptr if the handle is not valid (anymore).
+			T* find(Handle handle) {
+
+				return contains(handle) ? &m_Items[m_Slots[_index(handle)].m_Dense] : nullptr;
+			}
+
+			const T* find(Handle handle) const {
+
+				return contains(handle) ? &m_Items[m_Slots[_index(handle)].m_Dense] : nullptr;
+			}
+
+
+			// Items by position in the dense array, for going over all of them.
+			// Positions change when items are removed.
+			//
+			size_t size() const { return m_Items.size(); }
+			bool empty() const { return m_Items.empty(); }
+
+			T& at(size_t i) { return m_Items[i]; }
+			const T& at(size_t i) const { return m_Items[i]; }
+
+			Handle handleAt(size_t i) const { return m_Handles[i]; }
+
+
+		private:
+
+			// Dense index of a slot without item.
+			static const uint32_t FreeSlot = UINT32_MAX;
+
+			struct Slot {
+
+				uint32_t m_Dense;
+				uint16_t m_Generation;
+			};
+
+
+			std::vector<T> m_Items;
+			std::vector<Handle> m_Handles;
+			std::vector<Slot> m_Slots;
+			std::vector<uint32_t> m_FreeSlots;
+
+
+		private:
+
+			static Handle _makeHandle(uint32_t index, uint16_t generation) {
+
+				return ((Handle)generation << 16) | index;
+			}
+
+			static uint32_t _index(Handle handle) { return handle & 0xFFFF; }
+			static uint16_t _generation(Handle handle) { return (uint16_t)(handle >> 16); }
+		};
+
+	}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// Messages exchanged between client and server.
+//
+// Kept apart from the rest of the engine, so tools talking to the server,
+// like the bots, do not need a window, the GPU or Steam.
+//
+#include<cstdint>
+#include<map>
+#include<unordered_map>
+#include<vector>
+#include<cmath>
+
+#include"common/include/olcPGEX_Network.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+
+		enum class NetMsg : uint32_t {
+
+			Server_GetStatus,
+			Server_GetPing,
+
+
+			Client_Accepted,
+			Client_AssignID,
+			Client_RegisterWithServer,
+			Client_UnregisterWithServer,
+			Client_AckSnapshot,
+			Client_Input,
+
+
+			Game_AddPlayer,
+			Game_AddPlayers,
+			Game_RemovePlayer,
+			Game_UpdatePlayer,
+			Game_WorldSnapshot,
+
+
+			// Not a message, the count of the ones above.
+			// New messages go before it and need a payload in "NetworkRegistry.h".
+			Count
+		};
+
+
+
+		struct PlayerDescription {
+
+			// Unique network id assigned by the server for
+			// the client/player instance.
+			//
+			uint32_t m_PlayerNetworkID = 0;
+
+
+			// Some special variables for the spacewar game.
+			//
+			// These are different for each game and MUST be adjusted for each accordingly.
+			//
+			uint32_t m_PlayerHealth = 0;
+			float m_PlayerPositionX = 0.0f;
+			float m_PlayerPositionY = 0.0f;
+			uint32_t m_PlayerArmor = 0;
+			float m_PlayerVelocityX = 0.0f;
+			float m_PlayerVelocityY = 0.0f;
+			float m_PlayerRotation = 0.0f;
+
+
+
+			// Name of the players ship to be displayed.
+			//
+			// It should be possible to load dynamically a ship into the scene based on the name.
+			//
+			enum class PlayerRepresentation {
+				Invalid = -1,
+				Fighter = 0,
+				Juggernaut,
+				Raider,
+				Interceptor
+			};
+
+			PlayerRepresentation m_PlayerShip = PlayerRepresentation::Invalid;
+
+		};
+
+
+
+		// Key for sending a message with "SendState" or "SendDatagramState".
+		//
+		// A newer message of the same type about the same entity replaces the older one,
+		// while it still waits to be sent to a slow client. Use entity 0 for state about the whole world.
+		//
+		inline uint64_t stateKey(NetMsg id, uint32_t entity = 0) {
+
+			return ((uint64_t)id + 1) << 32 | entity;
+		}
+
+	}
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include"NetworkMessages.h"
+#include"NetworkEncoding.h"
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Input of a player for one client frame.
+		//
+		// Clients do not send theyre state anymore, but what the player pressed.
+		// The server applies the inputs to the player with "simulatePlayer" and is the authority,
+		// the client applies the same inputs right away to predict his own ship.
+		//
+		// The values are stored quantized, so client and server simulate with exactly the same numbers.
+		// Build inputs with "makePlayerInput".
+		//
+		struct PlayerInput {
+
+			// Increasing with each frame of the client, the server echoes the last one it applied.
+			uint32_t m_Sequence = 0;
+
+			// Change of velocity, in [-g_InputMoveMax, g_InputMoveMax].
+			int8_t m_MoveX = 0;
+			int8_t m_MoveY = 0;
+
+			// Change of rotation in radians, in [-g_InputTurnMax, g_InputTurnMax].
+			int8_t m_Turn = 0;
+
+			// See "PlayerInputButton".
+			uint8_t m_Buttons = 0;
+
+			// Duration of the frame in milliseconds.
+			uint8_t m_DeltaTimeMs = 0;
+		};
+
+
+		enum PlayerInputButton : uint8_t {
+
+			Input_None = 0,
+			Input_TurnAround = 1 << 0
+		};
+
+
+		// Ranges of the input values.
+		// Moving is stick plus keys, turning is stick plus keys too.
+		//
+		static const float g_InputMoveMax = 2.0f;
+		static const float g_InputTurnMax = 1.0f;
+		static const float g_InputDeltaTimeMax = 0.25f;
+
+		// Shortest input, a frame shorter than that is sent as that long.
+		// The server drops inputs without duration, so sending many does not gain anything.
+		static const uint8_t g_InputDeltaTimeMinMs = 1;
+
+
+		// Acceleration for a move of 1 in units per second squared, and rotation for a turn of 1 in radians per second.
+		static const float g_ShipAcceleration = 60.0f;
+		static const float g_ShipTurnRate = 6.0f;
+
+
+		// Rate at which velocity is lost per second, so a ship comes to rest without input.
+		// Full acceleration ends at a speed of "g_InputMoveMax * g_ShipAcceleration / g_VelocityDamping".
+		static const float g_VelocityDamping = 1.0f;
+
+		// Below this speed a ship without input stops.
+		static const float g_VelocityRest = 0.01f;
+
+
+		// Inputs sent with each "Client_Input" message.
+		// The newest inputs are repeated, so a lost datagram does not lose an input.
+		//
+		static const uint32_t g_InputRedundancy = 4;
+
+		// Inputs the client remembers for replaying, the ones older than that are dropped.
+		static const uint32_t g_InputHistorySize = 128;
+
+
+
+		inline int8_t _quantizeInput(float value, float max) {
+
+			if (!(value == value)) return 0; // NaN.
+
+			float scaled = value / max * 127.0f;
+			if (scaled > 127.0f) scaled = 127.0f;
+			if (scaled < -127.0f) scaled = -127.0f;
+
+			return (int8_t)std::lround(scaled);
+		}
+
+
+		inline float _dequantizeInput(int8_t value, float max) {
+
+			return (float)value / 127.0f * max;
+		}
+
+
+		inline PlayerInput makePlayerInput(uint32_t sequence, float moveX, float moveY, float turn, bool turnAround, float dt) {
+
+			PlayerInput input;
+			input.m_Sequence = sequence;
+			input.m_MoveX = _quantizeInput(moveX, g_InputMoveMax);
+			input.m_MoveY = _quantizeInput(moveY, g_InputMoveMax);
+			input.m_Turn = _quantizeInput(turn, g_InputTurnMax);
+			input.m_Buttons = turnAround ? Input_TurnAround : Input_None;
+
+			if (!(dt > 0.0f)) dt = 0.0f;
+			if (dt > g_InputDeltaTimeMax) dt = g_InputDeltaTimeMax;
+			input.m_DeltaTimeMs = (uint8_t)std::max<long>(std::lround(dt * 1000.0f), g_InputDeltaTimeMinMs);
+
+			return input;
+		}
+
+
+
+		// Velocity and position of one axis after "dt" seconds of "acceleration", with damping.
+		//
+		// Solved exactly instead of stepped, so the result does not depend on how the time is split into inputs:
+		// One input of 16 ms ends where 16 inputs of 1 ms end, and a client with a high frame rate is not faster.
+		//
+		inline void _simulateAxis(float& position, float& velocity, float acceleration, float dt) {
+
+			const float terminal = acceleration / g_VelocityDamping;
+			const float decay = std::exp(-g_VelocityDamping * dt);
+
+			position += terminal * dt + (velocity - terminal) * (1.0f - decay) / g_VelocityDamping;
+			velocity = terminal + (velocity - terminal) * decay;
+
+			if (acceleration == 0.0f && std::fabs(velocity) < g_VelocityRest) velocity = 0.0f;
+		}
+
+
+		// Move the player according to one input.
+		//
+		// Client and server must get the same result from the same input,
+		// so this is the only place where a ship is moved.
+		//
+		// Everything is scaled by the duration of the input, an input without duration changes nothing but turning around.
+		// Velocity is limited to the range the snapshots can carry, the position to the world.
+		//
+		inline void simulatePlayer(PlayerDescription& desc, const PlayerInput& input) {
+
+			const float dt = (float)input.m_DeltaTimeMs / 1000.0f;
+
+
+			_simulateAxis(desc.m_PlayerPositionX, desc.m_PlayerVelocityX, _dequantizeInput(input.m_MoveX, g_InputMoveMax) * g_ShipAcceleration, dt);
+			_simulateAxis(desc.m_PlayerPositionY, desc.m_PlayerVelocityY, _dequantizeInput(input.m_MoveY, g_InputMoveMax) * g_ShipAcceleration, dt);
+
+			desc.m_PlayerRotation += _dequantizeInput(input.m_Turn, g_InputTurnMax) * g_ShipTurnRate * dt;
+
+			if (input.m_Buttons & Input_TurnAround) desc.m_PlayerRotation += (1.5708f * 2);
+
+
+			desc.m_PlayerVelocityX = std::max(-g_VelocityMax, std::min(g_VelocityMax, desc.m_PlayerVelocityX));
+			desc.m_PlayerVelocityY = std::max(-g_VelocityMax, std::min(g_VelocityMax, desc.m_PlayerVelocityY));
+
+			desc.m_PlayerPositionX = std::max(g_WorldMin, std::min(g_WorldMax, desc.m_PlayerPositionX));
+			desc.m_PlayerPositionY = std::max(g_WorldMin, std::min(g_WorldMax, desc.m_PlayerPositionY));
+		}
+
+
+
+		// Write the given inputs into a "Client_Input" message, oldest first.
+		//
+		// Layout, as bit stream:
+		// count (8 bits), and for each input: sequence (32), move x, move y, turn, buttons, delta time (8 each).
+		// 72 bits per input.
+		//
+		template<typename Iterator>
+		inline void writePlayerInputs(olc::net::message<NetMsg>& msg, Iterator first, Iterator last) {
+
+			olc::net::bit_writer<NetMsg> out(msg);
+
+			uint32_t count = (uint32_t)std::distance(first, last);
+			if (count > 255) {
+
+				std::advance(first, count - 255);
+				count = 255;
+			}
+
+			out.write(count, 8);
+
+			for (; first != last; ++first) {
+
+				const PlayerInput& input = *first;
+
+				out.write(input.m_Sequence, 32);
+				out.write((uint8_t)input.m_MoveX, 8);
+				out.write((uint8_t)input.m_MoveY, 8);
+				out.write((uint8_t)input.m_Turn, 8);
+				out.write(input.m_Buttons, 8);
+				out.write(input.m_DeltaTimeMs, 8);
+			}
+		}
+
+
+		// Read the inputs written by "writePlayerInputs" into "out".
+		// Returns false if the message is malformed.
+		//
+		inline bool readPlayerInputs(const olc::net::message<NetMsg>& msg, std::vector<PlayerInput>& out) {
+
+			olc::net::bit_reader<NetMsg> in(msg);
+
+			out.clear();
+
+			uint32_t count = in.read(8);
+
+			for (uint32_t i = 0; i < count && in.good(); i++) {
+
+				PlayerInput input;
+				input.m_Sequence = in.read(32);
+				input.m_MoveX = (int8_t)(uint8_t)in.read(8);
+				input.m_MoveY = (int8_t)(uint8_t)in.read(8);
+				input.m_Turn = (int8_t)(uint8_t)in.read(8);
+				input.m_Buttons = (uint8_t)in.read(8);
+				input.m_DeltaTimeMs = (uint8_t)in.read(8);
+
+				if (in.good()) out.push_back(input);
+			}
+
+			return in.good();
+		}
+
+	}
+
+}
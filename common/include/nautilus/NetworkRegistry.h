@@ -0,0 +1,518 @@
+#pragma once
+
+#include"NetworkMessages.h"
+#include"NetworkEncoding.h"
+#include"NetworkSnapshot.h"
+#include"NetworkPrediction.h"
+
+#include<tuple>
+#include<array>
+#include<utility>
+#include<type_traits>
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Every message type has a payload struct, which says what the message carries and how it is written.
+		//
+		// A payload declares:
+		// "ID"			The message type it belongs to.
+		// "Codec"		How it is written, see "MessageCodec".
+		// "Version"	Increased whenever the layout changes, see "g_ProtocolVersion".
+		//
+		// A raw payload lists its fields with "fields", writing and reading them is generated.
+		// Any other payload has "write" and "read" and the bounds of its size, "MinSize" and "MaxSize".
+		//
+		// The payloads are listed in "MessageRegistry", in the order of "NetMsg".
+		// So adding a message type is adding its payload there and a handler to whoever receives it, see "MessageDispatcher".
+		//
+		enum class MessageCodec : uint8_t {
+
+			// The fields one after another, as they are in memory. The size is fixed.
+			Raw,
+
+			// Packed into bits, in the encoding "wireEncodings" chooses for the message type.
+			Quantized,
+
+			// Against an earlier message the receiver acknowledged.
+			// Written by the sender with its baseline for the receiver, e.g. "writeSnapshot",
+			// read with what the receiver remembers, see "MessageContext".
+			Delta
+		};
+
+
+		// What the receiver keeps for reading delta encoded messages.
+		struct MessageContext {
+
+			const PlayerSnapshotHistory* m_SnapshotHistory = nullptr;
+		};
+
+
+
+		inline constexpr uint32_t _bytes(uint64_t bits) { return (uint32_t)((bits + 7) / 8); }
+
+		inline constexpr uint32_t _min(uint32_t a, uint32_t b) { return a < b ? a : b; }
+		inline constexpr uint32_t _max(uint32_t a, uint32_t b) { return a > b ? a : b; }
+
+
+
+		struct StatusPayload {
+
+			static constexpr NetMsg ID = NetMsg::Server_GetStatus;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 1;
+
+			template<typename Self> static auto fields(Self&) { return std::tie(); }
+		};
+
+
+		// The client sends its clock, the server echoes it with his own.
+		// See "LatencyEstimator".
+		//
+		struct PingPayload {
+
+			static constexpr NetMsg ID = NetMsg::Server_GetPing;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 2;
+
+			uint64_t m_ClientTime = 0;
+			uint64_t m_ServerTime = 0;
+
+			template<typename Self> static auto fields(Self& p) { return std::tie(p.m_ClientTime, p.m_ServerTime); }
+		};
+
+
+		// The server accepted the connection.
+		// The client needs the tick rate to know the server time of a snapshot,
+		// and must speak the same protocol, see "protocolVersion".
+		//
+		struct AcceptedPayload {
+
+			static constexpr NetMsg ID = NetMsg::Client_Accepted;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 2;
+
+			uint32_t m_TickRate = 0;
+			uint32_t m_ProtocolVersion = 0;
+
+			template<typename Self> static auto fields(Self& p) { return std::tie(p.m_TickRate, p.m_ProtocolVersion); }
+		};
+
+
+		struct AssignIDPayload {
+
+			static constexpr NetMsg ID = NetMsg::Client_AssignID;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 1;
+
+			uint32_t m_PlayerID = 0;
+
+			template<typename Self> static auto fields(Self& p) { return std::tie(p.m_PlayerID); }
+		};
+
+
+		struct UnregisterPayload {
+
+			static constexpr NetMsg ID = NetMsg::Client_UnregisterWithServer;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 1;
+
+			template<typename Self> static auto fields(Self&) { return std::tie(); }
+		};
+
+
+		// Newest snapshot received, 0 for none, which requests a full state.
+		struct AckSnapshotPayload {
+
+			static constexpr NetMsg ID = NetMsg::Client_AckSnapshot;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 1;
+
+			uint32_t m_Tick = 0;
+
+			template<typename Self> static auto fields(Self& p) { return std::tie(p.m_Tick); }
+		};
+
+
+		// The newest inputs of the client, oldest first, see "writePlayerInputs".
+		struct InputPayload {
+
+			static constexpr NetMsg ID = NetMsg::Client_Input;
+			static constexpr MessageCodec Codec = MessageCodec::Quantized;
+			static constexpr uint32_t Version = 1;
+
+			static constexpr uint32_t MinSize = 1;
+			static constexpr uint32_t MaxSize = _bytes(8 + 255 * 72);
+
+			std::vector<PlayerInput> m_Inputs;
+
+			void write(olc::net::message<NetMsg>& msg) const { writePlayerInputs(msg, m_Inputs.begin(), m_Inputs.end()); }
+			bool read(const olc::net::message<NetMsg>& msg, const MessageContext&) { return readPlayerInputs(msg, m_Inputs); }
+		};
+
+
+		// One player description, raw or quantized as chosen for the message type.
+		template<NetMsg Id>
+		struct PlayerPayload {
+
+			static constexpr NetMsg ID = Id;
+			static constexpr MessageCodec Codec = MessageCodec::Quantized;
+			static constexpr uint32_t Version = 1;
+
+			static constexpr uint32_t MinSize = _min(_bytes(g_PlayerQuantizedBits), sizeof(PlayerDescription));
+			static constexpr uint32_t MaxSize = _max(_bytes(g_PlayerQuantizedBits), sizeof(PlayerDescription));
+
+			PlayerDescription m_Player;
+
+			void write(olc::net::message<NetMsg>& msg) const { writePlayerDescription(msg, m_Player); }
+			bool read(const olc::net::message<NetMsg>& msg, const MessageContext&) { return readPlayerDescription(msg, m_Player); }
+		};
+
+		using RegisterPayload = PlayerPayload<NetMsg::Client_RegisterWithServer>;
+		using AddPlayerPayload = PlayerPayload<NetMsg::Game_AddPlayer>;
+		using UpdatePlayerPayload = PlayerPayload<NetMsg::Game_UpdatePlayer>;
+
+
+		// All players entering the area of interest of a client in one tick, see "writePlayerDescriptions".
+		struct AddPlayersPayload {
+
+			static constexpr NetMsg ID = NetMsg::Game_AddPlayers;
+			static constexpr MessageCodec Codec = MessageCodec::Quantized;
+			static constexpr uint32_t Version = 1;
+
+			static constexpr uint32_t MinSize = _min(_bytes(16), sizeof(uint32_t));
+			static constexpr uint32_t MaxSize = _max(_bytes(16 + (uint64_t)g_PlayersPerMessageMax * g_PlayerQuantizedBits),
+				sizeof(uint32_t) + g_PlayersPerMessageMax * (uint32_t)sizeof(PlayerDescription));
+
+			std::vector<PlayerDescription> m_Players;
+
+			void write(olc::net::message<NetMsg>& msg) const { writePlayerDescriptions(msg, m_Players.begin(), m_Players.end()); }
+			bool read(const olc::net::message<NetMsg>& msg, const MessageContext&) { return readPlayerDescriptions(msg, m_Players); }
+		};
+
+
+		struct RemovePlayerPayload {
+
+			static constexpr NetMsg ID = NetMsg::Game_RemovePlayer;
+			static constexpr MessageCodec Codec = MessageCodec::Raw;
+			static constexpr uint32_t Version = 1;
+
+			uint32_t m_PlayerID = 0;
+
+			template<typename Self> static auto fields(Self& p) { return std::tie(p.m_PlayerID); }
+		};
+
+
+		// State of the players around the client, delta compressed, see "writeSnapshot".
+		//
+		// A snapshot against a baseline the client does not remember anymore is no error,
+		// "m_Decoded" is false then and the client requests a full state.
+		//
+		struct WorldSnapshotPayload {
+
+			static constexpr NetMsg ID = NetMsg::Game_WorldSnapshot;
+			static constexpr MessageCodec Codec = MessageCodec::Delta;
+			static constexpr uint32_t Version = 1;
+
+			// Tick, baseline, input sequence and count, raw or quantized.
+			// The count of players is limited by the 16 bit count of the quantized encoding.
+			static constexpr uint32_t MinSize = _min(_bytes(3 * 32 + 16), 4 * sizeof(uint32_t));
+			static constexpr uint32_t MaxSize = _max(_bytes(3 * 32 + 16 + 0xFFFFull * (32 + 8 + g_PlayerQuantizedBits - 32)),
+				4 * sizeof(uint32_t) + 0xFFFF * (uint32_t)(sizeof(uint32_t) + sizeof(uint8_t) + sizeof(PlayerDescription)));
+
+			uint32_t m_Tick = 0;
+			uint32_t m_InputSequence = 0;
+			PlayerSnapshot m_Players;
+			bool m_Decoded = false;
+
+			bool read(const olc::net::message<NetMsg>& msg, const MessageContext& context) {
+
+				if (!context.m_SnapshotHistory) return false;
+
+				m_Decoded = readSnapshot(msg, *context.m_SnapshotHistory, m_Tick, m_Players, m_InputSequence);
+				if (!m_Decoded) m_Players.clear();
+
+				return true;
+			}
+		};
+
+
+
+		// All payloads, in the order of "NetMsg".
+		using MessageRegistry = std::tuple<
+
+			StatusPayload,
+			PingPayload,
+
+			AcceptedPayload,
+			AssignIDPayload,
+			RegisterPayload,
+			UnregisterPayload,
+			AckSnapshotPayload,
+			InputPayload,
+
+			AddPlayerPayload,
+			AddPlayersPayload,
+			RemovePlayerPayload,
+			UpdatePlayerPayload,
+			WorldSnapshotPayload
+		>;
+
+
+		static const uint32_t g_NetMsgCount = (uint32_t)NetMsg::Count;
+
+
+		template<size_t... I>
+		inline constexpr bool _registryInOrder(std::index_sequence<I...>) {
+
+			return ((std::tuple_element_t<I, MessageRegistry>::ID == (NetMsg)I) && ...);
+		}
+
+		static_assert(std::tuple_size<MessageRegistry>::value == g_NetMsgCount, "Each message type needs a payload in \"MessageRegistry\".");
+		static_assert(_registryInOrder(std::make_index_sequence<g_NetMsgCount>()), "\"MessageRegistry\" must be in the order of \"NetMsg\".");
+
+
+
+		// Size of the fields of a raw payload.
+		template<typename Tuple>
+		struct _FieldsSize;
+
+		template<typename... Field>
+		struct _FieldsSize<std::tuple<Field...>> {
+
+			static constexpr uint32_t value = (0u + ... + (uint32_t)sizeof(std::remove_reference_t<Field>));
+		};
+
+
+		template<typename Payload>
+		inline constexpr uint32_t payloadMinSize() {
+
+			if constexpr (Payload::Codec == MessageCodec::Raw) return _FieldsSize<decltype(Payload::fields(std::declval<Payload&>()))>::value;
+			else return Payload::MinSize;
+		}
+
+
+		template<typename Payload>
+		inline constexpr uint32_t payloadMaxSize() {
+
+			if constexpr (Payload::Codec == MessageCodec::Raw) return payloadMinSize<Payload>();
+			else return Payload::MaxSize;
+		}
+
+
+
+		// Version of the protocol, a hash of the id, codec, version and size bounds of every payload.
+		//
+		// Changing the layout of a raw payload changes it on its own, for any other payload increase its "Version".
+		// The wire encodings are chosen at run time, so what both sides compare is "protocolVersion".
+		//
+		template<size_t... I>
+		inline constexpr uint32_t _protocolVersion(std::index_sequence<I...>) {
+
+			uint32_t hash = 2166136261u;
+
+			auto add = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+
+			((add((uint32_t)std::tuple_element_t<I, MessageRegistry>::ID),
+				add((uint32_t)std::tuple_element_t<I, MessageRegistry>::Codec),
+				add(std::tuple_element_t<I, MessageRegistry>::Version),
+				add(payloadMinSize<std::tuple_element_t<I, MessageRegistry>>()),
+				add(payloadMaxSize<std::tuple_element_t<I, MessageRegistry>>())), ...);
+
+			return hash;
+		}
+
+		static constexpr uint32_t g_ProtocolVersion = _protocolVersion(std::make_index_sequence<g_NetMsgCount>());
+
+
+		// Version of the protocol as spoken now, "g_ProtocolVersion" and the wire encoding of every message type,
+		// see "setWireEncoding". So a side switched to the raw encoding does not talk to one using the quantized one,
+		// nor replays a journal recorded with it.
+		//
+		// The server sends it with "Client_Accepted", a client of another version disconnects.
+		// The journal header carries it too.
+		//
+		inline uint32_t protocolVersion() {
+
+			uint32_t hash = g_ProtocolVersion;
+
+			for (uint32_t id = 0; id < g_NetMsgCount; id++) {
+
+				hash = (hash ^ (uint32_t)getWireEncoding((NetMsg)id)) * 16777619u;
+			}
+
+			return hash;
+		}
+
+
+
+		// Largest body of each message type, by id, for "connection_options::vecMaxMessageSizes".
+		// So a peer can not make us allocate more for a message than its payload may be.
+		//
+		template<size_t... I>
+		inline std::vector<uint32_t> _messageSizeLimits(std::index_sequence<I...>) {
+
+			return { payloadMaxSize<std::tuple_element_t<I, MessageRegistry>>()... };
+		}
+
+		inline std::vector<uint32_t> messageSizeLimits() {
+
+			return _messageSizeLimits(std::make_index_sequence<g_NetMsgCount>());
+		}
+
+
+
+		// Write a payload into the message, which gets the id of the payload.
+		// Delta payloads are written by the sender itself, it knows the baseline of each receiver.
+		//
+		template<typename Payload>
+		inline void writePayload(olc::net::message<NetMsg>& msg, const Payload& payload) {
+
+			static_assert(Payload::Codec != MessageCodec::Delta, "Delta payloads are written with theyre baseline, e.g. \"writeSnapshot\".");
+
+			msg.header.id = Payload::ID;
+
+			if constexpr (Payload::Codec == MessageCodec::Raw) {
+
+				std::apply([&msg](const auto&... field) { ((msg << field), ...); }, Payload::fields(payload));
+			}
+			else {
+
+				payload.write(msg);
+			}
+		}
+
+
+		// Message taken from the pool with the payload written into it.
+		template<typename Payload>
+		inline olc::net::message<NetMsg> makeMessage(olc::net::message_pool<NetMsg>& pool, const Payload& payload) {
+
+			olc::net::message<NetMsg> msg = pool.acquire(Payload::ID);
+			writePayload(msg, payload);
+			return msg;
+		}
+
+
+		// Read the payload of a message.
+		// Returns false if the message is of another type, outside the size bounds of the payload or malformed.
+		//
+		template<typename Payload>
+		inline bool readPayload(const olc::net::message<NetMsg>& msg, Payload& payload, const MessageContext& context) {
+
+			if (msg.header.id != Payload::ID) return false;
+			if (msg.body.size() < payloadMinSize<Payload>() || msg.body.size() > payloadMaxSize<Payload>()) return false;
+
+			if constexpr (Payload::Codec == MessageCodec::Raw) {
+
+				olc::net::message_reader<NetMsg> reader(msg);
+				std::apply([&reader](auto&... field) { ((reader >> field), ...); }, Payload::fields(payload));
+				return reader.good();
+			}
+			else {
+
+				return payload.read(msg, context);
+			}
+		}
+
+
+
+		enum class DispatchResult : uint8_t {
+
+			Handled,
+
+			// The handler has no "handle" for the message type.
+			Unhandled,
+
+			// Outside the size bounds or failed to read.
+			Malformed,
+
+			// Not a message type we know.
+			Unknown
+		};
+
+
+		// Calls the handler of a message with its payload.
+		//
+		// The handler has a "handle" for each message type it receives, e.g. for the server
+		//
+		//		void handle(const InputPayload& input, const std::shared_ptr<olc::net::connection<NetMsg>>& client);
+		//
+		// where "Args" are what is passed to "dispatch" besides the message, here the client.
+		// Message types without a "handle" are ignored.
+		//
+		// The message id indexes a table of one function per message type, built at compile time,
+		// so dispatching is one indirect call instead of comparing the id with each type.
+		// The size is checked before the payload is read.
+		//
+		// Each payload is read into the same instance every time, so reading the vectors they have does not allocate.
+		// A handler must not keep a reference to its payload.
+		//
+		template<typename Handler, typename... Args>
+		class MessageDispatcher {
+		public:
+
+			DispatchResult dispatch(Handler& handler, const olc::net::message<NetMsg>& msg, Args... args) {
+
+				static constexpr std::array<Entry, g_NetMsgCount> table = _makeTable(std::make_index_sequence<g_NetMsgCount>());
+
+				uint32_t id = (uint32_t)msg.header.id;
+				if (id >= g_NetMsgCount) return DispatchResult::Unknown;
+
+				return (this->*table[id])(handler, msg, args...);
+			}
+
+
+			// What is needed to read delta encoded messages, set it up before the first dispatch.
+			MessageContext& context() { return m_Context; }
+
+
+		private:
+
+			using Entry = DispatchResult(MessageDispatcher::*)(Handler&, const olc::net::message<NetMsg>&, Args...);
+
+
+			MessageRegistry m_Payloads;
+			MessageContext m_Context;
+
+
+		private:
+
+			template<typename Payload, typename = void>
+			struct _Handles : std::false_type {};
+
+			template<typename Payload>
+			struct _Handles<Payload, std::void_t<decltype(std::declval<Handler&>().handle(std::declval<const Payload&>(), std::declval<Args>()...))>> : std::true_type {};
+
+
+			template<size_t I>
+			DispatchResult _dispatch(Handler& handler, const olc::net::message<NetMsg>& msg, Args... args) {
+
+				using Payload = std::tuple_element_t<I, MessageRegistry>;
+
+				if constexpr (_Handles<Payload>::value) {
+
+					Payload& payload = std::get<I>(m_Payloads);
+					if (!readPayload(msg, payload, m_Context)) return DispatchResult::Malformed;
+
+					handler.handle(payload, args...);
+					return DispatchResult::Handled;
+				}
+				else {
+
+					return DispatchResult::Unhandled;
+				}
+			}
+
+
+			template<size_t... I>
+			static constexpr std::array<Entry, sizeof...(I)> _makeTable(std::index_sequence<I...>) {
+
+				return { &MessageDispatcher::_dispatch<I>... };
+			}
+		};
+
+	}
+
+}
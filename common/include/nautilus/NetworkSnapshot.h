@@ -0,0 +1,355 @@
+#pragma once
+
+#include"NetworkMessages.h"
+#include"NetworkEncoding.h"
+
+#include<algorithm>
+#include<array>
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// State of all players for one server tick, ordered by network id.
+		//
+		// A flat vector, so one reused tick after tick keeps its memory,
+		// and a snapshot is compared with its baseline walking both once.
+		//
+		using PlayerSnapshot = std::vector<PlayerDescription>;
+
+
+		// Order the players of a snapshot by id, as "writeSnapshot" expects.
+		//
+		inline void sortSnapshot(PlayerSnapshot& snapshot) {
+
+			std::sort(snapshot.begin(), snapshot.end(), [](const PlayerDescription& a, const PlayerDescription& b) { return a.m_PlayerNetworkID < b.m_PlayerNetworkID; });
+		}
+
+
+		// Count of snapshots the server and client remember for delta compression.
+		// A client acknowledging a snapshot older than this gets a full state.
+		//
+		static const uint32_t g_SnapshotHistorySize = 32;
+
+
+		// Snapshots received or sent, in a fixed ring of slots by tick number.
+		//
+		// Storing a snapshot copies it into the slot of its tick, which keeps the memory of the snapshot it replaces.
+		// So once the slots have grown to the count of players around, storing does not allocate.
+		// A tick is found until a tick "g_SnapshotHistorySize" later is stored over it.
+		//
+		class PlayerSnapshotHistory {
+		public:
+
+			// Returns nullptr if the tick is not remembered (anymore), and for tick 0, which is no snapshot.
+			const PlayerSnapshot* find(uint32_t tick) const {
+
+				const Slot& slot = m_Slots[tick % g_SnapshotHistorySize];
+				return (tick != 0 && slot.m_Tick == tick) ? &slot.m_Players : nullptr;
+			}
+
+
+			void store(uint32_t tick, const PlayerSnapshot& snapshot) {
+
+				Slot& slot = m_Slots[tick % g_SnapshotHistorySize];
+				slot.m_Tick = tick;
+				slot.m_Players.assign(snapshot.begin(), snapshot.end());
+			}
+
+
+		private:
+
+			struct Slot {
+
+				uint32_t m_Tick = 0;
+				PlayerSnapshot m_Players;
+			};
+
+			std::array<Slot, g_SnapshotHistorySize> m_Slots;
+		};
+
+
+		// Bitmask of the fields of a "PlayerDescription" which
+		// changed between a baseline and the current state.
+		//
+		// The network id is always sent, as it identifies the player.
+		//
+		enum PlayerDescriptionField : uint8_t {
+
+			Field_None = 0,
+			Field_Health = 1 << 0,
+			Field_PositionX = 1 << 1,
+			Field_PositionY = 1 << 2,
+			Field_Armor = 1 << 3,
+			Field_VelocityX = 1 << 4,
+			Field_VelocityY = 1 << 5,
+			Field_Rotation = 1 << 6,
+			Field_Ship = 1 << 7,
+			Field_All = 0xFF
+		};
+
+
+
+		// Compare two player descriptions field by field.
+		// Floats are compared exactly, as the values are only copied and never recomputed.
+		// With the quantized encoding the values were quantized by the sender already, and quantizing
+		// them again gives the same result, so an unchanged field stays unchanged.
+		//
+		inline uint8_t computeDeltaMask(const PlayerDescription& baseline, const PlayerDescription& current) {
+
+			uint8_t mask = Field_None;
+
+			if (baseline.m_PlayerHealth != current.m_PlayerHealth) mask |= Field_Health;
+			if (baseline.m_PlayerPositionX != current.m_PlayerPositionX) mask |= Field_PositionX;
+			if (baseline.m_PlayerPositionY != current.m_PlayerPositionY) mask |= Field_PositionY;
+			if (baseline.m_PlayerArmor != current.m_PlayerArmor) mask |= Field_Armor;
+			if (baseline.m_PlayerVelocityX != current.m_PlayerVelocityX) mask |= Field_VelocityX;
+			if (baseline.m_PlayerVelocityY != current.m_PlayerVelocityY) mask |= Field_VelocityY;
+			if (baseline.m_PlayerRotation != current.m_PlayerRotation) mask |= Field_Rotation;
+			if (baseline.m_PlayerShip != current.m_PlayerShip) mask |= Field_Ship;
+
+			return mask;
+		}
+
+
+
+		// Baseline of the player "id", nullptr if there is none.
+		// Ids are asked for in increasing order, "cursor" is how far the baseline was walked so far.
+		//
+		inline const PlayerDescription* _baselineOf(const PlayerSnapshot* baseline, size_t& cursor, uint32_t id) {
+
+			if (!baseline) return nullptr;
+
+			while (cursor < baseline->size() && (*baseline)[cursor].m_PlayerNetworkID < id) cursor++;
+
+			return (cursor < baseline->size() && (*baseline)[cursor].m_PlayerNetworkID == id) ? &(*baseline)[cursor] : nullptr;
+		}
+
+
+
+		// Quantized variant of the snapshot, same layout as the raw one,
+		// but the count is 16 bits and the fields are quantized, see "NetworkEncoding.h".
+		//
+		inline void _writeSnapshotQuantized(olc::net::message<NetMsg>& msg, uint32_t tick, uint32_t baselineTick, const PlayerSnapshot* baseline, const PlayerSnapshot& current, uint32_t inputSequence) {
+
+			olc::net::bit_writer<NetMsg> out(msg);
+
+			out.write(tick, 32);
+			out.write(baseline ? baselineTick : uint32_t(0), 32);
+			out.write(inputSequence, 32);
+			out.write(uint32_t(current.size()), 16);
+
+			size_t cursor = 0;
+
+			for (const PlayerDescription& desc : current) {
+
+				const PlayerDescription* base = _baselineOf(baseline, cursor, desc.m_PlayerNetworkID);
+				uint8_t mask = base ? computeDeltaMask(*base, desc) : Field_All;
+
+
+				out.write(desc.m_PlayerNetworkID, 32);
+				out.write(mask, 8);
+
+				if (mask & Field_Health) writeHealthQuantized(out, desc.m_PlayerHealth);
+				if (mask & Field_PositionX) writePositionQuantized(out, desc.m_PlayerPositionX);
+				if (mask & Field_PositionY) writePositionQuantized(out, desc.m_PlayerPositionY);
+				if (mask & Field_Armor) writeHealthQuantized(out, desc.m_PlayerArmor);
+				if (mask & Field_VelocityX) writeVelocityQuantized(out, desc.m_PlayerVelocityX);
+				if (mask & Field_VelocityY) writeVelocityQuantized(out, desc.m_PlayerVelocityY);
+				if (mask & Field_Rotation) writeRotationQuantized(out, desc.m_PlayerRotation);
+				if (mask & Field_Ship) writeShipQuantized(out, desc.m_PlayerShip);
+			}
+		}
+
+
+		inline bool _readSnapshotQuantized(const olc::net::message<NetMsg>& msg, const PlayerSnapshotHistory& history, uint32_t& tick, PlayerSnapshot& out, uint32_t& inputSequence) {
+
+			olc::net::bit_reader<NetMsg> in(msg);
+
+			tick = in.read(32);
+			uint32_t baselineTick = in.read(32);
+			inputSequence = in.read(32);
+			uint32_t count = in.read(16);
+
+			if (!in.good()) return false;
+
+
+			const PlayerSnapshot* baseline = history.find(baselineTick);
+			if (baselineTick != 0 && !baseline) return false;
+
+
+			out.clear();
+			size_t cursor = 0;
+
+			for (uint32_t i = 0; i < count; i++) {
+
+				uint32_t id = in.read(32);
+				uint8_t mask = (uint8_t)in.read(8);
+
+
+				// Ordered as written, anything else is malformed.
+				if (!out.empty() && id <= out.back().m_PlayerNetworkID) return false;
+
+				const PlayerDescription* base = _baselineOf(baseline, cursor, id);
+
+				PlayerDescription desc;
+				if (base) desc = *base;
+
+				desc.m_PlayerNetworkID = id;
+
+				if (mask & Field_Health) desc.m_PlayerHealth = readHealthQuantized(in);
+				if (mask & Field_PositionX) desc.m_PlayerPositionX = readPositionQuantized(in);
+				if (mask & Field_PositionY) desc.m_PlayerPositionY = readPositionQuantized(in);
+				if (mask & Field_Armor) desc.m_PlayerArmor = readHealthQuantized(in);
+				if (mask & Field_VelocityX) desc.m_PlayerVelocityX = readVelocityQuantized(in);
+				if (mask & Field_VelocityY) desc.m_PlayerVelocityY = readVelocityQuantized(in);
+				if (mask & Field_Rotation) desc.m_PlayerRotation = readRotationQuantized(in);
+				if (mask & Field_Ship) desc.m_PlayerShip = readShipQuantized(in);
+
+				if (!in.good()) return false;
+
+				out.push_back(desc);
+			}
+
+			return true;
+		}
+
+
+
+		// Write a snapshot into the message as delta to the baseline.
+		// The players of both must be ordered by id, see "sortSnapshot".
+		//
+		// If "baseline" is a nullptr, or a player is not in the baseline, the full state is written.
+		// "baselineTick" must be 0 for a full snapshot.
+		//
+		// "inputSequence" is the last input of the receiving client the server applied, see "NetworkPrediction.h".
+		//
+		// Layout:
+		// tick, baselineTick, inputSequence, count, and for each player: id, mask, changed fields.
+		//
+		// The message is read front to back with a "message_reader",
+		// or with a "bit_reader" if the quantized encoding is chosen for "Game_WorldSnapshot".
+		//
+		inline void writeSnapshot(olc::net::message<NetMsg>& msg, uint32_t tick, uint32_t baselineTick, const PlayerSnapshot* baseline, const PlayerSnapshot& current, uint32_t inputSequence) {
+
+			if (getWireEncoding(msg.header.id) == WireEncoding::Quantized) {
+
+				_writeSnapshotQuantized(msg, tick, baselineTick, baseline, current, inputSequence);
+				return;
+			}
+
+
+			msg << tick;
+			msg << (baseline ? baselineTick : uint32_t(0));
+			msg << inputSequence;
+			msg << uint32_t(current.size());
+
+			size_t cursor = 0;
+
+			for (const PlayerDescription& desc : current) {
+
+				const PlayerDescription* base = _baselineOf(baseline, cursor, desc.m_PlayerNetworkID);
+				uint8_t mask = base ? computeDeltaMask(*base, desc) : Field_All;
+
+
+				msg << desc.m_PlayerNetworkID;
+				msg << mask;
+
+				if (mask & Field_Health) msg << desc.m_PlayerHealth;
+				if (mask & Field_PositionX) msg << desc.m_PlayerPositionX;
+				if (mask & Field_PositionY) msg << desc.m_PlayerPositionY;
+				if (mask & Field_Armor) msg << desc.m_PlayerArmor;
+				if (mask & Field_VelocityX) msg << desc.m_PlayerVelocityX;
+				if (mask & Field_VelocityY) msg << desc.m_PlayerVelocityY;
+				if (mask & Field_Rotation) msg << desc.m_PlayerRotation;
+				if (mask & Field_Ship) msg << desc.m_PlayerShip;
+			}
+		}
+
+
+
+		// Read a snapshot written by "writeSnapshot".
+		//
+		// The baseline is looked up in the history of already received snapshots.
+		// The players read are ordered by id, so the snapshot can be the baseline of later ones.
+		// Returns false if the snapshot references a baseline we do not have,
+		// in which case the receiver should request a full state.
+		// Returns false too if the message is malformed.
+		//
+		inline bool readSnapshot(const olc::net::message<NetMsg>& msg, const PlayerSnapshotHistory& history, uint32_t& tick, PlayerSnapshot& out, uint32_t& inputSequence) {
+
+			if (getWireEncoding(msg.header.id) == WireEncoding::Quantized) {
+
+				return _readSnapshotQuantized(msg, history, tick, out, inputSequence);
+			}
+
+
+			olc::net::message_reader<NetMsg> reader(msg);
+
+			uint32_t baselineTick = 0;
+			uint32_t count = 0;
+
+			reader >> tick;
+			reader >> baselineTick;
+			reader >> inputSequence;
+			reader >> count;
+
+			if (!reader.good()) return false;
+
+
+			const PlayerSnapshot* baseline = history.find(baselineTick);
+			if (baselineTick != 0 && !baseline) return false;
+
+
+			out.clear();
+			size_t cursor = 0;
+
+			for (uint32_t i = 0; i < count; i++) {
+
+				uint32_t id = 0;
+				uint8_t mask = Field_None;
+
+				reader >> id;
+				reader >> mask;
+
+
+				// Ordered as written, anything else is malformed.
+				if (!out.empty() && id <= out.back().m_PlayerNetworkID) return false;
+
+				const PlayerDescription* base = _baselineOf(baseline, cursor, id);
+
+				PlayerDescription desc;
+				if (base) desc = *base;
+
+				desc.m_PlayerNetworkID = id;
+
+				if (mask & Field_Health) reader >> desc.m_PlayerHealth;
+				if (mask & Field_PositionX) reader >> desc.m_PlayerPositionX;
+				if (mask & Field_PositionY) reader >> desc.m_PlayerPositionY;
+				if (mask & Field_Armor) reader >> desc.m_PlayerArmor;
+				if (mask & Field_VelocityX) reader >> desc.m_PlayerVelocityX;
+				if (mask & Field_VelocityY) reader >> desc.m_PlayerVelocityY;
+				if (mask & Field_Rotation) reader >> desc.m_PlayerRotation;
+				if (mask & Field_Ship) reader >> desc.m_PlayerShip;
+
+				if (!reader.good()) return false;
+
+				out.push_back(desc);
+			}
+
+			return true;
+		}
+
+
+
+		// Store a snapshot in the history, over the one "g_SnapshotHistorySize" ticks older.
+		//
+		inline void storeSnapshot(PlayerSnapshotHistory& history, uint32_t tick, const PlayerSnapshot& snapshot) {
+
+			history.store(tick, snapshot);
+		}
+
+	}
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include"NetworkMessages.h"
+
+#include<string>
+#include<fstream>
+#include<sstream>
+#include<cstdio>
+#include<algorithm>
+
+namespace nautilus {
+
+	namespace network {
+
+
+		// Durations collected over an interval, e.g. of the server ticks, for percentiles.
+		//
+		// The samples are kept, so the percentiles are exact.
+		// At a tick rate of 60 and an interval of some seconds these are a few hundred values.
+		//
+		class DurationSamples {
+		public:
+
+			void add(double milliseconds) {
+
+				m_Samples.push_back(milliseconds);
+				m_Sorted = false;
+			}
+
+
+			// Value below which the given fraction of the samples lie, e.g. 0.99.
+			// 0 if there are no samples.
+			//
+			double percentile(double fraction) {
+
+				if (m_Samples.empty()) return 0.0;
+
+				if (!m_Sorted) {
+
+					std::sort(m_Samples.begin(), m_Samples.end());
+					m_Sorted = true;
+				}
+
+				size_t i = (size_t)std::ceil(fraction * m_Samples.size());
+				if (i > 0) i--;
+				return m_Samples[std::min(i, m_Samples.size() - 1)];
+			}
+
+
+			double max() { return percentile(1.0); }
+
+			size_t count() const { return m_Samples.size(); }
+
+			// Keeps the memory for the next interval.
+			void clear() { m_Samples.clear(); }
+
+
+		private:
+
+			std::vector<double> m_Samples;
+			bool m_Sorted = true;
+		};
+
+
+
+		// A text file written line by line, which is moved aside when it gets too large.
+		//
+		// Once the file reaches "maxSize" bytes it is renamed to "<path>.1", the one before to "<path>.2" and so on,
+		// the oldest beyond "keepFiles" is deleted. So at most "keepFiles" + 1 files of about "maxSize" exist.
+		//
+		class RollingFile {
+		public:
+
+			bool open(const std::string& path, uint64_t maxSize, uint32_t keepFiles) {
+
+				m_Path = path;
+				m_MaxSize = maxSize;
+				m_KeepFiles = keepFiles;
+
+				m_File.open(m_Path, std::ios::out | std::ios::app);
+				if (!m_File) return false;
+
+				m_File.seekp(0, std::ios::end);
+				m_Size = (uint64_t)m_File.tellp();
+				return true;
+			}
+
+
+			// Append a line, the line break is added.
+			void writeLine(const std::string& line) {
+
+				if (!m_File.is_open()) return;
+
+				if (m_MaxSize > 0 && m_Size > 0 && m_Size + line.size() + 1 > m_MaxSize) _roll();
+
+				m_File << line << '\n';
+				m_File.flush();
+				m_Size += line.size() + 1;
+			}
+
+
+			bool isOpen() const { return m_File.is_open(); }
+
+
+		private:
+
+			std::string m_Path;
+			uint64_t m_MaxSize = 0;
+			uint32_t m_KeepFiles = 0;
+
+			std::ofstream m_File;
+			uint64_t m_Size = 0;
+
+
+		private:
+
+			void _roll() {
+
+				m_File.close();
+
+				std::remove((m_Path + "." + std::to_string(m_KeepFiles)).c_str());
+
+				for (uint32_t i = m_KeepFiles; i > 1; i--) {
+
+					std::rename((m_Path + "." + std::to_string(i - 1)).c_str(), (m_Path + "." + std::to_string(i)).c_str());
+				}
+
+				if (m_KeepFiles > 0) std::rename(m_Path.c_str(), (m_Path + ".1").c_str());
+				else std::remove(m_Path.c_str());
+
+				m_File.open(m_Path, std::ios::out | std::ios::trunc);
+				m_Size = 0;
+			}
+		};
+
+	}
+
+}
@@ -1,5 +1,14 @@
 #include"Renderer.h"
 
+#include<cstring>
+
+
+// SSE is there on every x64 CPU, the sprite corners are computed with it.
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NAUTILUS_SPRITES_SSE
+#include<xmmintrin.h>
+#endif
+
 
 namespace nautilus {
 
@@ -8,20 +17,47 @@ namespace nautilus {
 
 
 		static RenderData2D* g_pRenderData2D = new RenderData2D();
-		nautilus::graphics::ComponentShader* RenderData2D::m_BatchShader = nullptr;
 
 
-		QuadVertexBuffer::QuadVertexBuffer(int size) : m_RendererID(0) {
+		// "BatchRenderer2D::_writeSprite" writes the vertices as packed floats.
+		static_assert(sizeof(QuadVertex) == 10 * sizeof(float) && offsetof(QuadVertex, Color) == 3 * sizeof(float) &&
+			offsetof(QuadVertex, TextureCoords) == 7 * sizeof(float) && offsetof(QuadVertex, TextureIndex) == 9 * sizeof(float), "Unexpected layout of QuadVertex.");
+
+
+		// Used if no other backend was set.
+		static GLRenderBackend2D g_GLRenderBackend2D;
+
+
+		QuadVertexBuffer::QuadVertexBuffer(int size, bool persistent) : m_RendererID(0), m_Size(size) {
 
 			glGenBuffers(1, &m_RendererID);
 			glBindBuffer(GL_ARRAY_BUFFER, m_RendererID);
-			glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW); // Create buffer for dynamic drawing, we will change the data often on render.
+
+
+			if (persistent) {
+
+				// Coherent, so written vertices are seen by the GPU without flushing them.
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+				glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+				m_MappedData = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+			}
+			else {
+
+				glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW); // Create buffer for dynamic drawing, we will change the data often on render.
+			}
 		}
 
 
 
 		QuadVertexBuffer::~QuadVertexBuffer() {
 
+			if (m_MappedData) {
+
+				glBindBuffer(GL_ARRAY_BUFFER, m_RendererID);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+
 			glDeleteBuffers(1, &m_RendererID);
 		}
 
@@ -33,6 +69,7 @@ namespace nautilus {
 
 			glBindBuffer(GL_ARRAY_BUFFER, m_RendererID);
 
+			glBufferData(GL_ARRAY_BUFFER, m_Size, nullptr, GL_DYNAMIC_DRAW); // Orphan, the draws before keep the old storage.
 			glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
 		}
 
@@ -179,39 +216,16 @@ namespace nautilus {
 			};
 
 
-			// Set texture to new slot.
-			// But before, check whether we already have the same texture set to a slot.
-			float textureIndex = 0;
-			for (int i = 0; i < g_pRenderData2D->m_TextureSlotIndex; i++) {
-
-				// Compare if tex are same.
-				// We compare the assigned GPU index.
-				// For now its the textures GUID, thus we can assure that we compare correctly!
-				if (texture->GetSlot() == g_pRenderData2D->m_TextureSlots[i]->GetSlot()) {
-
-					textureIndex = (float)i;
-					break;
-				}
+			// Start a new batch if this one is full.
+			// Must be before looking for the texture slot, as the new batch has none but the default.
+			if (g_pRenderData2D->m_QuadIndexCount + 6 > g_pRenderData2D->maxIndices) {
 
+				g_pRenderData2D->m_Stats.m_QuadCapacityFlushes++;
+				_nextBatch();
 			}
 
 
-			// Check whether this is a new texture,
-			// and if we reached the batches max textures count.
-			if (textureIndex == 0) {
-
-
-				// Start new batch with new texture.
-				if (g_pRenderData2D->m_TextureSlotIndex >= g_pRenderData2D->maxTextures) {
-
-					_nextBatch();
-				}
-
-				// Set the texture for the new batch.
-				textureIndex = (float)g_pRenderData2D->m_TextureSlotIndex;
-				g_pRenderData2D->m_TextureSlots[g_pRenderData2D->m_TextureSlotIndex] = texture;
-				g_pRenderData2D->m_TextureSlotIndex += 1;
-			}
+			float textureIndex = _getTextureIndex(texture);
 
 
 
@@ -252,34 +266,33 @@ namespace nautilus {
 
 
 
-		void BatchRenderer2D::init() {
+		void BatchRenderer2D::setBackend(IRenderBackend2D* backend) {
 
+			g_pRenderData2D->m_Backend = backend;
+		}
 
-			// First, create out vertex array.
-			g_pRenderData2D->m_BatchVertexArray = new QuadVertexArray();
 
+		IRenderBackend2D* BatchRenderer2D::getBackend() {
 
-			// Create the vertex buffer.
-			g_pRenderData2D->m_BatchVertexBuffer = new QuadVertexBuffer(g_pRenderData2D->maxVerts * sizeof(QuadVertex));
+			return g_pRenderData2D->m_Backend;
+		}
 
 
-			// Add the main batch buffer to vertex array.
-			// In this function we set out default vertex buffer layout.
-			// See Vertex Array..
-			g_pRenderData2D->m_BatchVertexArray->addVertexBuffer(g_pRenderData2D->m_BatchVertexBuffer);
 
+		void BatchRenderer2D::init() {
 
 
-			// Init Quadvertices...
+			if (!g_pRenderData2D->m_Backend) g_pRenderData2D->m_Backend = &g_GLRenderBackend2D;
+
+
+			// The quad vertices are written into memory of the backend, see "_startBatch".
 			const int verts_count = g_pRenderData2D->maxVerts;
-			g_pRenderData2D->m_QuadVertexBegin = new QuadVertex[verts_count]; // These are not initialized.
 
 
 			// Init indices...
 			// Our indices are opengl unsigned int.
 			const int index_count = g_pRenderData2D->maxIndices;
 
-			//GLuint* indices = new GLuint[g_pRenderData2D->maxIndices];
 			std::vector<GLuint> indices;
 			indices.resize(g_pRenderData2D->maxIndices);
 
@@ -306,47 +319,21 @@ namespace nautilus {
 			}
 
 
-			// Now set the index buffers data..
-			// And store it in the vertex array for drawing.
-			g_pRenderData2D->m_BatchVertexArray->setIndexBuffer(new QuadIndexBuffer(&indices[0], index_count));
-			indices.clear();
-
-
-			// Set the default texture.
-			g_pRenderData2D->m_WhiteTexture = new nautilus::graphics::ComponentTexture2D(); // Set the default texture.
-			g_pRenderData2D->m_WhiteTexture->init("particle_texture_sixstar.png"); // load texture.
+			// Let the backend create the buffers, the shader and the default texture.
+			g_pRenderData2D->m_Backend->init(verts_count, &indices[0], index_count);
 
 
-			// Set the textures for teh vertex array.
-			GLint* samplers = new GLint[32];
-
-			for (GLint i = 0; i < 32; i++) {
-				samplers[i] = i;
-			}
-
-
-			// Initialize the shader.
-			g_pRenderData2D->m_BatchShader = new nautilus::graphics::ComponentShader();
-			g_pRenderData2D->m_BatchShader->init("shaderTest"); // Load vert and frag
-			g_pRenderData2D->m_BatchShader->Use();
-
-
-			// Now send the texture samplers to frag shader..
-			// On render we fill the sampler pointers with actuall texture data...
-			// SetUniformArray expects a "const GLint* values",
-			// thus we have to give him a "const", else we only send ONE TEXTURE at index 0
-			// to the Shader Program, that is false and will draw only one texture...
-			g_pRenderData2D->m_BatchShader->SetUniformArray("u_Textures", samplers, 32);
-
-
-			g_pRenderData2D->m_TextureSlots[0] = g_pRenderData2D->m_WhiteTexture; // Default texture.
+			g_pRenderData2D->m_TextureSlots[0] = g_pRenderData2D->m_Backend->getDefaultTexture(); // Default texture.
 		}
 
 
 		void BatchRenderer2D::shutDown() {
 
-			// Delete quad vertices.
-			delete[] g_pRenderData2D->m_QuadVertexBegin;
+			// The quad vertices go with the backend.
+			g_pRenderData2D->m_QuadVertexBegin = nullptr;
+			g_pRenderData2D->m_QuadVertexEnd = nullptr;
+
+			if (g_pRenderData2D->m_Backend) g_pRenderData2D->m_Backend->shutDown();
 		}
 
 
@@ -355,9 +342,10 @@ namespace nautilus {
 		// we call endScene.
 		void BatchRenderer2D::beginScene(glm::mat4 view_projection) {
 
-			g_pRenderData2D->m_BatchShader->Use(); // Bind shader.
+			g_pRenderData2D->m_Backend->beginScene(view_projection); // Bind shader and upload matrix to gpu.
 
-			g_pRenderData2D->m_BatchShader->SetUniform("u_ViewProjection", view_projection); // Upload matrix to gpu
+			g_pRenderData2D->m_Stats = BatchRenderer2DStats();
+			g_pRenderData2D->m_BlendMode = BlendMode::Alpha; // The application blends by alpha.
 
 			// Start buffer...
 			_startBatch();
@@ -367,8 +355,162 @@ namespace nautilus {
 
 		void BatchRenderer2D::endScene() {
 
+			_drawQueue();
+
 			// Order to render to the screen.
 			_flush();
+
+
+			// Leave alpha blending for whatever is drawn after the scene.
+			if (g_pRenderData2D->m_BlendMode != BlendMode::Alpha) {
+
+				g_pRenderData2D->m_BlendMode = BlendMode::Alpha;
+				g_pRenderData2D->m_Backend->setBlendMode(BlendMode::Alpha);
+			}
+		}
+
+
+		void BatchRenderer2D::submit(const SpriteInstance& sprite, RenderLayer layer, BlendMode blend) {
+
+			g_pRenderData2D->m_Queue.submit(sprite, layer, blend);
+		}
+
+
+		void BatchRenderer2D::setBlendMode(BlendMode mode) {
+
+			if (mode == g_pRenderData2D->m_BlendMode) return;
+
+
+			// The quads so far are drawn with the old mode.
+			_nextBatch();
+
+			g_pRenderData2D->m_BlendMode = mode;
+			g_pRenderData2D->m_Backend->setBlendMode(mode);
+
+			g_pRenderData2D->m_Stats.m_BlendModeChanges++;
+		}
+
+
+		void BatchRenderer2D::_drawQueue() {
+
+			RenderQueue2D& queue = g_pRenderData2D->m_Queue;
+
+			if (queue.empty()) return;
+
+
+			queue.sort();
+
+			const std::vector<RenderQueue2D::Item>& items = queue.getItems();
+			const std::vector<SpriteInstance>& sprites = queue.getSortedSprites();
+
+
+			size_t begin = 0;
+			while (begin < items.size()) {
+
+				BlendMode blend = RenderQueue2D::getBlendMode(items[begin].m_Key);
+
+				size_t end = begin + 1;
+				while (end < items.size() && RenderQueue2D::getBlendMode(items[end].m_Key) == blend) end++;
+
+
+				setBlendMode(blend);
+				drawSprites(&sprites[begin], end - begin);
+
+				begin = end;
+			}
+
+
+			g_pRenderData2D->m_Stats.m_QueuedSprites += (uint32_t)items.size();
+
+			queue.clear();
+		}
+
+
+
+
+		uint64_t RenderQueue2D::makeSortKey(RenderLayer layer, BlendMode blend, uint32_t shader, const ComponentTexture2D* texture, float depth) {
+
+			// Texture handles are small numbers, two textures sharing the lower bits are only not grouped.
+			uint64_t textureID = texture ? (uint64_t)texture->GetSlot() : 0;
+
+
+			// Floats ordered as unsigned, negative ones reversed below the positive ones.
+			uint32_t depthBits;
+			std::memcpy(&depthBits, &depth, sizeof(float));
+			depthBits = (depthBits & 0x80000000u) ? ~depthBits : (depthBits | 0x80000000u);
+
+
+			return ((uint64_t)layer << 56) |
+				((uint64_t)((uint8_t)blend & 0xF) << 52) |
+				((uint64_t)(shader & 0xFF) << 44) |
+				((textureID & 0xFFFFF) << 24) |
+				(uint64_t)(depthBits >> 8);
+		}
+
+
+		void RenderQueue2D::submit(const SpriteInstance& sprite, RenderLayer layer, BlendMode blend) {
+
+			m_Items.push_back({ makeSortKey(layer, blend, 0, sprite.m_Texture, sprite.m_Depth), (uint32_t)m_Sprites.size() });
+			m_Sprites.push_back(sprite);
+		}
+
+
+		void RenderQueue2D::sort() {
+
+			const size_t count = m_Items.size();
+
+
+			// Count the values of each byte of the keys, for all passes at once.
+			uint32_t histograms[8][256] = {};
+
+			for (const Item& item : m_Items) {
+
+				for (int b = 0; b < 8; b++) histograms[b][(item.m_Key >> (b * 8)) & 0xFF]++;
+			}
+
+
+			// A pass for each byte from the lowest on, which keeps the order of equal keys.
+			m_ScratchItems.resize(count);
+
+			for (int b = 0; b < 8 && count > 1; b++) {
+
+				uint32_t* histogram = histograms[b];
+
+				// All keys have the same byte, nothing to do.
+				if (histogram[(m_Items[0].m_Key >> (b * 8)) & 0xFF] == count) continue;
+
+
+				uint32_t offset = 0;
+				for (int i = 0; i < 256; i++) {
+
+					uint32_t n = histogram[i];
+					histogram[i] = offset;
+					offset += n;
+				}
+
+				for (const Item& item : m_Items) {
+
+					m_ScratchItems[histogram[(item.m_Key >> (b * 8)) & 0xFF]++] = item;
+				}
+
+				m_Items.swap(m_ScratchItems);
+			}
+
+
+			m_SortedSprites.resize(count);
+
+			for (size_t i = 0; i < count; i++) {
+
+				m_SortedSprites[i] = m_Sprites[m_Items[i].m_Sprite];
+			}
+		}
+
+
+		void RenderQueue2D::clear() {
+
+			m_Sprites.clear();
+			m_SortedSprites.clear();
+			m_Items.clear();
 		}
 
 
@@ -376,7 +518,9 @@ namespace nautilus {
 
 
 			// Reset data for batch.
+			// The vertices are written straight into the memory the backend draws from.
 			g_pRenderData2D->m_QuadIndexCount = 0;
+			g_pRenderData2D->m_QuadVertexBegin = g_pRenderData2D->m_Backend->mapVertices();
 			g_pRenderData2D->m_QuadVertexEnd = g_pRenderData2D->m_QuadVertexBegin;
 
 			g_pRenderData2D->m_TextureSlotIndex = 1;
@@ -386,7 +530,184 @@ namespace nautilus {
 		void BatchRenderer2D::_nextBatch() {
 
 			_flush();
-			_nextBatch();
+			_startBatch();
+		}
+
+
+		float BatchRenderer2D::_getTextureIndex(nautilus::graphics::ComponentTexture2D* texture) {
+
+			// Set texture to new slot.
+			// But before, check whether we already have the same texture set to a slot.
+			// The default texture in slot 0 is found too.
+			float textureIndex = -1.0f;
+			for (int i = 0; i < g_pRenderData2D->m_TextureSlotIndex; i++) {
+
+				// Compare if tex are same.
+				// We compare the assigned GPU index.
+				// For now its the textures GUID, thus we can assure that we compare correctly!
+				if (texture->GetSlot() == g_pRenderData2D->m_TextureSlots[i]->GetSlot()) {
+
+					textureIndex = (float)i;
+					break;
+				}
+
+			}
+
+
+			// Check whether this is a new texture,
+			// and if we reached the batches max textures count.
+			if (textureIndex < 0.0f) {
+
+
+				// Start new batch with new texture.
+				if (g_pRenderData2D->m_TextureSlotIndex >= g_pRenderData2D->maxTextures) {
+
+					g_pRenderData2D->m_Stats.m_TextureSlotOverflows++;
+					_nextBatch();
+				}
+
+				// Set the texture for the new batch.
+				textureIndex = (float)g_pRenderData2D->m_TextureSlotIndex;
+				g_pRenderData2D->m_TextureSlots[g_pRenderData2D->m_TextureSlotIndex] = texture;
+				g_pRenderData2D->m_TextureSlotIndex += 1;
+			}
+
+
+			return textureIndex;
+		}
+
+
+
+		void BatchRenderer2D::drawSprites(const SpriteInstance* sprites, size_t count) {
+
+			ComponentTexture2D* lastTexture = nullptr;
+			float textureIndex = 0.0f;
+
+
+			for (size_t i = 0; i < count; i++) {
+
+				const SpriteInstance& sprite = sprites[i];
+
+
+				// Same as in "draw", the new batch must be started before looking for the texture slot.
+				if (g_pRenderData2D->m_QuadIndexCount + 6 > g_pRenderData2D->maxIndices) {
+
+					g_pRenderData2D->m_Stats.m_QuadCapacityFlushes++;
+					_nextBatch();
+
+					lastTexture = nullptr;
+				}
+
+
+				// Sprites mostly come in runs of the same texture, e.g. all particles of a system.
+				ComponentTexture2D* texture = sprite.m_Texture ? sprite.m_Texture : g_pRenderData2D->m_TextureSlots[0];
+
+				if (texture != lastTexture) {
+
+					textureIndex = _getTextureIndex(texture);
+					lastTexture = texture;
+				}
+
+
+				_writeSprite(sprite, textureIndex);
+
+				g_pRenderData2D->m_QuadVertexEnd += 4;
+				g_pRenderData2D->m_QuadIndexCount += 6;
+			}
+		}
+
+
+		void BatchRenderer2D::_writeSprite(const SpriteInstance& sprite, float textureIndex) {
+
+			// Corner k is at
+			//
+			//		position + rotation * (scale * corner k of the unit quad).
+			//
+			// With c = cos, s = sin and (lx, ly) the corner of the unit quad:
+			//
+			//		x = px + c * sx * lx - s * sy * ly
+			//		y = py + s * sx * lx + c * sy * ly
+			//
+			const float c = std::cos(sprite.m_Rotation);
+			const float s = std::sin(sprite.m_Rotation);
+
+			QuadVertex* vertices = g_pRenderData2D->m_QuadVertexEnd;
+
+
+#ifdef NAUTILUS_SPRITES_SSE
+
+			// One register holds the x, one the y of all 4 corners, in the order of "m_QuadVertexPositions".
+			const __m128 lx = _mm_setr_ps(-0.5f, 0.5f, 0.5f, -0.5f);
+			const __m128 ly = _mm_setr_ps(-0.5f, -0.5f, 0.5f, 0.5f);
+
+			const __m128 x = _mm_add_ps(_mm_set1_ps(sprite.m_Position.x),
+				_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(c * sprite.m_Scale.x), lx), _mm_mul_ps(_mm_set1_ps(s * sprite.m_Scale.y), ly)));
+
+			const __m128 y = _mm_add_ps(_mm_set1_ps(sprite.m_Position.y),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(s * sprite.m_Scale.x), lx), _mm_mul_ps(_mm_set1_ps(c * sprite.m_Scale.y), ly)));
+
+
+			// The 4 vertices are 40 floats one after another, written as 10 registers:
+			//
+			//		x0 y0 z  r | g  b  a  u0 | v0 t  x1 y1 | z  r  g  b | a  u1 v1 t
+			//		x2 y2 z  r | g  b  a  u2 | v2 t  x3 y3 | z  r  g  b | a  u3 v3 t
+			//
+			// So the batch memory, which can be mapped GPU memory, is only written, front to back.
+			//
+			const __m128 rgba = _mm_loadu_ps(&sprite.m_Color.r);
+			const __m128 xy01 = _mm_unpacklo_ps(x, y);
+			const __m128 xy23 = _mm_unpackhi_ps(x, y);
+
+			const __m128 zrgb = _mm_shuffle_ps(_mm_unpacklo_ps(_mm_set_ss(sprite.m_Depth), rgba), rgba, _MM_SHUFFLE(2, 1, 1, 0));
+
+			const float a = sprite.m_Color.a;
+			const glm::vec4& uv = sprite.m_TextureRect;
+			const __m128 auvt0 = _mm_setr_ps(a, uv.x, uv.y, textureIndex);
+			const __m128 auvt1 = _mm_setr_ps(a, uv.z, uv.y, textureIndex);
+			const __m128 auvt2 = _mm_setr_ps(a, uv.z, uv.w, textureIndex);
+			const __m128 auvt3 = _mm_setr_ps(a, uv.x, uv.w, textureIndex);
+
+			float* out = &vertices->Position.x;
+
+			_mm_storeu_ps(out + 0, _mm_movelh_ps(xy01, zrgb));
+			_mm_storeu_ps(out + 4, _mm_shuffle_ps(rgba, auvt0, _MM_SHUFFLE(1, 0, 2, 1)));
+			_mm_storeu_ps(out + 8, _mm_shuffle_ps(auvt0, xy01, _MM_SHUFFLE(3, 2, 3, 2)));
+			_mm_storeu_ps(out + 12, zrgb);
+			_mm_storeu_ps(out + 16, auvt1);
+
+			_mm_storeu_ps(out + 20, _mm_movelh_ps(xy23, zrgb));
+			_mm_storeu_ps(out + 24, _mm_shuffle_ps(rgba, auvt2, _MM_SHUFFLE(1, 0, 2, 1)));
+			_mm_storeu_ps(out + 28, _mm_shuffle_ps(auvt2, xy23, _MM_SHUFFLE(3, 2, 3, 2)));
+			_mm_storeu_ps(out + 32, zrgb);
+			_mm_storeu_ps(out + 36, auvt3);
+
+#else
+
+			const glm::vec2 textureCoords[4] = {
+				glm::vec2(sprite.m_TextureRect.x, sprite.m_TextureRect.y),
+				glm::vec2(sprite.m_TextureRect.z, sprite.m_TextureRect.y),
+				glm::vec2(sprite.m_TextureRect.z, sprite.m_TextureRect.w),
+				glm::vec2(sprite.m_TextureRect.x, sprite.m_TextureRect.w)
+			};
+
+			for (int i = 0; i < 4; i++) {
+
+				float lx = g_pRenderData2D->m_QuadVertexPositions[i].x * sprite.m_Scale.x;
+				float ly = g_pRenderData2D->m_QuadVertexPositions[i].y * sprite.m_Scale.y;
+
+				vertices[i].Position = glm::vec3(sprite.m_Position.x + c * lx - s * ly, sprite.m_Position.y + s * lx + c * ly, sprite.m_Depth);
+				vertices[i].Color = sprite.m_Color;
+				vertices[i].TextureCoords = textureCoords[i];
+				vertices[i].TextureIndex = textureIndex;
+			}
+
+#endif
+		}
+
+
+		const BatchRenderer2DStats& BatchRenderer2D::getStats() {
+
+			return g_pRenderData2D->m_Stats;
 		}
 
 
@@ -407,8 +728,8 @@ namespace nautilus {
 
 
 
-			// Set the actuall data for rendering to the batch buffer.
-			g_pRenderData2D->m_BatchVertexBuffer->setBufferData(g_pRenderData2D->m_QuadVertexBegin, datasize);
+			// The actuall data for rendering is in the batch buffer, let the backend finish it.
+			g_pRenderData2D->m_Backend->unmapVertices(datasize);
 
 
 
@@ -424,7 +745,7 @@ namespace nautilus {
 				cout << "Texture \"" << g_pRenderData2D->m_TextureSlots[i]->m_FilePath << "\" \n" << white;
 				*/
 
-				g_pRenderData2D->m_TextureSlots[i]->BindForBatch((GLuint)i); // Bind texture to certain slot.
+				g_pRenderData2D->m_Backend->bindTexture(g_pRenderData2D->m_TextureSlots[i], i); // Bind texture to certain slot.
 			}
 
 
@@ -434,18 +755,190 @@ namespace nautilus {
 			// Now make a render call.
 			// Render with data we have set and textures...
 
-			// Set count of indices we have.
-			// If we want draw all indices, we just set 0.
-			// Else we want to draw the specified indices count.
-			int count = g_pRenderData2D->m_QuadIndexCount ? g_pRenderData2D->m_QuadIndexCount : g_pRenderData2D->m_BatchVertexArray->getIndicesCount();
-
+			// Set count of indices we have, nothing is drawn without any.
 			//cout << color(colors::BLUE);
-			//cout << "Indices Count: " << count << white << endl;
+			//cout << "Indices Count: " << g_pRenderData2D->m_QuadIndexCount << white << endl;
+
+			g_pRenderData2D->m_Backend->drawIndexed(g_pRenderData2D->m_QuadIndexCount);
+
+
+			g_pRenderData2D->m_Stats.m_Batches++;
+			g_pRenderData2D->m_Stats.m_Quads += g_pRenderData2D->m_QuadIndexCount / 6;
+		}
+
+
+
+
+		void GLRenderBackend2D::init(int maxVertices, const GLuint* indices, int indexCount) {
+
+
+			// First, create out vertex array.
+			m_VertexArray = new QuadVertexArray();
+
+
+			// Create the vertex buffer.
+			// With buffer storage one persistently mapped buffer with a segment for each batch in flight,
+			// drawing from a segment needs a base vertex.
+			m_MaxVertices = maxVertices;
+			m_Segment = 0;
+
+			bool persistent = m_AllowPersistentMapping &&
+				(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) &&
+				(GLEW_VERSION_3_2 || GLEW_ARB_draw_elements_base_vertex);
+
+			if (persistent) {
+
+				m_VertexBuffer = new QuadVertexBuffer(g_VertexRingSegments * maxVertices * sizeof(QuadVertex), true);
+				m_PersistentVertices = (QuadVertex*)m_VertexBuffer->getMappedData();
+
+				// Mapping failed, use the upload path.
+				if (!m_PersistentVertices) {
+
+					delete m_VertexBuffer;
+					m_VertexBuffer = nullptr;
+				}
+			}
+
+			if (!m_PersistentVertices) {
+
+				m_VertexBuffer = new QuadVertexBuffer(maxVertices * sizeof(QuadVertex));
+				m_StagingVertices.resize(maxVertices);
+			}
+
+
+			// Add the main batch buffer to vertex array.
+			// In this function we set out default vertex buffer layout.
+			// See Vertex Array..
+			m_VertexArray->addVertexBuffer(m_VertexBuffer);
+
+
+			// Now set the index buffers data..
+			// And store it in the vertex array for drawing.
+			m_VertexArray->setIndexBuffer(new QuadIndexBuffer(const_cast<GLuint*>(indices), indexCount));
+
+
+			// Set the default texture.
+			m_WhiteTexture = new nautilus::graphics::ComponentTexture2D(); // Set the default texture.
+			m_WhiteTexture->init("particle_texture_sixstar.png"); // load texture.
+
+
+			// Set the textures for teh vertex array.
+			GLint* samplers = new GLint[32];
 
+			for (GLint i = 0; i < 32; i++) {
+				samplers[i] = i;
+			}
+
+
+			// Initialize the shader.
+			m_Shader = new nautilus::graphics::ComponentShader();
+			m_Shader->init("shaderTest"); // Load vert and frag
+			m_Shader->Use();
+
+
+			// Now send the texture samplers to frag shader..
+			// On render we fill the sampler pointers with actuall texture data...
+			// SetUniformArray expects a "const GLint* values",
+			// thus we have to give him a "const", else we only send ONE TEXTURE at index 0
+			// to the Shader Program, that is false and will draw only one texture...
+			m_Shader->SetUniformArray("u_Textures", samplers, 32);
+		}
+
+
+		void GLRenderBackend2D::shutDown() {
+
+			for (GLsync& fence : m_SegmentFences) {
+
+				if (fence) glDeleteSync(fence);
+				fence = nullptr;
+			}
+
+
+			// The vertex array does not own its buffers.
+			delete m_VertexArray;
+			delete m_VertexBuffer;
+			delete m_Shader;
+			delete m_WhiteTexture;
+
+			m_VertexArray = nullptr;
+			m_VertexBuffer = nullptr;
+			m_PersistentVertices = nullptr;
+			m_Shader = nullptr;
+			m_WhiteTexture = nullptr;
+		}
+
+
+		void GLRenderBackend2D::beginScene(const glm::mat4& viewProjection) {
+
+			m_Shader->Use(); // Bind shader.
+
+			m_Shader->SetUniform("u_ViewProjection", viewProjection); // Upload matrix to gpu
+		}
+
+
+		void GLRenderBackend2D::setBlendMode(BlendMode mode) {
+
+			if (mode == BlendMode::Additive) glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+			else glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+
+
+		QuadVertex* GLRenderBackend2D::mapVertices() {
+
+			if (!m_PersistentVertices) return m_StagingVertices.data();
+
+
+			// Wait until the GPU is done with what was drawn from this segment the last time round.
+			// Mostly it is long done, else the CPU is a whole ring of batches ahead.
+			GLsync& fence = m_SegmentFences[m_Segment];
+
+			if (fence) {
+
+				GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+				while (result == GL_TIMEOUT_EXPIRED) {
+
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms.
+				}
+
+				glDeleteSync(fence);
+				fence = nullptr;
+			}
+
+			return m_PersistentVertices + (size_t)m_Segment * m_MaxVertices;
+		}
+
+
+		void GLRenderBackend2D::unmapVertices(int size) {
+
+			// The persistent buffer is coherent, the GPU sees the vertices already.
+			if (m_PersistentVertices) return;
 
-			glDrawElements(GL_TRIANGLES, (GLsizei)count, GL_UNSIGNED_INT, nullptr);
+			m_VertexBuffer->setBufferData(m_StagingVertices.data(), size);
+		}
+
+
+		void GLRenderBackend2D::bindTexture(ComponentTexture2D* texture, int slot) {
+
+			texture->BindForBatch((GLuint)slot);
+		}
+
+
+		void GLRenderBackend2D::drawIndexed(int indexCount) {
 
+			if (m_PersistentVertices) {
 
+				// The indices start at 0 for each batch, the base vertex moves them to the segment.
+				glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, nullptr, m_Segment * m_MaxVertices);
+
+				// Guard the segment until the GPU has drawn it, and write the next batch into the next one.
+				m_SegmentFences[m_Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				m_Segment = (m_Segment + 1) % g_VertexRingSegments;
+			}
+			else {
+
+				glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, nullptr);
+			}
 
 			glBindTexture(GL_TEXTURE_2D, 0); // Unbind textzres.
 		}
@@ -453,6 +946,73 @@ namespace nautilus {
 
 
 
+		void RecordingRenderBackend2D::init(int maxVertices, const GLuint* indices, int indexCount) {
+
+			m_MaxVertices = maxVertices;
+			m_IndexCount = indexCount;
+
+			m_Vertices.resize(maxVertices);
+		}
+
+
+		void RecordingRenderBackend2D::beginScene(const glm::mat4& viewProjection) {
+
+			m_ViewProjection = viewProjection;
+			m_Counters.m_Scenes++;
+
+			if (m_RecordCommands) m_Commands.push_back({ RenderCommand::Type::BeginScene, 0, 0, 0 });
+		}
+
+
+		void RecordingRenderBackend2D::setBlendMode(BlendMode mode) {
+
+			m_Counters.m_BlendModeChanges++;
+
+			if (m_RecordCommands) m_Commands.push_back({ RenderCommand::Type::SetBlendMode, (int)mode, 0, 0 });
+		}
+
+
+		void RecordingRenderBackend2D::unmapVertices(int size) {
+
+			const QuadVertex* vertices = m_Vertices.data();
+
+			m_Counters.m_Uploads++;
+			m_Counters.m_UploadedBytes += (uint64_t)size;
+
+			size_t offset = m_VertexData.size();
+			if (m_CaptureVertices) m_VertexData.insert(m_VertexData.end(), (const uint8_t*)vertices, (const uint8_t*)vertices + size);
+
+			if (m_RecordCommands) m_Commands.push_back({ RenderCommand::Type::UnmapVertices, size, 0, offset });
+		}
+
+
+		void RecordingRenderBackend2D::bindTexture(ComponentTexture2D* texture, int slot) {
+
+			m_Counters.m_TextureBinds++;
+
+			if (m_RecordCommands) m_Commands.push_back({ RenderCommand::Type::BindTexture, slot, texture->GetSlot(), 0 });
+		}
+
+
+		void RecordingRenderBackend2D::drawIndexed(int indexCount) {
+
+			m_Counters.m_DrawCalls++;
+			m_Counters.m_Indices += (uint64_t)indexCount;
+
+			if (m_RecordCommands) m_Commands.push_back({ RenderCommand::Type::DrawIndexed, indexCount, 0, 0 });
+		}
+
+
+		void RecordingRenderBackend2D::clear() {
+
+			m_Counters = RenderBackendCounters();
+			m_Commands.clear();
+			m_VertexData.clear();
+		}
+
+
+
+
 	}
 
 
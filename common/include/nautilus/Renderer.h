@@ -64,16 +64,25 @@ namespace nautilus {
 			// A quad vertex buffer takes in only the size
 			// of the buffer to be created.
 			// Later, we set dynamically the vertices, that is data.
-			QuadVertexBuffer(int size);
+			//
+			// A "persistent" buffer has immutable storage (ARB_buffer_storage), which stays mapped
+			// until the buffer is destroyed, see "getMappedData". Such a buffer is not set with "setBufferData".
+			QuadVertexBuffer(int size, bool persistent = false);
 			~QuadVertexBuffer();
 
 
 
 			// Set the data of this buffer.
 			// Intended to be set every flush frame.
+			// The old storage is orphaned first, so the driver does not wait for draws still using it.
 			void setBufferData(const void* data, int size);
 
 
+			// Memory of a persistent buffer, which the GPU reads from directly.
+			// nullptr for a normal buffer.
+			void* getMappedData() const { return m_MappedData; }
+
+
 			// Every buffer should be able to be bound and
 			// unbound.
 			void bind();
@@ -87,6 +96,10 @@ namespace nautilus {
 			// which we save here.
 			GLuint m_RendererID;
 
+
+			int m_Size = 0;
+			void* m_MappedData = nullptr;
+
 		private:
 
 		};
@@ -163,6 +176,381 @@ namespace nautilus {
 
 
 
+		// How the quads are blended with what is drawn already.
+		enum class BlendMode : uint8_t {
+
+			Alpha, // Over what is behind, by alpha. The default.
+			Additive // Added to what is behind, e.g. for glowing effects.
+		};
+
+
+
+
+		// What the batch renderer needs from the graphics API.
+		//
+		// The batch renderer only collects the quads on the CPU, everything touching the GPU goes through here.
+		// "GLRenderBackend2D" draws with OpenGL, "RecordingRenderBackend2D" only records the calls,
+		// so the batching can run, be measured and be tested without a GPU.
+		//
+		class IRenderBackend2D {
+		public:
+
+			virtual ~IRenderBackend2D() = default;
+
+
+			// Create the vertex buffer for "maxVertices" vertices and the index buffer.
+			// The indices do not change afterwards.
+			virtual void init(int maxVertices, const GLuint* indices, int indexCount) = 0;
+			virtual void shutDown() = 0;
+
+
+			// Texture in slot 0, used by quads without a texture of theyre own.
+			virtual ComponentTexture2D* getDefaultTexture() = 0;
+
+
+			// Bind the shader and set the view projection for all batches until the next scene.
+			virtual void beginScene(const glm::mat4& viewProjection) = 0;
+
+
+			// Blending of the following draws.
+			virtual void setBlendMode(BlendMode mode) = 0;
+
+
+			// Memory for the vertices of the next batch, with room for "maxVertices" of "init".
+			// The batch renderer writes the quads straight into it and calls "unmapVertices" before drawing.
+			//
+			// Calling it again without a draw in between returns the same memory.
+			// The memory must only be written, it can be mapped GPU memory, where reading is very slow.
+			virtual QuadVertex* mapVertices() = 0;
+
+
+			// The first "size" bytes of the mapped vertices are written, make them ready for the next draw.
+			virtual void unmapVertices(int size) = 0;
+
+			virtual void bindTexture(ComponentTexture2D* texture, int slot) = 0;
+
+
+			// Draw "indexCount" indices with the uploaded vertices and bound textures.
+			virtual void drawIndexed(int indexCount) = 0;
+		};
+
+
+
+
+		// Count of batches the persistent vertex buffer of "GLRenderBackend2D" has room for.
+		// While the GPU still draws one, the next ones can be written.
+		static const int g_VertexRingSegments = 3;
+
+
+
+		// The OpenGL path.
+		//
+		// One vertex array and the batch shader with all 32 texture slots.
+		//
+		// With ARB_buffer_storage the vertex buffer is persistently mapped and split into "g_VertexRingSegments" segments of one batch each.
+		// The quads are written straight into the segment, which is drawn with a base vertex,
+		// and a fence after the draw tells when the segment can be written again.
+		// So there is no copy of the batch and no upload waiting for the GPU.
+		//
+		// Without, the quads are collected in memory of theyre own, which is uploaded on each flush into an orphaned buffer.
+		//
+		class GLRenderBackend2D : public IRenderBackend2D {
+		public:
+
+			// Without "allowPersistentMapping" the upload path is used, even if buffer storage is there.
+			GLRenderBackend2D(bool allowPersistentMapping = true) : m_AllowPersistentMapping(allowPersistentMapping) {}
+
+
+			void init(int maxVertices, const GLuint* indices, int indexCount) override;
+			void shutDown() override;
+
+			ComponentTexture2D* getDefaultTexture() override { return m_WhiteTexture; }
+
+			void beginScene(const glm::mat4& viewProjection) override;
+			void setBlendMode(BlendMode mode) override;
+			QuadVertex* mapVertices() override;
+			void unmapVertices(int size) override;
+			void bindTexture(ComponentTexture2D* texture, int slot) override;
+			void drawIndexed(int indexCount) override;
+
+
+			// Whether the persistent ring is used, valid after "init".
+			bool isPersistentlyMapped() const { return m_PersistentVertices != nullptr; }
+
+
+		private:
+
+			// The array for the batch, and the vertex buffer, either the persistent ring or the one the data is set to on flush.
+			QuadVertexArray* m_VertexArray = nullptr;
+			QuadVertexBuffer* m_VertexBuffer = nullptr;
+
+			bool m_AllowPersistentMapping;
+			int m_MaxVertices = 0;
+
+
+			// The persistent ring, the segment being written and the fences of the segments drawn.
+			QuadVertex* m_PersistentVertices = nullptr;
+			int m_Segment = 0;
+			GLsync m_SegmentFences[g_VertexRingSegments] = {};
+
+
+			// Batch for the upload path.
+			std::vector<QuadVertex> m_StagingVertices;
+
+
+			// The shader for all quads, bound on each scene.
+			ComponentShader* m_Shader = nullptr;
+
+
+			// Texture for binding as default.
+			ComponentTexture2D* m_WhiteTexture = nullptr;
+		};
+
+
+
+
+		// Counters of what the batch renderer sent to a "RecordingRenderBackend2D".
+		struct RenderBackendCounters {
+
+			uint64_t m_Scenes = 0;
+			uint64_t m_Uploads = 0;
+			uint64_t m_UploadedBytes = 0;
+			uint64_t m_TextureBinds = 0;
+			uint64_t m_DrawCalls = 0;
+			uint64_t m_Indices = 0;
+			uint64_t m_BlendModeChanges = 0;
+		};
+
+
+		// One call to a "RecordingRenderBackend2D".
+		struct RenderCommand {
+
+			enum class Type : uint8_t {
+				BeginScene,
+				UnmapVertices,
+				BindTexture,
+				DrawIndexed,
+				SetBlendMode
+			};
+
+			Type m_Type = Type::BeginScene;
+
+
+			// Bytes of vertices written, slot bound, indices drawn or the blend mode.
+			int m_Count = 0;
+
+
+			// Texture bound, the value of its "GetSlot".
+			GLuint m_Texture = 0;
+
+
+			// Where the uploaded vertices start in "getVertexData", if they are captured.
+			size_t m_DataOffset = 0;
+		};
+
+
+		// Backend without a GPU.
+		//
+		// Nothing is drawn, the calls are only counted and, if wanted, recorded with theyre data,
+		// so the batching can be benchmarked and checked, e.g. how often a scene is split into batches.
+		//
+		// Textures are told apart only by "GetSlot", so for running without a GPU
+		// give each texture a handle of its own with "SetHandle".
+		//
+		class RecordingRenderBackend2D : public IRenderBackend2D {
+		public:
+
+			// "recordCommands" keeps each call, without only the counters are updated, e.g. for measuring throughput.
+			// "captureVertices" copies each upload, e.g. to compare the vertices with the ones of a known good run.
+			RecordingRenderBackend2D(bool recordCommands = true, bool captureVertices = false) : m_RecordCommands(recordCommands), m_CaptureVertices(captureVertices) {
+
+				m_WhiteTexture.SetHandle(0);
+			}
+
+
+			void init(int maxVertices, const GLuint* indices, int indexCount) override;
+			void shutDown() override {}
+
+			ComponentTexture2D* getDefaultTexture() override { return &m_WhiteTexture; }
+
+			void beginScene(const glm::mat4& viewProjection) override;
+			void setBlendMode(BlendMode mode) override;
+			QuadVertex* mapVertices() override { return m_Vertices.data(); }
+			void unmapVertices(int size) override;
+			void bindTexture(ComponentTexture2D* texture, int slot) override;
+			void drawIndexed(int indexCount) override;
+
+
+			// Forget the recorded commands, data and counters.
+			void clear();
+
+
+			const RenderBackendCounters& getCounters() const { return m_Counters; }
+			const std::vector<RenderCommand>& getCommands() const { return m_Commands; }
+			const std::vector<uint8_t>& getVertexData() const { return m_VertexData; }
+
+			const glm::mat4& getViewProjection() const { return m_ViewProjection; }
+			int getMaxVertices() const { return m_MaxVertices; }
+			int getIndexCount() const { return m_IndexCount; }
+
+
+		private:
+
+			bool m_RecordCommands;
+			bool m_CaptureVertices;
+
+			// The batch is written here.
+			std::vector<QuadVertex> m_Vertices;
+
+			RenderBackendCounters m_Counters;
+			std::vector<RenderCommand> m_Commands;
+			std::vector<uint8_t> m_VertexData;
+
+			glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+			int m_MaxVertices = 0;
+			int m_IndexCount = 0;
+
+			ComponentTexture2D m_WhiteTexture;
+		};
+
+
+
+
+
+
+		// One sprite for "BatchRenderer2D::drawSprites".
+		//
+		// The quad is scaled, rotated around its center and moved to the position,
+		// the same as a model transform of translate * rotate * scale would.
+		//
+		struct SpriteInstance {
+
+			glm::vec2 m_Position = glm::vec2(0.0f);
+			glm::vec2 m_Scale = glm::vec2(1.0f);
+			float m_Rotation = 0.0f; // Radians, counter clockwise.
+			float m_Depth = 1.0f; // z of the quad.
+
+
+			// Texture coordinates of the first (bottom left) and the third (top right) corner,
+			// as u, v and u, v. The other corners are set from these.
+			glm::vec4 m_TextureRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+			glm::vec4 m_Color = glm::vec4(1.0f);
+
+
+			// nullptr for the default texture.
+			ComponentTexture2D* m_Texture = nullptr;
+
+
+			// Take the texture coordinates of a memory protocol, which are a rectangle for all sprites and animations.
+			void setTextureCoords(const ComponentMemoryProtocol2D& memoryProtocol) {
+
+				m_TextureRect = glm::vec4(memoryProtocol.m_TextureCoords[0], memoryProtocol.m_TextureCoords[2]);
+			}
+		};
+
+
+
+
+
+		// Layers of a scene, drawn from the first to the last, so later ones are on top.
+		//
+		// The values in between are layers too, e.g. "(RenderLayer)((uint8_t)RenderLayer::World + 1)"
+		// is drawn over the world but under the effects.
+		//
+		enum class RenderLayer : uint8_t {
+
+			Background = 0,
+			World = 64, // Ships, bullets and other objects.
+			Effects = 128, // Particles etc.
+			UI = 192
+		};
+
+
+
+
+		// Sprites to be drawn in the order of a 64 bit key, not in the order they were submitted.
+		//
+		// The key is, from the highest bits to the lowest:
+		//
+		//		layer (8) | blend mode (4) | shader (8) | texture (20) | depth (24)
+		//
+		// So the layers come in order, and within a layer the sprites of a blend mode and a texture come together,
+		// which keeps the batches few, as they are split on changing the blend mode or running out of texture slots.
+		// Sprites with the same key stay in the order they were submitted.
+		//
+		// The keys are radix sorted, a pass for each byte, skipping the bytes which are the same for all keys,
+		// e.g. with only one shader and blend mode.
+		//
+		class RenderQueue2D {
+		public:
+
+			struct Item {
+
+				uint64_t m_Key;
+				uint32_t m_Sprite; // Index in the submitted sprites.
+			};
+
+
+			// The batch renderer has only its one shader, with id 0.
+			static uint64_t makeSortKey(RenderLayer layer, BlendMode blend, uint32_t shader, const ComponentTexture2D* texture, float depth);
+
+			static BlendMode getBlendMode(uint64_t key) { return (BlendMode)((key >> 52) & 0xF); }
+
+
+			void submit(const SpriteInstance& sprite, RenderLayer layer, BlendMode blend = BlendMode::Alpha);
+
+
+			// Sort the submitted sprites by theyre keys, see "getSortedSprites".
+			void sort();
+
+
+			// After "sort", the sprites in order and theyre keys.
+			const std::vector<SpriteInstance>& getSortedSprites() const { return m_SortedSprites; }
+			const std::vector<Item>& getItems() const { return m_Items; }
+
+
+			size_t size() const { return m_Items.size(); }
+			bool empty() const { return m_Items.empty(); }
+
+			// Keeps the memory for the next frame.
+			void clear();
+
+
+		private:
+
+			std::vector<SpriteInstance> m_Sprites;
+			std::vector<SpriteInstance> m_SortedSprites;
+
+			std::vector<Item> m_Items;
+			std::vector<Item> m_ScratchItems;
+		};
+
+
+
+
+
+		// What the batch renderer did in one scene, that is one frame of the application.
+		//
+		// A batch is split when it is full of quads or all texture slots are used,
+		// many splits of a scene are a hint to sort the draws or pack textures into atlases.
+		//
+		struct BatchRenderer2DStats {
+
+			uint32_t m_Batches = 0; // Batches drawn, one draw call each.
+			uint32_t m_Quads = 0; // Quads drawn over all batches.
+
+			uint32_t m_QuadCapacityFlushes = 0; // Batches split as they were full of quads.
+			uint32_t m_TextureSlotOverflows = 0; // Batches split as all texture slots were used.
+			uint32_t m_BlendModeChanges = 0; // Batches split as the blend mode changed.
+
+			uint32_t m_QueuedSprites = 0; // Sprites drawn sorted, see "BatchRenderer2D::submit".
+		};
+
+
+
+
+
 		// Holding data needed for seemless batch rendering,
 		// likewise here can be defined some stats for rendering,
 		// like max. count of vertices or textures etc.
@@ -177,25 +565,17 @@ namespace nautilus {
 
 
 
-			// The array for this scene/batch.
-			QuadVertexArray* m_BatchVertexArray;
-
+			// Where the batches go, see "BatchRenderer2D::setBackend".
+			IRenderBackend2D* m_Backend = nullptr;
 
 
-			// The actuall batch vertex buffer.
-			// Is for setting the data, and flushing.
-			QuadVertexBuffer* m_BatchVertexBuffer;
+			// Counted from "beginScene" on.
+			BatchRenderer2DStats m_Stats;
 
 
-
-			// We need a pointer to a batch shader.
-			// The shader is for all elements rendered the same...
-			//
-			// For this we can take ComponentShader
-			// as it has all functionality we need...
-			//
-			// ComponentShader* m_BatchShader; // This shader will be bound on each draw call.
-			static nautilus::graphics::ComponentShader* m_BatchShader;
+			// Sprites drawn on "endScene", and the blend mode of the current batch.
+			RenderQueue2D m_Queue;
+			BlendMode m_BlendMode = BlendMode::Alpha;
 
 
 
@@ -204,9 +584,7 @@ namespace nautilus {
 			// For the texture we can take ComponentTexture2D,
 			// as it has all data and members needed.
 			//
-			// 
-			// ComponentTexture2D* m_WhiteTexture; // Texture for binding as default.
-			nautilus::graphics::ComponentTexture2D* m_WhiteTexture;
+			// The first slot has the default texture of the backend.
 			std::array<nautilus::graphics::ComponentTexture2D*, 32> m_TextureSlots;
 			int m_TextureSlotIndex = 1; // First ( = 0 ) is the default white texture.
 									// Here we keep count of currently set textures for drawing.
@@ -220,8 +598,10 @@ namespace nautilus {
 			// Compute the bytes between first and last vertex.
 			(uint_8*)m_QuadVertexEnd - (uint_8*)m_QuadVertexBegin
 
-			// better cast it to what the function "setBufferData" takes as size input.
+			// better cast it to what the function "unmapVertices" takes as size input.
 			and cast this to (uint_32).
+
+			The vertices belong to the backend, see "IRenderBackend2D::mapVertices".
 			*/
 			QuadVertex* m_QuadVertexBegin = nullptr; // First vertex.
 			QuadVertex* m_QuadVertexEnd = nullptr; // Last vertex.
@@ -260,22 +640,56 @@ namespace nautilus {
 			static void shutDown(); // Destroy buffers and deallocate all data.
 
 
+			// Where the batches are drawn, must be set before "init".
+			// Without, OpenGL is used. The backend is not owned, it must live until "shutDown".
+			//
+			// E.g. a "RecordingRenderBackend2D" runs all of the batching without a GPU.
+			static void setBackend(IRenderBackend2D* backend);
+			static IRenderBackend2D* getBackend();
+
+
 			// Functions must be called on begin of each "scene",
 			// means before we call draw functions, we call beginScene, and as we are done,
 			// we call endScene.
 			static void beginScene(glm::mat4 view_projection); // Function needed to be called on starting drawing a batch.
 									  // Bind the batches shader and set uniform, start batch.
 
-			static void endScene(); // Flushes the batch data, means, make a draw call and draw everything currently in batch buffer.
+			static void endScene(); // Draws the submitted sprites, then flushes the batch data, means, make a draw call and draw everything currently in batch buffer.
 
 
 			// To draw, we only need to set the transform of the model,
 			// which is translated, rotated and scaled...
 			// Furthermore the actual texture for setting it in the appropriate slot.
 			// And a color, if we want to...
+			//
+			// There is no limit on how many quads a scene draws, a full batch is drawn and a new one started.
 			static void draw(ComponentMemoryProtocol2D* memoryProtocol, glm::mat4 model_transform, nautilus::graphics::ComponentTexture2D* texture, glm::vec4 color = glm::vec4(1.0f));
 
 
+			// Draw many sprites at once.
+			//
+			// Much cheaper per quad than "draw": There is no matrix, the corners are computed
+			// from the 2D transform of the sprite with SIMD and written straight into the batch.
+			// Sprites after one another with the same texture skip looking for the texture slot.
+			static void drawSprites(const SpriteInstance* sprites, size_t count);
+
+			static void drawSprites(const std::vector<SpriteInstance>& sprites) { drawSprites(sprites.data(), sprites.size()); }
+
+
+			// Queue a sprite, drawn sorted by layer, blend mode, texture and depth on "endScene",
+			// after everything drawn directly with "draw" and "drawSprites". See "RenderQueue2D".
+			static void submit(const SpriteInstance& sprite, RenderLayer layer, BlendMode blend = BlendMode::Alpha);
+
+
+			// Blend mode of the following draws, a change draws the current batch.
+			// Each scene starts with "BlendMode::Alpha".
+			static void setBlendMode(BlendMode mode);
+
+
+			// Stats of the current scene, complete after "endScene" until the next "beginScene".
+			static const BatchRenderer2DStats& getStats();
+
+
 		private:
 
 
@@ -289,6 +703,15 @@ namespace nautilus {
 
 			static void _flush(); // Actually sending draw data to GPU. Draw everything currently in buffer.
 
+
+			static float _getTextureIndex(nautilus::graphics::ComponentTexture2D* texture); // Slot of the texture in the current batch, which is set if needed.
+																					   // Starts a new batch if all slots are used.
+
+			static void _writeSprite(const SpriteInstance& sprite, float textureIndex); // Write the 4 vertices of the sprite at the end of the batch.
+
+
+			static void _drawQueue(); // Sort the submitted sprites and draw them, in runs of the same blend mode.
+
 		};
 
 
@@ -177,6 +177,11 @@ namespace nautilus{
 		entt::entity CScene::createEntity(std::string tag) {
 
 
+			// Already there, e.g. added again after a sprite was created.
+			auto existing = m_SceneEntities.find(tag);
+			if (existing != m_SceneEntities.end()) return *existing->second;
+
+
 			// Create entity.
 			entt::entity handle = m_EnttRegistry->getRegistry().create(); // Make entt handle..
 
@@ -196,10 +201,21 @@ namespace nautilus{
 
 
 
-		// Not implemented.
+		// Remove the entity with all its components and free its texture.
 		void CScene::destroyEntity(std::string tag) {
 
+			auto it = m_SceneEntities.find(tag);
+			if (it == m_SceneEntities.end()) return;
+
+
+			entt::registry& registry = m_EnttRegistry->getRegistry();
+			entt::entity handle = *it->second;
+
+			// Entt does not know about the texture, so we free it before the component goes.
+			if (registry.has<ComponentTexture2D>(handle)) registry.get<ComponentTexture2D>(handle).Release();
 
+			registry.destroy(handle);
+			m_SceneEntities.erase(it);
 		}
 
 
@@ -396,12 +412,10 @@ namespace nautilus{
 
 		bool CSceneManager::populateActiveScene(std::string tag, std::string texturename) {
 
-			CSprite* sprite = nullptr; sprite = new CSprite(m_ActiveScene.get(), tag);
+			// The scene keeps the entity, the sprite is only needed to set it up.
+			CSprite sprite(m_ActiveScene.get(), tag);
 
-
-			if (!sprite) return false;
-
-			return sprite->init(texturename);
+			return sprite.init(texturename);
 		}
 
 
@@ -1562,6 +1576,9 @@ namespace nautilus{
 
 			auto& pool = getComponent< ComponentParticlePool >();
 
+			ComponentMemoryProtocol2D* memoryProtocol = &this->getComponent<ComponentMemoryProtocol2D>();
+			ComponentTexture2D* texture = &this->getComponent<ComponentTexture2D>();
+
 
 			// Update the data of ctive particles and set them to be drawn.
 			for (ComponentParticle& particle : pool.m_ParticlePool) {
@@ -1596,16 +1613,18 @@ namespace nautilus{
 				float size = common_lerp(particle.ParticleSizeEnd, particle.ParticleSizeStart, life);
 
 
-				// Compute model transform and other data...
-				glm::mat4 model_transform = glm::translate(glm::mat4(1.0f), glm::vec3(particle.ParticlePosition, 1.0f));
-				model_transform *= glm::rotate(glm::mat4(1.0f), particle.ParticleRotation, glm::vec3(0.0f, 0.0f, 1.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(size, size, 1.0f));
-
-				ComponentMemoryProtocol2D* memoryProtocol = &this->getComponent<ComponentMemoryProtocol2D>();
-				ComponentTexture2D* texture = &this->getComponent<ComponentTexture2D>();
+				// Transform and other data...
+				SpriteInstance sprite;
+				sprite.m_Position = particle.ParticlePosition;
+				sprite.m_Scale = glm::vec2(size, size);
+				sprite.m_Rotation = particle.ParticleRotation;
+				sprite.m_Color = color;
+				sprite.m_Texture = texture;
+				sprite.setTextureCoords(*memoryProtocol);
 
 
 				// Call renderer here...
-				BatchRenderer2D::draw(memoryProtocol, model_transform, texture, color);
+				BatchRenderer2D::submit(sprite, m_Layer, m_BlendMode);
 			}
 
 
@@ -119,16 +119,20 @@ namespace nautilus {
 			//
 			// m_pEntity = new CEntity(	entityHandle );
 			//
+			// A tag can only be once in the scene, for a tag already there
+			// the existing entity is returned and nothing is created.
+			//
 			entt::entity createEntity(std::string tag);
 
+			// Remove the entity with all its components and free its texture.
+			//
 			// The function could be dangerous, 
 			// as we free memory in runtime and another object
 			// maybe tries to access it and thus accesses a nullptr...
 			//
-			//
-			// For now we leave this function as not implemented.
-			// Later, we will let the engine/scenemanager free the memory
-			// of the entity on the end of an update loop...
+			// So do not call it while the scene is drawn, e.g. from a scene function,
+			// the batch renderer points to the components until "endScene".
+			// From "onUpdate" it is safe.
 			//
 			void destroyEntity(std::string tag);
 
@@ -368,6 +372,12 @@ namespace nautilus {
 				return m_ActiveScene->getEntity(entity);
 			}
 
+			// See "CScene::destroyEntity".
+			void destroySceneEntity(std::string entity) {
+
+				m_ActiveScene->destroyEntity(entity);
+			}
+
 
 
 			// Function for registering a scene function.
@@ -658,11 +668,17 @@ namespace nautilus {
 			// Here we specify the data of active particles based on the lifetime and
 			// the elapsed time.
 			//
-			// Further we call the Renderer::Draw() function here to draw the particles,
-			// so user can choose here the drawing "layer".
+			// Further we submit the particles to the renderer here,
+			// drawn on the layer and with the blend mode set below.
 			void onRender(float dt);
 
 
+			// Layer the particles are drawn on, "RenderLayer::Effects" by default.
+			// Additive blending makes e.g. fire and engine flames glow.
+			void setLayer(RenderLayer layer) { m_Layer = layer; }
+			void setBlendMode(BlendMode mode) { m_BlendMode = mode; }
+
+
 			// Resizing particle pool.
 			//
 			// This involves destroying all Particles current in the pool and
@@ -679,6 +695,10 @@ namespace nautilus {
 			//std::vector<Particle> m_ParticlePool;
 			//int m_CurrentParticleIndex = 0;
 
+
+			RenderLayer m_Layer = RenderLayer::Effects;
+			BlendMode m_BlendMode = BlendMode::Alpha;
+
 		private:
 
 		};
@@ -67,6 +67,11 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <array>
+#include <atomic>
+#include <type_traits>
+#include <map>
+#include <random>
 
 #ifdef _WIN32
 #ifndef _WIN32_WINNT
@@ -173,6 +178,304 @@ namespace olc
 		};
 
 
+		// Reads a message body front to back, in the order the data was pushed. Unlike
+		// operator >> on the message itself, the body is left untouched, so nothing is
+		// moved or resized while reading. Reading past the end of the body does not
+		// touch the target and marks the reader as failed, check good() when done.
+		template <typename T>
+		class message_reader
+		{
+		public:
+			message_reader(const message<T>& msg) : m_msg(msg)
+			{}
+
+			// Pulls any POD-like data from the current read position
+			template<typename DataType>
+			friend message_reader<T>& operator >> (message_reader<T>& reader, DataType& data)
+			{
+				static_assert(std::is_standard_layout<DataType>::value, "Data is too complex to be pulled from vector");
+
+				if (reader.m_nCursor + sizeof(DataType) > reader.m_msg.body.size())
+				{
+					reader.m_bGood = false;
+					return reader;
+				}
+
+				std::memcpy(&data, reader.m_msg.body.data() + reader.m_nCursor, sizeof(DataType));
+				reader.m_nCursor += sizeof(DataType);
+				return reader;
+			}
+
+			// Bytes left to be read
+			size_t remaining() const
+			{
+				return m_msg.body.size() - m_nCursor;
+			}
+
+			// False if an attempt was made to read past the end of the body
+			bool good() const
+			{
+				return m_bGood;
+			}
+
+		private:
+			const message<T>& m_msg;
+			size_t m_nCursor = 0;
+			bool m_bGood = true;
+		};
+
+
+		// Appends values of any bit width, up to 32 bits, to a message body. Bits are
+		// collected in a scratch word and only whole bytes go into the body, so call
+		// flush() (or let the writer go out of scope) before the message is sent.
+		template <typename T>
+		class bit_writer
+		{
+		public:
+			bit_writer(message<T>& msg) : m_msg(msg)
+			{}
+
+			~bit_writer()
+			{
+				flush();
+			}
+
+			// Writes the lowest nBits of the value
+			void write(uint32_t nValue, uint32_t nBits)
+			{
+				uint64_t nMask = (nBits >= 32) ? 0xFFFFFFFFull : ((1ull << nBits) - 1);
+				m_nScratch |= (uint64_t(nValue) & nMask) << m_nScratchBits;
+				m_nScratchBits += nBits;
+
+				while (m_nScratchBits >= 8)
+				{
+					m_msg.body.push_back(uint8_t(m_nScratch));
+					m_nScratch >>= 8;
+					m_nScratchBits -= 8;
+				}
+			}
+
+			void write_bool(bool bValue)
+			{
+				write(bValue ? 1 : 0, 1);
+			}
+
+			// Floats are written unchanged, quantize them first where precision can be lost
+			void write_float(float fValue)
+			{
+				uint32_t nBits = 0;
+				std::memcpy(&nBits, &fValue, sizeof(float));
+				write(nBits, 32);
+			}
+
+			// Pads the last byte with zeros and updates the message size
+			void flush()
+			{
+				if (m_nScratchBits > 0)
+				{
+					m_msg.body.push_back(uint8_t(m_nScratch));
+					m_nScratch = 0;
+					m_nScratchBits = 0;
+				}
+
+				m_msg.header.size = m_msg.size();
+			}
+
+		private:
+			message<T>& m_msg;
+			uint64_t m_nScratch = 0;
+			uint32_t m_nScratchBits = 0;
+		};
+
+		// Reads values written by a bit_writer, in the same order and with the same
+		// widths. Reading past the end of the body returns zero and marks the reader as
+		// failed, check good() when done.
+		template <typename T>
+		class bit_reader
+		{
+		public:
+			bit_reader(const message<T>& msg) : m_msg(msg)
+			{}
+
+			uint32_t read(uint32_t nBits)
+			{
+				while (m_nScratchBits < nBits)
+				{
+					if (m_nCursor >= m_msg.body.size())
+					{
+						m_bGood = false;
+						return 0;
+					}
+
+					m_nScratch |= uint64_t(m_msg.body[m_nCursor++]) << m_nScratchBits;
+					m_nScratchBits += 8;
+				}
+
+				uint64_t nMask = (nBits >= 32) ? 0xFFFFFFFFull : ((1ull << nBits) - 1);
+				uint32_t nValue = uint32_t(m_nScratch & nMask);
+				m_nScratch >>= nBits;
+				m_nScratchBits -= nBits;
+				return nValue;
+			}
+
+			bool read_bool()
+			{
+				return read(1) != 0;
+			}
+
+			float read_float()
+			{
+				uint32_t nBits = read(32);
+				float fValue = 0.0f;
+				std::memcpy(&fValue, &nBits, sizeof(float));
+				return fValue;
+			}
+
+			// False if an attempt was made to read past the end of the body
+			bool good() const
+			{
+				return m_bGood;
+			}
+
+		private:
+			const message<T>& m_msg;
+			size_t m_nCursor = 0;
+			uint64_t m_nScratch = 0;
+			uint32_t m_nScratchBits = 0;
+			bool m_bGood = true;
+		};
+
+
+		// Keeps a supply of messages with preallocated bodies. A message taken with
+		// acquire() can be filled without the body vector allocating (as long as it
+		// stays within the capacity), and once it has been sent or processed, release()
+		// hands it back with its capacity intact to be used again. In steady state no
+		// message causes a heap allocation. Thread safe, as messages are acquired on 
+		// the asio thread and released on the game thread and vice versa.
+		template <typename T>
+		class message_pool
+		{
+		public:
+			message_pool(size_t nBodyCapacity = 256, size_t nMaxFree = 1024)
+				: m_nBodyCapacity(nBodyCapacity), m_nMaxFree(nMaxFree)
+			{
+				m_vecFree.reserve(m_nMaxFree);
+			}
+
+			message_pool(const message_pool<T>&) = delete;
+
+			// Returns an empty message with the given id
+			message<T> acquire(T id = T{})
+			{
+				message<T> msg;
+				{
+					std::scoped_lock lock(m_muxFree);
+					if (!m_vecFree.empty())
+					{
+						msg = std::move(m_vecFree.back());
+						m_vecFree.pop_back();
+					}
+				}
+
+				// Only happens while the pool warms up
+				if (msg.body.capacity() == 0)
+					msg.body.reserve(m_nBodyCapacity);
+
+				msg.header.id = id;
+				return msg;
+			}
+
+			// Hands a message back, its content is discarded
+			void release(message<T>&& msg)
+			{
+				if (msg.body.capacity() == 0)
+					return;
+
+				msg.header = {};
+				msg.body.clear();
+
+				std::scoped_lock lock(m_muxFree);
+				if (m_vecFree.size() < m_nMaxFree)
+					m_vecFree.push_back(std::move(msg));
+			}
+
+		private:
+			std::mutex m_muxFree;
+			std::vector<message<T>> m_vecFree;
+			size_t m_nBodyCapacity = 0;
+			size_t m_nMaxFree = 0;
+		};
+
+
+		// A message serialized once into an immutable, reference counted buffer which
+		// holds the header followed by the body, exactly as it goes over the wire. 
+		// Broadcasting it hands the same buffer to every connection, instead of copying
+		// the message into each outgoing queue.
+		template <typename T>
+		using shared_message = std::shared_ptr<const std::vector<uint8_t>>;
+
+		template <typename T>
+		shared_message<T> make_shared_message(const message<T>& msg)
+		{
+			auto bytes = std::make_shared<std::vector<uint8_t>>(sizeof(message_header<T>) + msg.body.size());
+			std::memcpy(bytes->data(), &msg.header, sizeof(message_header<T>));
+			if (!msg.body.empty())
+				std::memcpy(bytes->data() + sizeof(message_header<T>), msg.body.data(), msg.body.size());
+
+			return bytes;
+		}
+
+
+		// Traffic a connection has seen so far, stream and datagrams together.
+		// Bytes are counted as they go over the wire, including headers
+		struct connection_stats
+		{
+			uint64_t nBytesIn = 0;
+			uint64_t nBytesOut = 0;
+			uint64_t nMessagesIn = 0;
+			uint64_t nMessagesOut = 0;
+
+			// Messages and bytes waiting to be written to the stream
+			uint64_t nQueuedMessages = 0;
+			uint64_t nQueuedBytes = 0;
+		};
+
+		// Per connection control over batching and the TCP socket
+		struct connection_options
+		{
+			// Disable Nagle's algorithm. Messages are batched by the connection
+			// itself, so there is no need to let the socket wait for more data
+			bool bNoDelay = true;
+
+			// Socket buffer sizes in bytes, 0 keeps the system default
+			int nSendBufferSize = 0;
+			int nReceiveBufferSize = 0;
+
+			// If set, sent messages are only handed to the asio thread by Flush(), 
+			// so everything sent during a frame or tick goes out together. Otherwise
+			// they are picked up as soon as the asio thread gets to them
+			bool bManualFlush = false;
+
+			// Limits of the messages waiting to be written to the stream, 0 is
+			// unlimited. A remote side not reading fast enough makes the queue grow,
+			// beyond either limit the connection is closed rather than using up
+			// memory. Messages sent with SendState() replace their older copies
+			// instead of adding up, so only the other ones count towards the limit
+			size_t nMaxQueuedMessages = 0;
+			size_t nMaxQueuedBytes = 0;
+
+			// Largest body of a message read from the stream, 0 is unlimited. The size
+			// is checked on the header, before anything is allocated for the body, and
+			// a larger one closes the connection. So whoever passes the handshake can
+			// not make us allocate more than a message may be
+			uint32_t nMaxMessageSize = 1 << 24;
+
+			// If not empty, the largest body for each message id, checked the same way.
+			// An id past the end of the table closes the connection too
+			std::vector<uint32_t> vecMaxMessageSizes;
+		};
+
+
 		// An "owned" message is identical to a regular message, but it is associated with
 		// a connection. On a server, the owner would be the client that sent the message, 
 		// on a client the owner would be the server.
@@ -195,8 +498,77 @@ namespace olc
 			}
 		};		
 
+
+		// Datagram
+
+		// Besides the TCP stream, a connection can optionally exchange messages as UDP
+		// datagrams. These are unreliable and unordered, so they are only meant for 
+		// high frequency state where only the newest value matters. Each datagram
+		// holds one or more messages, prefixed with a token identifying the connection
+		// and a sequence number, so the receiver can drop datagrams older than the
+		// newest one it has already seen:
+		//
+		// [uint64_t token][uint32_t sequence]([message_header<T>][body])...
+		//
+		// Messages sent as datagrams in the same flush share one datagram, as long
+		// as it stays below datagram_batch_size.
+		//
+		// Sequence number 0 is reserved for the "hello" datagram, which carries no 
+		// message and only tells the server on which endpoint the client listens.
+		constexpr size_t datagram_prefix_size = sizeof(uint64_t) + sizeof(uint32_t);
+		constexpr size_t datagram_max_size = 65507;
+
+		// Datagrams are only filled up to a size which is not fragmented on usual
+		// networks, a message larger than that is sent in a datagram of its own
+		constexpr size_t datagram_batch_size = 1200;
+		constexpr size_t datagram_batch_messages = 16;
+
+		// The message header and body are sent straight from the message, only the
+		// prefix needs a buffer of its own
+		inline void WriteDatagramPrefix(uint8_t* prefix, uint64_t token, uint32_t sequence)
+		{
+			std::memcpy(prefix, &token, sizeof(uint64_t));
+			std::memcpy(prefix + sizeof(uint64_t), &sequence, sizeof(uint32_t));
+		}
+
+		// Returns false if the datagram is too short, in which case it must be dropped
+		inline bool ReadDatagramPrefix(const uint8_t* data, size_t length, uint64_t& token, uint32_t& sequence)
+		{
+			if (length < datagram_prefix_size)
+				return false;
+
+			std::memcpy(&token, data, sizeof(uint64_t)); data += sizeof(uint64_t);
+			std::memcpy(&sequence, data, sizeof(uint32_t));
+			return true;
+		}
+
+		// Read the message at "offset" and move the offset past it. Returns false at
+		// the end of the datagram, or if the rest of the datagram is malformed
+		template <typename T>
+		bool ReadDatagramMessage(const uint8_t* data, size_t length, size_t& offset, message<T>& msg)
+		{
+			if (length < offset + sizeof(message_header<T>))
+				return false;
+
+			std::memcpy(&msg.header, data + offset, sizeof(message_header<T>));
+
+			// The header must not describe more than is left of the datagram
+			size_t nBody = length - offset - sizeof(message_header<T>);
+			if (msg.header.size > nBody)
+				return false;
+
+			const uint8_t* body = data + offset + sizeof(message_header<T>);
+			msg.body.assign(body, body + msg.header.size);
+			offset += sizeof(message_header<T>) + msg.header.size;
+			return true;
+		}
+
 		
 		// Queue
+
+		// Items are kept in a ring buffer, which only grows when it is full. Unlike a
+		// std::deque, pushing and popping does not allocate once the queue has grown
+		// to the size it needs.
 		template<typename T>
 		class tsqueue
 		{
@@ -210,22 +582,23 @@ namespace olc
 			const T& front()
 			{
 				std::scoped_lock lock(muxQueue);
-				return deqQueue.front();
+				return vecRing[nHead];
 			}
 
 			// Returns and maintains item at back of Queue
 			const T& back()
 			{
 				std::scoped_lock lock(muxQueue);
-				return deqQueue.back();
+				return vecRing[(nHead + nCount - 1) % vecRing.size()];
 			}
 
 			// Removes and returns item from front of Queue
 			T pop_front()
 			{
 				std::scoped_lock lock(muxQueue);
-				auto t = std::move(deqQueue.front());
-				deqQueue.pop_front();
+				auto t = std::move(vecRing[nHead]);
+				nHead = (nHead + 1) % vecRing.size();
+				nCount--;
 				return t;
 			}
 
@@ -233,16 +606,24 @@ namespace olc
 			T pop_back()
 			{
 				std::scoped_lock lock(muxQueue);
-				auto t = std::move(deqQueue.back());
-				deqQueue.pop_back();
+				auto t = std::move(vecRing[(nHead + nCount - 1) % vecRing.size()]);
+				nCount--;
 				return t;
 			}
 
 			// Adds an item to back of Queue
 			void push_back(const T& item)
+			{
+				push_back(T(item));
+			}
+
+			// Moves an item to back of Queue
+			void push_back(T&& item)
 			{
 				std::scoped_lock lock(muxQueue);
-				deqQueue.emplace_back(std::move(item));
+				grow();
+				vecRing[(nHead + nCount) % vecRing.size()] = std::move(item);
+				nCount++;
 
 				std::unique_lock<std::mutex> ul(muxBlocking);
 				cvBlocking.notify_one();
@@ -252,7 +633,10 @@ namespace olc
 			void push_front(const T& item)
 			{
 				std::scoped_lock lock(muxQueue);
-				deqQueue.emplace_front(std::move(item));
+				grow();
+				nHead = (nHead + vecRing.size() - 1) % vecRing.size();
+				vecRing[nHead] = item;
+				nCount++;
 
 				std::unique_lock<std::mutex> ul(muxBlocking);
 				cvBlocking.notify_one();
@@ -262,21 +646,24 @@ namespace olc
 			bool empty()
 			{
 				std::scoped_lock lock(muxQueue);
-				return deqQueue.empty();
+				return nCount == 0;
 			}
 
 			// Returns number of items in Queue
 			size_t count()
 			{
 				std::scoped_lock lock(muxQueue);
-				return deqQueue.size();
+				return nCount;
 			}
 
 			// Clears Queue
 			void clear()
 			{
 				std::scoped_lock lock(muxQueue);
-				deqQueue.clear();
+				for (size_t i = 0; i < nCount; i++)
+					vecRing[(nHead + i) % vecRing.size()] = T();
+				nHead = 0;
+				nCount = 0;
 			}
 
 			void wait()
@@ -288,12 +675,334 @@ namespace olc
 				}
 			}
 
+		private:
+			// Called with muxQueue held - make room for one more item, unrolling
+			// the ring into a buffer twice the size if it is full
+			void grow()
+			{
+				if (nCount < vecRing.size())
+					return;
+
+				std::vector<T> vecNew(std::max<size_t>(16, vecRing.size() * 2));
+				for (size_t i = 0; i < nCount; i++)
+					vecNew[i] = std::move(vecRing[(nHead + i) % vecRing.size()]);
+
+				vecRing.swap(vecNew);
+				nHead = 0;
+			}
+
 		protected:
 			std::mutex muxQueue;
-			std::deque<T> deqQueue;
+			std::vector<T> vecRing;
+			size_t nHead = 0;
+			size_t nCount = 0;
 			std::condition_variable cvBlocking;
 			std::mutex muxBlocking;
 		};
+
+
+		// Incoming messages are pushed by the asio threads and popped by the one thread
+		// calling Update(), so the queue is made for many producers and one consumer.
+		// It is a ring of fixed size where each slot carries a sequence number telling
+		// whether it is free or holds an item (D. Vyukov's bounded queue). Pushing and
+		// popping take no lock, a producer only competes with other producers for the
+		// tail. drain() moves out all pending items at once.
+		//
+		// When the ring is full the producer yields until the consumer made room,
+		// which stops that asio thread from reading more until the game catches up.
+		template<typename T>
+		class mpsc_queue
+		{
+		public:
+			// The capacity is rounded up to a power of two
+			explicit mpsc_queue(size_t nCapacity = 16384)
+				: vecSlots(RoundCapacity(nCapacity)), nMask(vecSlots.size() - 1)
+			{
+				for (size_t i = 0; i < vecSlots.size(); i++)
+					vecSlots[i].nSequence.store(i, std::memory_order_relaxed);
+			}
+
+			mpsc_queue(const mpsc_queue<T>&) = delete;
+
+		public:
+			// Any thread - moves the item in, unless the queue is full
+			bool try_push(T&& item)
+			{
+				size_t nPos = nTail.load(std::memory_order_relaxed);
+				slot* pSlot = nullptr;
+
+				for (;;)
+				{
+					pSlot = &vecSlots[nPos & nMask];
+					size_t nSequence = pSlot->nSequence.load(std::memory_order_acquire);
+					intptr_t nDiff = (intptr_t)nSequence - (intptr_t)nPos;
+
+					if (nDiff == 0)
+					{
+						// The slot is free, claim it
+						if (nTail.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (nDiff < 0)
+					{
+						// The slot still holds the item of the previous round
+						return false;
+					}
+					else
+					{
+						// Another producer claimed it first
+						nPos = nTail.load(std::memory_order_relaxed);
+					}
+				}
+
+				pSlot->item = std::move(item);
+				pSlot->nSequence.store(nPos + 1, std::memory_order_release);
+
+				// Wake the consumer if it is in wait(). The fence orders the item before
+				// reading the flag, as wait() sets the flag before looking for items
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (bWaiting.load(std::memory_order_relaxed))
+				{
+					std::unique_lock<std::mutex> ul(muxBlocking);
+					cvBlocking.notify_one();
+				}
+
+				return true;
+			}
+
+			// Any thread - moves the item in, waits while the queue is full
+			void push_back(T&& item)
+			{
+				while (!try_push(std::move(item)))
+					std::this_thread::yield();
+			}
+
+			void push_back(const T& item)
+			{
+				push_back(T(item));
+			}
+
+			// Consumer only - moves the front item out, returns false if there is none
+			bool try_pop(T& item)
+			{
+				slot& s = vecSlots[nHead & nMask];
+				if (s.nSequence.load(std::memory_order_acquire) != nHead + 1)
+					return false;
+
+				item = std::move(s.item);
+				s.nSequence.store(nHead + nMask + 1, std::memory_order_release);
+				nHead++;
+				return true;
+			}
+
+			// Consumer only - removes and returns the front item, check empty() first
+			T pop_front()
+			{
+				T item;
+				try_pop(item);
+				return item;
+			}
+
+			// Consumer only - moves up to nMaxItems pending items to the back of vecOut,
+			// returns how many. vecOut keeps its capacity between calls, so this does
+			// not allocate once it has grown
+			size_t drain(std::vector<T>& vecOut, size_t nMaxItems = -1)
+			{
+				size_t nCount = 0;
+				while (nCount < nMaxItems)
+				{
+					slot& s = vecSlots[nHead & nMask];
+					if (s.nSequence.load(std::memory_order_acquire) != nHead + 1)
+						break;
+
+					vecOut.push_back(std::move(s.item));
+					s.nSequence.store(nHead + nMask + 1, std::memory_order_release);
+					nHead++;
+					nCount++;
+				}
+				return nCount;
+			}
+
+			// Consumer only
+			bool empty() const
+			{
+				return vecSlots[nHead & nMask].nSequence.load(std::memory_order_acquire) != nHead + 1;
+			}
+
+			// Consumer only - items pushed, including ones still being moved in
+			size_t count() const
+			{
+				return nTail.load(std::memory_order_relaxed) - nHead;
+			}
+
+			size_t capacity() const
+			{
+				return vecSlots.size();
+			}
+
+			// Consumer only
+			void clear()
+			{
+				T item;
+				while (try_pop(item))
+					item = T();
+			}
+
+			// Consumer only - blocks until there is an item
+			void wait()
+			{
+				std::unique_lock<std::mutex> ul(muxBlocking);
+				bWaiting.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				while (empty())
+					cvBlocking.wait(ul);
+
+				bWaiting.store(false, std::memory_order_relaxed);
+			}
+
+		protected:
+			struct slot
+			{
+				std::atomic<size_t> nSequence{ 0 };
+				T item{};
+			};
+
+			static size_t RoundCapacity(size_t nCapacity)
+			{
+				size_t nSize = 2;
+				while (nSize < nCapacity) nSize *= 2;
+				return nSize;
+			}
+
+			std::vector<slot> vecSlots;
+			size_t nMask = 0;
+
+			// Producers and consumer work on different ends, each on its own cache line
+			alignas(64) std::atomic<size_t> nTail{ 0 };
+			alignas(64) size_t nHead = 0;
+
+			alignas(64) std::atomic<bool> bWaiting{ false };
+			std::mutex muxBlocking;
+			std::condition_variable cvBlocking;
+		};
+
+
+		// Handler memory
+
+		// asio allocates memory for every handler it holds on to. A connection only
+		// ever has one read, one write and one flush outstanding at a time, so each
+		// of them gets a small block of memory of its own, which is reused for the
+		// next handler of the same kind. This follows the asio allocation example.
+		// There are two blocks, as a handler going through a strand needs a second
+		// allocation for the strand to invoke it.
+		class handler_memory
+		{
+		public:
+			handler_memory() = default;
+			handler_memory(const handler_memory&) = delete;
+
+			void* allocate(std::size_t size)
+			{
+				if (size <= sizeof(m_storage[0]))
+				{
+					for (size_t i = 0; i < m_storage.size(); i++)
+						if (!m_bInUse[i].exchange(true))
+							return &m_storage[i];
+				}
+
+				// Too big, or already in use, so go to the heap
+				return ::operator new(size);
+			}
+
+			void deallocate(void* pointer)
+			{
+				for (size_t i = 0; i < m_storage.size(); i++)
+				{
+					if (pointer == &m_storage[i])
+					{
+						m_bInUse[i] = false;
+						return;
+					}
+				}
+
+				::operator delete(pointer);
+			}
+
+		private:
+			std::array<typename std::aligned_storage<1024>::type, 2> m_storage;
+			std::array<std::atomic<bool>, 2> m_bInUse{};
+		};
+
+		template <typename T>
+		class handler_allocator
+		{
+		public:
+			using value_type = T;
+
+			explicit handler_allocator(handler_memory& mem) : m_memory(mem)
+			{}
+
+			template <typename U>
+			handler_allocator(const handler_allocator<U>& other) noexcept : m_memory(other.m_memory)
+			{}
+
+			bool operator==(const handler_allocator& other) const noexcept
+			{
+				return &m_memory == &other.m_memory;
+			}
+
+			bool operator!=(const handler_allocator& other) const noexcept
+			{
+				return &m_memory != &other.m_memory;
+			}
+
+			T* allocate(std::size_t n) const
+			{
+				return static_cast<T*>(m_memory.allocate(sizeof(T) * n));
+			}
+
+			void deallocate(T* p, std::size_t /*n*/) const
+			{
+				return m_memory.deallocate(p);
+			}
+
+		private:
+			template <typename> friend class handler_allocator;
+			handler_memory& m_memory;
+		};
+
+		// Wraps a handler so asio allocates it from the given memory
+		template <typename Handler>
+		class custom_alloc_handler
+		{
+		public:
+			using allocator_type = handler_allocator<Handler>;
+
+			custom_alloc_handler(handler_memory& m, Handler h) : m_memory(m), m_handler(std::move(h))
+			{}
+
+			allocator_type get_allocator() const noexcept
+			{
+				return allocator_type(m_memory);
+			}
+
+			template <typename ...Args>
+			void operator()(Args&&... args)
+			{
+				m_handler(std::forward<Args>(args)...);
+			}
+
+		private:
+			handler_memory& m_memory;
+			Handler m_handler;
+		};
+
+		template <typename Handler>
+		inline custom_alloc_handler<Handler> make_custom_alloc_handler(handler_memory& m, Handler h)
+		{
+			return custom_alloc_handler<Handler>(m, std::move(h));
+		}
 		
 		// Connection
 		// Forward declare
@@ -312,20 +1021,58 @@ namespace olc
 				client
 			};
 
+		protected:
+			// A message waiting to be sent. It is either a pooled message owned by 
+			// the queue or a serialized message shared with other connections
+			struct outgoing_message
+			{
+				message<T> msg;
+				shared_message<T> shared;
+				bool bDatagram = false;
+
+				// Not 0 for a message sent with SendState()
+				uint64_t nStateKey = 0;
+			};
+
+			// A range of buffers in an array, so asio can be given part of an array
+			// without copying the buffers into a container which allocates
+			struct const_buffer_span
+			{
+				const asio::const_buffer* pBegin;
+				const asio::const_buffer* pEnd;
+
+				const asio::const_buffer* begin() const { return pBegin; }
+				const asio::const_buffer* end() const { return pEnd; }
+			};
+
+			// Messages written to the stream at once, asio writes at most 64 buffers
+			// with one call
+			static constexpr size_t write_batch_messages = 32;
+
+		public:
+			// The socket of a connection runs its handlers on a strand. The executor
+			// type is spelled out, as the type erased default executor allocates
+			// whenever asio rebinds it
+			using strand_type = asio::strand<asio::io_context::executor_type>;
+			using socket_type = asio::basic_stream_socket<asio::ip::tcp, strand_type>;
+
 		public:
 			// Constructor: Specify Owner, connect to context, transfer the socket
 			//				Provide reference to incoming message queue
-			connection(owner parent, asio::io_context& asioContext, asio::ip::tcp::socket socket, tsqueue<owned_message<T>>& qIn)
-				: m_asioContext(asioContext), m_socket(std::move(socket)), m_qMessagesIn(qIn)
+			//				Provide the pool messages are taken from and returned to
+			connection(owner parent, asio::io_context& asioContext, socket_type socket, mpsc_queue<owned_message<T>>& qIn, message_pool<T>& pool)
+				: m_asioContext(asioContext), m_socket(std::move(socket)), m_qMessagesIn(qIn), m_msgPool(pool)
 			{
 				m_nOwnerType = parent;
+				m_msgTemporaryIn = m_msgPool.acquire();
 
 				// Construct validation check data
 				if (m_nOwnerType == owner::server)
 				{
 					// Connection is Server -> Client, construct random data for the client
-					// to transform and send back for validation
-					m_nHandshakeOut = uint64_t(std::chrono::system_clock::now().time_since_epoch().count());
+					// to transform and send back for validation. It is the datagram token
+					// too, so it must not be guessable
+					m_nHandshakeOut = RandomToken();
 
 					// Pre-calculate the result for checking when the client responds
 					m_nHandshakeCheck = scramble(m_nHandshakeOut);
@@ -356,6 +1103,9 @@ namespace olc
 					if (m_socket.is_open())
 					{
 						id = uid;
+						m_bOpen = true;
+
+						ApplySocketOptions();
 
 						// Was: ReadHeader();
 
@@ -371,6 +1121,15 @@ namespace olc
 				}
 			}
 
+			// A connection without a remote side, it only has an id. Everything sent to it
+			// is dropped, so recorded messages can be passed to OnMessage() again as if
+			// the client was there
+			void ConnectDetached(uint32_t uid)
+			{
+				id = uid;
+				m_bDetached = true;
+			}
+
 			void ConnectToServer(const asio::ip::tcp::resolver::results_type& endpoints)
 			{
 				// Only clients can connect to servers
@@ -378,10 +1137,13 @@ namespace olc
 				{
 					// Request asio attempts to connect to an endpoint
 					asio::async_connect(m_socket, endpoints,
-						[this](std::error_code ec, asio::ip::tcp::endpoint endpoint)
+						[this, self = this->shared_from_this()](std::error_code ec, asio::ip::tcp::endpoint endpoint)
 						{
 							if (!ec)
 							{
+								m_bOpen = true;
+								ApplySocketOptions();
+
 								// Was: ReadHeader();
 
 								// First thing server will do is send packet to be validated
@@ -393,15 +1155,17 @@ namespace olc
 			}
 
 
+			// Also closes a socket which is still connecting, and closing twice is fine
 			void Disconnect()
 			{
-				if (IsConnected())
-					asio::post(m_asioContext, [this]() { m_socket.close(); });
+				asio::post(m_socket.get_executor(), [this, self = this->shared_from_this()]() { CloseSocket(); });
 			}
 
+			// Read by the game thread while the socket itself is only touched on its
+			// strand, so the state is kept in m_bOpen
 			bool IsConnected() const
 			{
-				return m_socket.is_open();
+				return m_bOpen;
 			}
 
 			// Prime the connection to wait for incoming messages
@@ -412,104 +1176,521 @@ namespace olc
 
 		public:
 			// ASYNC - Send a message, connections are one-to-one so no need to specifiy
-			// the target, for a client, the target is the server and vice versa
+			// the target, for a client, the target is the server and vice versa.
+			// The message is copied into a pooled message, prefer the move overload
 			void Send(const message<T>& msg)
 			{
-				asio::post(m_asioContext,
-					[this, msg]()
+				Send(CopyFromPool(msg));
+			}
+
+			// ASYNC - Send a message, handing it over to the connection. Messages sent
+			// in a burst are collected and passed to the asio thread together, so the 
+			// context is only posted to once per burst rather than per message
+			void Send(message<T>&& msg)
+			{
+				QueuePending({ std::move(msg), nullptr, false });
+			}
+
+			// ASYNC - Send a message as unreliable datagram. If the connection has no
+			// datagram channel, or the remote endpoint is not yet known, the message is
+			// sent reliably via Send() instead.
+			void SendDatagram(const message<T>& msg)
+			{
+				SendDatagram(CopyFromPool(msg));
+			}
+
+			void SendDatagram(message<T>&& msg)
+			{
+				QueuePending({ std::move(msg), nullptr, true });
+			}
+
+			// ASYNC - Send an already serialized message. The buffer is shared, not 
+			// copied, so the same message can be given to many connections
+			void Send(const shared_message<T>& msg)
+			{
+				QueuePending({ message<T>{}, msg, false });
+			}
+
+			void SendDatagram(const shared_message<T>& msg)
+			{
+				QueuePending({ message<T>{}, msg, true });
+			}
+
+			// ASYNC - Send a message carrying the latest state of something, e.g. an
+			// entity or the whole world, which "nStateKey" (not 0) identifies. If a
+			// message with the same key is still waiting to be written, it is outdated
+			// and replaced by this one, keeping its place in the queue. Other messages
+			// are never dropped
+			void SendState(message<T>&& msg, uint64_t nStateKey)
+			{
+				QueuePending({ std::move(msg), nullptr, false, nStateKey });
+			}
+
+			// As SendState(), but as datagram if possible. Datagrams are not queued, so
+			// the key only matters if the message falls back to the stream
+			void SendDatagramState(message<T>&& msg, uint64_t nStateKey)
+			{
+				QueuePending({ std::move(msg), nullptr, true, nStateKey });
+			}
+
+			// Attach a UDP socket used to send datagrams to the remote side. On the
+			// client the remote endpoint is the server, on the server the endpoint is
+			// learned from the first datagram the client sends.
+			// If the socket is shared by connections running on different threads,
+			// "pSocketMutex" guards the sends.
+			void AttachDatagramSocket(asio::ip::udp::socket* socket, const asio::ip::udp::endpoint& remote = {}, std::mutex* pSocketMutex = nullptr)
+			{
+				m_pDatagramSocket = socket;
+				m_pDatagramSocketMutex = pSocketMutex;
+				m_udpRemoteEndpoint = remote;
+
+				if (m_nOwnerType == owner::server)
+				{
+					// Remembered here, as the datagram thread must not touch the stream socket
+					std::error_code ec;
+					m_tcpRemoteAddress = m_socket.remote_endpoint(ec).address();
+				}
+			}
+
+			// Both sides know the handshake data the server generated, so it
+			// identifies the connection for datagrams
+			uint64_t GetDatagramToken() const
+			{
+				return (m_nOwnerType == owner::server) ? m_nHandshakeOut : m_nHandshakeIn;
+			}
+
+			// For testing - drop the given fraction [0, 1] of outgoing datagrams
+			void SetDatagramLoss(float fLoss)
+			{
+				m_fDatagramLoss = fLoss;
+			}
+
+			// Set before the connection is started, on the server e.g. from 
+			// OnClientConnect(), on the client before Connect()
+			void SetOptions(const connection_options& options)
+			{
+				m_options = options;
+			}
+
+			const connection_options& GetOptions() const
+			{
+				return m_options;
+			}
+
+			// With bManualFlush, hand everything sent since the last call to the asio
+			// thread. It goes out as one write on the stream, and as few datagrams as
+			// possible. Without bManualFlush this happens by itself
+			void Flush()
+			{
+				{
+					std::scoped_lock lock(m_muxPendingOut);
+					if (m_bFlushPosted || m_vecPendingOut.empty())
+						return;
+
+					m_bFlushPosted = true;
+				}
+
+				asio::post(m_socket.get_executor(), make_custom_alloc_handler(m_handlerMemoryFlush, [this, self = this->shared_from_this()]() { FlushPending(); }));
+			}
+
+			// Safe to call from any thread
+			connection_stats GetStats() const
+			{
+				connection_stats stats;
+				stats.nBytesIn = m_nBytesIn.load(std::memory_order_relaxed);
+				stats.nBytesOut = m_nBytesOut.load(std::memory_order_relaxed);
+				stats.nMessagesIn = m_nMessagesIn.load(std::memory_order_relaxed);
+				stats.nMessagesOut = m_nMessagesOut.load(std::memory_order_relaxed);
+				stats.nQueuedMessages = m_nQueuedMessagesOut.load(std::memory_order_relaxed);
+				stats.nQueuedBytes = m_nQueuedBytesOut.load(std::memory_order_relaxed);
+				return stats;
+			}
+
+			// Called from the asio thread when a datagram for this connection arrived.
+			// Returns true if its messages are to be passed on with OnDatagram()
+			bool AcceptDatagram(uint32_t sequence, const asio::ip::udp::endpoint& remote)
+			{
+				if (m_nOwnerType == owner::server)
+				{
+					// Only accept datagrams from the host we have the stream connection with
+					if (m_tcpRemoteAddress != remote.address())
+						return false;
+
+					// The endpoint is written once, before the connection's strand
+					// may read it for sending
+					if (!m_bDatagramReady.load(std::memory_order_acquire))
 					{
-						// If the queue has a message in it, then we must 
-						// assume that it is in the process of asynchronously being written.
-						// Either way add the message to the queue to be output. If no messages
-						// were available to be written, then start the process of writing the
-						// message at the front of the queue.
-						bool bWritingMessage = !m_qMessagesOut.empty();
-						m_qMessagesOut.push_back(msg);
-						if (!bWritingMessage)
-						{
-							WriteHeader();
-						}
-					});
+						m_udpRemoteEndpoint = remote;
+						m_bDatagramReady.store(true, std::memory_order_release);
+					}
+				}
+
+				// The "hello" datagram has no message
+				if (sequence == 0)
+					return false;
+
+				// Drop everything not newer than what we already have
+				if (m_nDatagramSequenceIn != 0 && int32_t(sequence - m_nDatagramSequenceIn) <= 0)
+					return false;
+
+				m_nDatagramSequenceIn = sequence;
+				CountIn(datagram_prefix_size, 0);
+				return true;
+			}
+
+			// Called from the asio thread for each message of an accepted datagram
+			void OnDatagram(message<T>&& msg)
+			{
+				CountIn(sizeof(message_header<T>) + msg.body.size());
+
+				if (m_nOwnerType == owner::server)
+					m_qMessagesIn.push_back({ this->shared_from_this(), std::move(msg) });
+				else
+					m_qMessagesIn.push_back({ nullptr, std::move(msg) });
 			}
 
 
 
 		private:
-			// ASYNC - Prime context to write a message header
-			void WriteHeader()
+			// Options which fail to apply leave the socket as it is, the connection
+			// works either way
+			void ApplySocketOptions()
 			{
-				// If this function is called, we know the outgoing message queue must have 
-				// at least one message to send. So allocate a transmission buffer to hold
-				// the message, and issue the work - asio, send these bytes
-				asio::async_write(m_socket, asio::buffer(&m_qMessagesOut.front().header, sizeof(message_header<T>)),
-					[this](std::error_code ec, std::size_t length)
-					{
-						// asio has now sent the bytes - if there was a problem
-						// an error would be available...
-						if (!ec)
-						{
-							// ... no error, so check if the message header just sent also
-							// has a message body...
-							if (m_qMessagesOut.front().body.size() > 0)
-							{
-								// ...it does, so issue the task to write the body bytes
-								WriteBody();
-							}
-							else
-							{
-								// ...it didnt, so we are done with this message. Remove it from 
-								// the outgoing message queue
-								m_qMessagesOut.pop_front();
+				std::error_code ec;
+				m_socket.set_option(asio::ip::tcp::no_delay(m_options.bNoDelay), ec);
 
-								// If the queue is not empty, there are more messages to send, so
-								// make this happen by issuing the task to send the next header.
-								if (!m_qMessagesOut.empty())
-								{
-									WriteHeader();
-								}
-							}
-						}
-						else
+				if (m_options.nSendBufferSize > 0)
+					m_socket.set_option(asio::socket_base::send_buffer_size(m_options.nSendBufferSize), ec);
+
+				if (m_options.nReceiveBufferSize > 0)
+					m_socket.set_option(asio::socket_base::receive_buffer_size(m_options.nReceiveBufferSize), ec);
+			}
+
+			// Only called on the strand of the socket
+			void CloseSocket()
+			{
+				m_bOpen = false;
+				m_socket.close();
+			}
+
+			message<T> CopyFromPool(const message<T>& msg)
+			{
+				message<T> copy = m_msgPool.acquire(msg.header.id);
+				copy.header = msg.header;
+				copy.body.assign(msg.body.begin(), msg.body.end());
+				return copy;
+			}
+
+			// Collect a message to be sent, and if no flush is pending yet, ask the
+			// asio thread to pick up everything collected so far
+			void QueuePending(outgoing_message&& msg)
+			{
+				if (m_bDetached)
+				{
+					m_msgPool.release(std::move(msg.msg));
+					return;
+				}
+
+				{
+					std::scoped_lock lock(m_muxPendingOut);
+					m_vecPendingOut.push_back(std::move(msg));
+
+					if (m_bFlushPosted || m_options.bManualFlush)
+						return;
+
+					m_bFlushPosted = true;
+				}
+
+				asio::post(m_socket.get_executor(), make_custom_alloc_handler(m_handlerMemoryFlush, [this, self = this->shared_from_this()]() { FlushPending(); }));
+			}
+
+			// Runs on the asio thread - move all collected messages into the outgoing
+			// queue, or send them as datagrams straight away
+			void FlushPending()
+			{
+				{
+					std::scoped_lock lock(m_muxPendingOut);
+					m_bFlushPosted = false;
+					std::swap(m_vecPendingOut, m_vecFlushing);
+				}
+
+				// If the queue has a message in it, then we must 
+				// assume that it is in the process of asynchronously being written.
+				// Either way add the messages to the queue to be output. If no messages
+				// were available to be written, then start the process of writing the
+				// message at the front of the queue.
+				bool bWritingMessage = !OutgoingEmpty();
+
+				// Datagrams are collected into as few datagrams as possible
+				size_t nBatchSize = datagram_prefix_size;
+				m_vecDatagramBatch.clear();
+
+				for (auto& pending : m_vecFlushing)
+				{
+					if (pending.bDatagram && m_pDatagramSocket && m_bDatagramReady)
+					{
+						size_t nSize = WireSize(pending);
+						if (!m_vecDatagramBatch.empty() && (nBatchSize + nSize > datagram_batch_size || m_vecDatagramBatch.size() == datagram_batch_messages))
 						{
-							// ...asio failed to write the message, we could analyse why but 
-							// for now simply assume the connection has died by closing the
-							// socket. When a future attempt to write to this client fails due
-							// to the closed socket, it will be tidied up.
-							std::cout << "[" << id << "] Write Header Fail.\n";
-							m_socket.close();
+							WriteDatagramBatch();
+							nBatchSize = datagram_prefix_size;
 						}
-					});
+
+						m_vecDatagramBatch.push_back(&pending);
+						nBatchSize += nSize;
+					}
+					else if (m_socket.is_open() && !ReplaceQueuedState(pending))
+					{
+						m_nQueuedBytes += WireSize(pending);
+						m_vecMessagesOut.push_back(std::move(pending));
+					}
+				}
+
+				if (!m_vecDatagramBatch.empty())
+					WriteDatagramBatch();
+
+				// The messages of the moved entries are empty, so only the datagrams 
+				// go back to the pool here
+				for (auto& pending : m_vecFlushing)
+					m_msgPool.release(std::move(pending.msg));
+
+				m_vecFlushing.clear();
+
+				// The remote side does not keep up, drop it before it takes the memory
+				// of the whole server. Messages being written stay until the write fails
+				CountQueued();
+
+				if (m_socket.is_open() &&
+					((m_options.nMaxQueuedMessages > 0 && QueuedMessages() > m_options.nMaxQueuedMessages) ||
+					(m_options.nMaxQueuedBytes > 0 && m_nQueuedBytes > m_options.nMaxQueuedBytes)))
+				{
+					std::cout << "[" << id << "] Send Queue Limit Exceeded.\n";
+					CloseSocket();
+					return;
+				}
+
+				if (!bWritingMessage && !OutgoingEmpty())
+				{
+					WriteMessage();
+				}
+			}
+
+			// Replace the queued message of the same state as "pending" which is not
+			// being written yet. Returns false if there is none, or "pending" is no state.
+			// Looks from the back, as an older copy was sent a tick or so ago
+			bool ReplaceQueuedState(outgoing_message& pending)
+			{
+				if (pending.nStateKey == 0)
+					return false;
+
+				size_t nFirst = m_nMessagesOutFront + m_nWriteMessages;
+				for (size_t i = m_vecMessagesOut.size(); i > nFirst; i--)
+				{
+					outgoing_message& queued = m_vecMessagesOut[i - 1];
+					if (queued.nStateKey != pending.nStateKey)
+						continue;
+
+					m_nQueuedBytes -= WireSize(queued);
+					m_nQueuedBytes += WireSize(pending);
+
+					m_msgPool.release(std::move(queued.msg));
+					queued.msg = std::move(pending.msg);
+					queued.shared = std::move(pending.shared);
+					return true;
+				}
+
+				return false;
+			}
+
+			// The outgoing queue is only touched from the asio thread. It is a vector
+			// which is consumed from the front and reset once drained, so its capacity,
+			// and the capacity of the pooled messages, is reused
+			bool OutgoingEmpty() const
+			{
+				return m_nMessagesOutFront == m_vecMessagesOut.size();
+			}
+
+			outgoing_message& OutgoingFront()
+			{
+				return m_vecMessagesOut[m_nMessagesOutFront];
+			}
+
+			void PopOutgoing()
+			{
+				outgoing_message& sent = m_vecMessagesOut[m_nMessagesOutFront];
+				m_nQueuedBytes -= WireSize(sent);
+				m_msgPool.release(std::move(sent.msg));
+				sent.shared.reset();
+				m_nMessagesOutFront++;
+
+				if (OutgoingEmpty())
+				{
+					m_vecMessagesOut.clear();
+					m_nMessagesOutFront = 0;
+				}
+				else if (m_nMessagesOutFront > 64 && m_nMessagesOutFront * 2 > m_vecMessagesOut.size())
+				{
+					// Never fully drained, drop the consumed part every now and then
+					m_vecMessagesOut.erase(m_vecMessagesOut.begin(), m_vecMessagesOut.begin() + m_nMessagesOutFront);
+					m_nMessagesOutFront = 0;
+				}
+			}
+
+			// Write the messages collected in m_vecDatagramBatch as one datagram
+			void WriteDatagramBatch()
+			{
+				m_nDatagramSequenceOut++;
+				if (m_nDatagramSequenceOut == 0) m_nDatagramSequenceOut++;
+
+				WriteDatagramTo(m_nDatagramSequenceOut);
+				m_vecDatagramBatch.clear();
+			}
+
+			// Write a datagram with the messages in m_vecDatagramBatch to the remote
+			// endpoint. UDP sends do not wait for the remote side, so it is written 
+			// synchronously from the messages themselves
+			void WriteDatagramTo(uint32_t sequence)
+			{
+				if (m_fDatagramLoss > 0.0f && std::uniform_real_distribution<float>(0.0f, 1.0f)(m_rngDatagramLoss) < m_fDatagramLoss)
+					return;
+
+				uint8_t prefix[datagram_prefix_size];
+				WriteDatagramPrefix(prefix, GetDatagramToken(), sequence);
+
+				std::array<asio::const_buffer, 1 + 2 * datagram_batch_messages> buffers = { asio::buffer(prefix, datagram_prefix_size) };
+				size_t nBuffers = 1;
+				for (const outgoing_message* out : m_vecDatagramBatch)
+					nBuffers = GatherMessage(*out, buffers.data(), nBuffers, nullptr);
+
+				// Datagrams are unreliable anyway, a failed send is a lost datagram
+				std::error_code ec;
+				size_t nSent = 0;
+				const auto buffersUsed = const_buffer_span{ buffers.data(), buffers.data() + nBuffers };
+				if (m_pDatagramSocketMutex)
+				{
+					std::scoped_lock lock(*m_pDatagramSocketMutex);
+					nSent = m_pDatagramSocket->send_to(buffersUsed, m_udpRemoteEndpoint, 0, ec);
+				}
+				else
+				{
+					nSent = m_pDatagramSocket->send_to(buffersUsed, m_udpRemoteEndpoint, 0, ec);
+				}
+
+				// The "hello" datagram is not a message
+				if (!ec && sequence != 0)
+					CountOut(nSent, m_vecDatagramBatch.size());
+			}
+
+			void CountIn(size_t nBytes, size_t nMessages = 1)
+			{
+				m_nBytesIn.fetch_add(nBytes, std::memory_order_relaxed);
+				m_nMessagesIn.fetch_add(nMessages, std::memory_order_relaxed);
+			}
+
+			void CountOut(size_t nBytes, size_t nMessages = 1)
+			{
+				m_nBytesOut.fetch_add(nBytes, std::memory_order_relaxed);
+				m_nMessagesOut.fetch_add(nMessages, std::memory_order_relaxed);
+			}
+
+			// Messages waiting to be written to the stream, asio thread only
+			size_t QueuedMessages() const
+			{
+				return m_vecMessagesOut.size() - m_nMessagesOutFront;
+			}
+
+			// Publish the size of the outgoing queue for GetStats()
+			void CountQueued()
+			{
+				m_nQueuedMessagesOut.store(QueuedMessages(), std::memory_order_relaxed);
+				m_nQueuedBytesOut.store(m_nQueuedBytes, std::memory_order_relaxed);
+			}
+
+			// Size of a message on the wire
+			static size_t WireSize(const outgoing_message& out)
+			{
+				return out.shared ? out.shared->size() : sizeof(message_header<T>) + out.msg.body.size();
+			}
+
+			// Append the buffers making up a message on the wire, starting at "nBuffers",
+			// and return the new count of buffers. There must be room for two more.
+			// A shared message is already header and body in one buffer. If "pHeader"
+			// is given, the header is copied there and sent from the copy
+			static size_t GatherMessage(const outgoing_message& out, asio::const_buffer* buffers, size_t nBuffers, message_header<T>* pHeader)
+			{
+				if (out.shared)
+				{
+					buffers[nBuffers++] = asio::buffer(*out.shared);
+				}
+				else
+				{
+					if (pHeader)
+					{
+						*pHeader = out.msg.header;
+						buffers[nBuffers++] = asio::buffer(pHeader, sizeof(message_header<T>));
+					}
+					else
+					{
+						buffers[nBuffers++] = asio::buffer(&out.msg.header, sizeof(message_header<T>));
+					}
+
+					if (!out.msg.body.empty())
+						buffers[nBuffers++] = asio::buffer(out.msg.body.data(), out.msg.body.size());
+				}
+
+				return nBuffers;
 			}
 
-			// ASYNC - Prime context to write a message body
-			void WriteBody()
+			// ASYNC - Prime context to write the messages at the front of the queue.
+			// All queued messages, up to write_batch_messages, are handed to asio 
+			// together, so they go out with one gathering write instead of one write 
+			// for each message.
+			// The queue may grow while the write is in progress, which moves its 
+			// entries, so the headers are sent from copies. Bodies and shared 
+			// messages live on the heap and stay where they are
+			void WriteMessage()
 			{
-				// If this function is called, a header has just been sent, and that header
-				// indicated a body existed for this message. Fill a transmission buffer
-				// with the body data, and send it!
-				asio::async_write(m_socket, asio::buffer(m_qMessagesOut.front().body.data(), m_qMessagesOut.front().body.size()),
-					[this](std::error_code ec, std::size_t length)
+				size_t nBuffers = 0;
+				m_nWriteMessages = 0;
+
+				for (size_t i = m_nMessagesOutFront; i < m_vecMessagesOut.size() && m_nWriteMessages < write_batch_messages; i++)
+				{
+					nBuffers = GatherMessage(m_vecMessagesOut[i], m_arrWriteBuffers.data(), nBuffers, &m_arrWriteHeaders[m_nWriteMessages]);
+					m_nWriteMessages++;
+				}
+
+				asio::async_write(m_socket, const_buffer_span{ m_arrWriteBuffers.data(), m_arrWriteBuffers.data() + nBuffers }, make_custom_alloc_handler(m_handlerMemoryWrite,
+					[this, self = this->shared_from_this()](std::error_code ec, std::size_t length)
 					{
+						// asio has now sent the bytes - if there was a problem
+						// an error would be available...
 						if (!ec)
 						{
-							// Sending was successful, so we are done with the message
-							// and remove it from the queue
-							m_qMessagesOut.pop_front();
-
-							// If the queue still has messages in it, then issue the task to 
-							// send the next messages' header.
-							if (!m_qMessagesOut.empty())
+							// ... no error, so we are done with these messages. Remove them 
+							// from the outgoing message queue
+							CountOut(length, m_nWriteMessages);
+							for (size_t i = 0; i < m_nWriteMessages; i++)
+								PopOutgoing();
+							m_nWriteMessages = 0;
+							CountQueued();
+
+							// If the queue is not empty, there are more messages to send, so
+							// make this happen by issuing the task to send the next ones.
+							if (!OutgoingEmpty())
 							{
-								WriteHeader();
+								WriteMessage();
 							}
 						}
 						else
 						{
-							// Sending failed, see WriteHeader() equivalent for description :P
-							std::cout << "[" << id << "] Write Body Fail.\n";
-							m_socket.close();
+							// ...asio failed to write the message, we could analyse why but 
+							// for now simply assume the connection has died by closing the
+							// socket. When a future attempt to write to this client fails due
+							// to the closed socket, it will be tidied up.
+							std::cout << "[" << id << "] Write Message Fail.\n";
+							CloseSocket();
 						}
-					});
+					}));
 			}
 
 			// ASYNC - Prime context ready to read a message header
@@ -520,13 +1701,21 @@ namespace olc
 				// size, so allocate a transmission buffer large enough to store it. In fact, 
 				// we will construct the message in a "temporary" message object as it's 
 				// convenient to work with.
-				asio::async_read(m_socket, asio::buffer(&m_msgTemporaryIn.header, sizeof(message_header<T>)),
-					[this](std::error_code ec, std::size_t length)
+				asio::async_read(m_socket, asio::buffer(&m_msgTemporaryIn.header, sizeof(message_header<T>)), make_custom_alloc_handler(m_handlerMemoryRead,
+					[this, self = this->shared_from_this()](std::error_code ec, std::size_t length)
 					{						
 						if (!ec)
 						{
-							// A complete message header has been read, check if this message
-							// has a body to follow...
+							// A complete message header has been read. Before anything is
+							// allocated, make sure the body is no larger than allowed
+							if (!AcceptHeader(m_msgTemporaryIn.header))
+							{
+								std::cout << "[" << id << "] Message Too Large.\n";
+								CloseSocket();
+								return;
+							}
+
+							// Check if this message has a body to follow...
 							if (m_msgTemporaryIn.header.size > 0)
 							{
 								// ...it does, so allocate enough space in the messages' body
@@ -546,9 +1735,25 @@ namespace olc
 							// Reading form the client went wrong, most likely a disconnect
 							// has occurred. Close the socket and let the system tidy it up later.
 							std::cout << "[" << id << "] Read Header Fail.\n";
-							m_socket.close();
+							CloseSocket();
 						}
-					});
+					}));
+			}
+
+			// Whether the body announced by the header is within the limits of the options
+			bool AcceptHeader(const message_header<T>& header) const
+			{
+				if (m_options.nMaxMessageSize > 0 && header.size > m_options.nMaxMessageSize)
+					return false;
+
+				if (!m_options.vecMaxMessageSizes.empty())
+				{
+					size_t nId = size_t(header.id);
+					if (nId >= m_options.vecMaxMessageSizes.size() || header.size > m_options.vecMaxMessageSizes[nId])
+						return false;
+				}
+
+				return true;
 			}
 
 			// ASYNC - Prime context ready to read a message body
@@ -557,8 +1762,8 @@ namespace olc
 				// If this function is called, a header has already been read, and that header
 				// request we read a body, The space for that body has already been allocated
 				// in the temporary message object, so just wait for the bytes to arrive...
-				asio::async_read(m_socket, asio::buffer(m_msgTemporaryIn.body.data(), m_msgTemporaryIn.body.size()),
-					[this](std::error_code ec, std::size_t length)
+				asio::async_read(m_socket, asio::buffer(m_msgTemporaryIn.body.data(), m_msgTemporaryIn.body.size()), make_custom_alloc_handler(m_handlerMemoryRead,
+					[this, self = this->shared_from_this()](std::error_code ec, std::size_t length)
 					{						
 						if (!ec)
 						{
@@ -570,9 +1775,23 @@ namespace olc
 						{
 							// As above!
 							std::cout << "[" << id << "] Read Body Fail.\n";
-							m_socket.close();
+							CloseSocket();
 						}
-					});
+					}));
+			}
+
+			// Random 64 bit value, never 0. Each thread has its own generator, seeded
+			// from the system's random device
+			static uint64_t RandomToken()
+			{
+				static thread_local std::mt19937_64 rng(
+					(uint64_t(std::random_device{}()) << 32) ^ uint64_t(std::random_device{}()));
+
+				uint64_t token = 0;
+				while (token == 0)
+					token = rng();
+
+				return token;
 			}
 
 			// "Encrypt" data
@@ -587,18 +1806,29 @@ namespace olc
 			void WriteValidation()
 			{
 				asio::async_write(m_socket, asio::buffer(&m_nHandshakeOut, sizeof(uint64_t)),
-					[this](std::error_code ec, std::size_t length)
+					[this, self = this->shared_from_this()](std::error_code ec, std::size_t length)
 					{
 						if (!ec)
 						{
 							// Validation data sent, clients should sit and wait
 							// for a response (or a closure)
 							if (m_nOwnerType == owner::client)
+							{
+								// The token is known now, so tell the server where
+								// we listen for datagrams
+								if (m_pDatagramSocket)
+								{
+									m_bDatagramReady = true;
+									m_vecDatagramBatch.clear();
+									WriteDatagramTo(0);
+								}
+
 								ReadHeader();
+							}
 						}
 						else
 						{
-							m_socket.close();
+							CloseSocket();
 						}
 					});
 			}
@@ -606,7 +1836,7 @@ namespace olc
 			void ReadValidation(olc::net::server_interface<T>* server = nullptr)
 			{
 				asio::async_read(m_socket, asio::buffer(&m_nHandshakeIn, sizeof(uint64_t)),
-					[this, server](std::error_code ec, std::size_t length)
+					[this, self = this->shared_from_this(), server](std::error_code ec, std::size_t length)
 					{
 						if (!ec)
 						{
@@ -619,6 +1849,7 @@ namespace olc
 								{
 									// Client has provided valid solution, so allow it to connect properly
 									std::cout << "Client Validated" << std::endl;
+									server->AddDatagramConnection(this->shared_from_this());
 									server->OnClientValidated(this->shared_from_this());
 
 									// Sit waiting to receive data now
@@ -628,7 +1859,7 @@ namespace olc
 								{
 									// Client gave incorrect data, so disconnect
 									std::cout << "Client Disconnected (Fail Validation)" << std::endl;
-									m_socket.close();
+									CloseSocket();
 								}
 							}
 							else
@@ -644,7 +1875,7 @@ namespace olc
 						{
 							// Some biggerfailure occured
 							std::cout << "Client Disconnected (ReadValidation)" << std::endl;
-							m_socket.close();
+							CloseSocket();
 						}
 					});
 			}
@@ -652,12 +1883,17 @@ namespace olc
 			// Once a full message is received, add it to the incoming queue
 			void AddToIncomingMessageQueue()
 			{				
+				CountIn(sizeof(message_header<T>) + m_msgTemporaryIn.body.size());
+
 				// Shove it in queue, converting it to an "owned message", by initialising
 				// with the a shared pointer from this connection object
 				if(m_nOwnerType == owner::server)
-					m_qMessagesIn.push_back({ this->shared_from_this(), m_msgTemporaryIn });
+					m_qMessagesIn.push_back({ this->shared_from_this(), std::move(m_msgTemporaryIn) });
 				else
-					m_qMessagesIn.push_back({ nullptr, m_msgTemporaryIn });
+					m_qMessagesIn.push_back({ nullptr, std::move(m_msgTemporaryIn) });
+
+				// The message now belongs to the queue, take a fresh one to read into
+				m_msgTemporaryIn = m_msgPool.acquire();
 
 				// We must now prime the asio context to receive the next message. It 
 				// wil just sit and wait for bytes to arrive, and the message construction
@@ -667,17 +1903,44 @@ namespace olc
 
 		protected:
 			// Each connection has a unique socket to a remote 
-			asio::ip::tcp::socket m_socket;
+			socket_type m_socket;
 
 			// This context is shared with the whole asio instance
 			asio::io_context& m_asioContext;
 
 			// This queue holds all messages to be sent to the remote side
-			// of this connection
-			tsqueue<message<T>> m_qMessagesOut;
+			// of this connection, see OutgoingFront() and PopOutgoing()
+			std::vector<outgoing_message> m_vecMessagesOut;
+			size_t m_nMessagesOutFront = 0;
+			size_t m_nQueuedBytes = 0;
+
+			// Messages handed to Send() but not yet picked up by the asio thread
+			std::mutex m_muxPendingOut;
+			std::vector<outgoing_message> m_vecPendingOut;
+			std::vector<outgoing_message> m_vecFlushing;
+			bool m_bFlushPosted = false;
+
+			// The stream write in progress, see WriteMessage(). The messages written
+			// are the first ones of the outgoing queue, 0 if there is no write
+			std::array<asio::const_buffer, 2 * write_batch_messages> m_arrWriteBuffers;
+			std::array<message_header<T>, write_batch_messages> m_arrWriteHeaders;
+			size_t m_nWriteMessages = 0;
+
+			// Datagrams to be sent together, see FlushPending()
+			std::vector<const outgoing_message*> m_vecDatagramBatch;
+
+			connection_options m_options;
+
+			// Memory for the handlers asio holds for this connection
+			handler_memory m_handlerMemoryRead;
+			handler_memory m_handlerMemoryWrite;
+			handler_memory m_handlerMemoryFlush;
 
 			// This references the incoming queue of the parent object
-			tsqueue<owned_message<T>>& m_qMessagesIn;
+			mpsc_queue<owned_message<T>>& m_qMessagesIn;
+
+			// This references the message pool of the parent object
+			message_pool<T>& m_msgPool;
 
 			// Incoming messages are constructed asynchronously, so we will
 			// store the part assembled message here, until it is ready
@@ -695,8 +1958,35 @@ namespace olc
 			bool m_bValidHandshake = false;
 			bool m_bConnectionEstablished = false;
 
+			// Cleared before the socket is closed, see IsConnected()
+			std::atomic<bool> m_bOpen{ false };
+
 			uint32_t id = 0;
 
+			// See ConnectDetached()
+			bool m_bDetached = false;
+
+			// Optional datagram channel, the socket is owned by the client or server
+			asio::ip::udp::socket* m_pDatagramSocket = nullptr;
+			std::mutex* m_pDatagramSocketMutex = nullptr;
+			asio::ip::udp::endpoint m_udpRemoteEndpoint;
+			asio::ip::address m_tcpRemoteAddress;
+			std::atomic<bool> m_bDatagramReady{ false };
+
+			// Traffic counters, see GetStats()
+			std::atomic<uint64_t> m_nBytesIn{ 0 };
+			std::atomic<uint64_t> m_nBytesOut{ 0 };
+			std::atomic<uint64_t> m_nMessagesIn{ 0 };
+			std::atomic<uint64_t> m_nMessagesOut{ 0 };
+			std::atomic<uint64_t> m_nQueuedMessagesOut{ 0 };
+			std::atomic<uint64_t> m_nQueuedBytesOut{ 0 };
+			uint32_t m_nDatagramSequenceOut = 0;
+			uint32_t m_nDatagramSequenceIn = 0;
+
+			// Simulated datagram loss for testing
+			float m_fDatagramLoss = 0.0f;
+			std::minstd_rand m_rngDatagramLoss{ std::random_device{}() };
+
 		};
 		
 		// Client
@@ -704,7 +1994,11 @@ namespace olc
 		class client_interface
 		{
 		public:
-			client_interface() 
+			// nIncomingCapacity is how many messages wait in Incoming() before the asio
+			// thread stops reading, see mpsc_queue. Its slots are allocated up front, so
+			// a process running many clients, e.g. a load test, may want a smaller one
+			explicit client_interface(size_t nIncomingCapacity = 16384)
+				: m_qMessagesIn(nIncomingCapacity)
 			{}
 
 			virtual ~client_interface()
@@ -714,8 +2008,9 @@ namespace olc
 			}
 
 		public:
-			// Connect to server with hostname/ip-address and port
-			bool Connect(const std::string& host, const uint16_t port)
+			// Connect to server with hostname/ip-address and port. If bDatagrams is set,
+			// a UDP socket is opened too, for use with SendDatagram()
+			bool Connect(const std::string& host, const uint16_t port, bool bDatagrams = false)
 			{
 				try
 				{
@@ -724,7 +2019,23 @@ namespace olc
 					asio::ip::tcp::resolver::results_type endpoints = resolver.resolve(host, std::to_string(port));
 
 					// Create connection
-					m_connection = std::make_unique<connection<T>>(connection<T>::owner::client, m_context, asio::ip::tcp::socket(m_context), m_qMessagesIn);
+					m_connection = std::make_shared<connection<T>>(connection<T>::owner::client, m_context, typename connection<T>::socket_type(asio::make_strand(m_context)), m_qMessagesIn, m_msgPool);
+					m_connection->SetOptions(m_options);
+
+					if (bDatagrams)
+					{
+						// The server listens for datagrams on the same port
+						asio::ip::udp::resolver udpResolver(m_context);
+						m_udpServerEndpoint = *udpResolver.resolve(asio::ip::udp::v4(), host, std::to_string(port)).begin();
+
+						m_udpSocket.open(asio::ip::udp::v4());
+						m_udpSocket.bind(asio::ip::udp::endpoint(asio::ip::udp::v4(), 0));
+						m_vDatagramIn.resize(datagram_max_size);
+
+						m_connection->AttachDatagramSocket(&m_udpSocket, m_udpServerEndpoint);
+						m_connection->SetDatagramLoss(m_fDatagramLoss);
+						ReadDatagram();
+					}
 					
 					// Tell the connection object to connect to server
 					m_connection->ConnectToServer(endpoints);
@@ -743,8 +2054,8 @@ namespace olc
 			// Disconnect from server
 			void Disconnect()
 			{
-				// If connection exists, and it's connected then...
-				if(IsConnected())
+				// If connection exists, connected or not yet, then...
+				if(m_connection)
 				{
 					// ...disconnect from server gracefully
 					m_connection->Disconnect();
@@ -752,12 +2063,25 @@ namespace olc
 
 				// Either way, we're also done with the asio context...				
 				m_context.stop();
+
 				// ...and its thread
 				if (thrContext.joinable())
 					thrContext.join();
 
+				if (m_udpSocket.is_open())
+				{
+					std::error_code ec;
+					m_udpSocket.close(ec);
+				}
+
+				// The handlers still queued live in the memory of the connection, see
+				// handler_memory. Let them finish, with the sockets closed they do not
+				// start anything new, before the connection can go
+				m_context.restart();
+				m_context.run();
+
 				// Destroy the connection object
-				m_connection.release();
+				m_connection.reset();
 			}
 
 			// Check if client is actually connected to a server
@@ -777,23 +2101,156 @@ namespace olc
 					 m_connection->Send(msg);
 			}
 
+			void Send(message<T>&& msg)
+			{
+				if (IsConnected())
+					m_connection->Send(std::move(msg));
+				else
+					m_msgPool.release(std::move(msg));
+			}
+
+			// Send message to server as unreliable datagram, falls back to Send()
+			// if we connected without datagrams
+			void SendDatagram(const message<T>& msg)
+			{
+				if (IsConnected())
+					m_connection->SendDatagram(msg);
+			}
+
+			void SendDatagram(message<T>&& msg)
+			{
+				if (IsConnected())
+					m_connection->SendDatagram(std::move(msg));
+				else
+					m_msgPool.release(std::move(msg));
+			}
+
+			// Send the latest state of something, see connection::SendState()
+			void SendState(message<T>&& msg, uint64_t nStateKey)
+			{
+				if (IsConnected())
+					m_connection->SendState(std::move(msg), nStateKey);
+				else
+					m_msgPool.release(std::move(msg));
+			}
+
+			void SendDatagramState(message<T>&& msg, uint64_t nStateKey)
+			{
+				if (IsConnected())
+					m_connection->SendDatagramState(std::move(msg), nStateKey);
+				else
+					m_msgPool.release(std::move(msg));
+			}
+
+			// Messages to be sent should be taken from the pool, and messages
+			// taken from Incoming() given back once processed
+			message_pool<T>& Pool()
+			{
+				return m_msgPool;
+			}
+
+			// For testing - drop the given fraction [0, 1] of outgoing datagrams.
+			// Call before Connect()
+			void SetDatagramLoss(float fLoss)
+			{
+				m_fDatagramLoss = fLoss;
+			}
+
+			// Socket options and batching of the connection, call before Connect()
+			void SetConnectionOptions(const connection_options& options)
+			{
+				m_options = options;
+			}
+
+			// With bManualFlush set, call once per frame to send everything sent
+			// during the frame together
+			void Flush()
+			{
+				if (IsConnected())
+					m_connection->Flush();
+			}
+
 			// Retrieve queue of messages from server
-			tsqueue<owned_message<T>>& Incoming()
+			mpsc_queue<owned_message<T>>& Incoming()
 			{ 
 				return m_qMessagesIn;
 			}
 
+			// Traffic to and from the server so far
+			connection_stats GetStats() const
+			{
+				if (m_connection)
+					return m_connection->GetStats();
+				else
+					return {};
+			}
+
 		protected:
 			// asio context handles the data transfer...
 			asio::io_context m_context;
 			// ...but needs a thread of its own to execute its work commands
 			std::thread thrContext;
 			// The client has a single instance of a "connection" object, which handles data transfer
-			std::unique_ptr<connection<T>> m_connection;
+			std::shared_ptr<connection<T>> m_connection;
+
+			// Messages are recycled through this pool
+			message_pool<T> m_msgPool;
+
+			// Optional datagram channel to the server
+			asio::ip::udp::socket m_udpSocket{ m_context };
+			asio::ip::udp::endpoint m_udpServerEndpoint;
+			asio::ip::udp::endpoint m_udpSenderEndpoint;
+			std::vector<uint8_t> m_vDatagramIn;
+			float m_fDatagramLoss = 0.0f;
+
+			connection_options m_options;
 			
 		private:
+			// ASYNC - Prime context to receive the next datagram from the server
+			void ReadDatagram()
+			{
+				m_udpSocket.async_receive_from(asio::buffer(m_vDatagramIn), m_udpSenderEndpoint,
+					[this](std::error_code ec, std::size_t length)
+					{
+						if (ec == asio::error::operation_aborted)
+							return;
+
+						if (!ec && m_udpSenderEndpoint == m_udpServerEndpoint)
+						{
+							uint64_t token = 0;
+							uint32_t sequence = 0;
+
+							if (ReadDatagramPrefix(m_vDatagramIn.data(), length, token, sequence) &&
+								m_connection && token == m_connection->GetDatagramToken() &&
+								m_connection->AcceptDatagram(sequence, m_udpSenderEndpoint))
+							{
+								ReadDatagramMessages(length);
+							}
+						}
+
+						// A single bad datagram does not break the channel, keep listening
+						if (m_udpSocket.is_open())
+							ReadDatagram();
+					});
+			}
+
+			// Pass the messages of the received datagram to the connection
+			void ReadDatagramMessages(size_t length)
+			{
+				size_t offset = datagram_prefix_size;
+				message<T> msg = m_msgPool.acquire();
+
+				while (ReadDatagramMessage(m_vDatagramIn.data(), length, offset, msg))
+				{
+					m_connection->OnDatagram(std::move(msg));
+					msg = m_msgPool.acquire();
+				}
+
+				m_msgPool.release(std::move(msg));
+			}
+
 			// This is the thread safe queue of incoming messages from server
-			tsqueue<owned_message<T>> m_qMessagesIn;
+			mpsc_queue<owned_message<T>> m_qMessagesIn;
 		};
 		
 		// Server
@@ -801,9 +2258,16 @@ namespace olc
 		class server_interface
 		{
 		public:
-			// Create a server, ready to listen on specified port
-			server_interface(uint16_t port)
-				: m_asioAcceptor(m_asioContext, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+			// Create a server, ready to listen on specified port. If bDatagrams is set,
+			// the server also listens for UDP datagrams on the same port.
+			// nIOThreads threads run the asio context. Each connection is bound to
+			// its own strand, so its handlers never run concurrently, but different 
+			// connections are served in parallel. Messages still arrive in the one
+			// incoming queue and OnMessage() is called from Update() as before
+			server_interface(uint16_t port, bool bDatagrams = false, size_t nIOThreads = 1)
+				: m_asioAcceptor(m_asioContext),
+				m_asioDatagramSocket(m_asioContext), m_nPort(port), m_bDatagrams(bDatagrams),
+				m_nIOThreads(std::max<size_t>(nIOThreads, 1))
 			{
 
 			}
@@ -812,6 +2276,29 @@ namespace olc
 			{
 				// May as well try and tidy up
 				Stop();
+
+				// The connections must go before the asio context they use, and the
+				// handlers still pending live in the memory of theyre connection, see
+				// handler_memory. So close everything, and let the handlers finish,
+				// which does not start anything new on closed sockets
+				for (auto& client : m_vecNewConnections)
+					client->Disconnect();
+				for (auto& client : m_deqConnections)
+					client->Disconnect();
+
+				std::error_code ec;
+				m_asioAcceptor.close(ec);
+				m_asioDatagramSocket.close(ec);
+
+				m_asioContext.restart();
+				m_asioContext.run();
+
+				// Messages never taken out of the queue hold on to theyre connection too
+				m_qMessagesIn.clear();
+				m_vecMessagesIn.clear();
+
+				m_vecNewConnections.clear();
+				m_deqConnections.clear();
 			}
 
 			// Starts the server!
@@ -819,6 +2306,14 @@ namespace olc
 			{
 				try
 				{
+					// The port is only taken here, so a server which is never started, e.g. to
+					// replay a journal, can run next to one listening on the same port
+					asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), m_nPort);
+					m_asioAcceptor.open(endpoint.protocol());
+					m_asioAcceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true));
+					m_asioAcceptor.bind(endpoint);
+					m_asioAcceptor.listen();
+
 					// Issue a task to the asio context - This is important
 					// as it will prime the context with "work", and stop it
 					// from exiting immediately. Since this is a server, we 
@@ -826,8 +2321,17 @@ namespace olc
 					// connect.
 					WaitForClientConnection();
 
-					// Launch the asio context in its own thread
-					m_threadContext = std::thread([this]() { m_asioContext.run(); });
+					if (m_bDatagrams)
+					{
+						m_asioDatagramSocket.open(asio::ip::udp::v4());
+						m_asioDatagramSocket.bind(asio::ip::udp::endpoint(asio::ip::udp::v4(), m_nPort));
+						m_vDatagramIn.resize(datagram_max_size);
+						ReadDatagram();
+					}
+
+					// Launch the asio context in its own threads
+					for (size_t i = 0; i < m_nIOThreads; i++)
+						m_vecThreadContext.emplace_back([this]() { m_asioContext.run(); });
 				}
 				catch (std::exception& e)
 				{
@@ -846,8 +2350,11 @@ namespace olc
 				// Request the context to close
 				m_asioContext.stop();
 
-				// Tidy up the context thread
-				if (m_threadContext.joinable()) m_threadContext.join();
+				// Tidy up the context threads
+				for (auto& thread : m_vecThreadContext)
+					if (thread.joinable()) thread.join();
+
+				m_vecThreadContext.clear();
 
 				// Inform someone, anybody, if they care...
 				std::cout << "[SERVER] Stopped!\n";
@@ -858,9 +2365,10 @@ namespace olc
 			{
 				// Prime context with an instruction to wait until a socket connects. This
 				// is the purpose of an "acceptor" object. It will provide a unique socket
-				// for each incoming connection attempt
-				m_asioAcceptor.async_accept(
-					[this](std::error_code ec, asio::ip::tcp::socket socket)
+				// for each incoming connection attempt. The socket is created on a new 
+				// strand, which serializes all work of the connection
+				m_asioAcceptor.async_accept(asio::make_strand(m_asioContext),
+					[this](std::error_code ec, typename connection<T>::socket_type socket)
 					{
 						// Triggered by incoming connection request
 						if (!ec)
@@ -871,21 +2379,25 @@ namespace olc
 							// Create a new connection to handle this client 
 							std::shared_ptr<connection<T>> newconn = 
 								std::make_shared<connection<T>>(connection<T>::owner::server, 
-									m_asioContext, std::move(socket), m_qMessagesIn);
+									m_asioContext, std::move(socket), m_qMessagesIn, m_msgPool);
+							newconn->SetOptions(m_options);
 							
 							
 
 							// Give the user server a chance to deny connection
 							if (OnClientConnect(newconn))
 							{								
-								// Connection allowed, so add to container of new connections
-								m_deqConnections.push_back(std::move(newconn));
-
 								// And very important! Issue a task to the connection's
 								// asio context to sit and wait for bytes to arrive!
-								m_deqConnections.back()->ConnectToClient(this, nIDCounter++);
+								newconn->ConnectToClient(this, nIDCounter++);
 
-								std::cout << "[" << m_deqConnections.back()->GetID() << "] Connection Approved\n";
+								std::cout << "[" << newconn->GetID() << "] Connection Approved\n";
+
+								// Connection allowed. This runs on an asio thread, while the
+								// container of connections belongs to the thread calling
+								// Update(), so hand it over, see AddNewConnections()
+								std::scoped_lock lock(m_muxNewConnections);
+								m_vecNewConnections.push_back(std::move(newconn));
 							}
 							else
 							{
@@ -895,6 +2407,11 @@ namespace olc
 								// get destroyed automagically due to the wonder of smart pointers
 							}
 						}
+						else if (ec == asio::error::operation_aborted)
+						{
+							// The server is going away
+							return;
+						}
 						else
 						{
 							// Error has occurred during acceptance
@@ -907,6 +2424,22 @@ namespace olc
 					});
 			}
 
+			// Send a message to a specific client, handing the message over instead of
+			// copying it. The message should be taken from Pool()
+			void MessageClient(std::shared_ptr<connection<T>> client, message<T>&& msg)
+			{
+				if (client && client->IsConnected())
+				{
+					client->Send(std::move(msg));
+				}
+				else
+				{
+					// Only removes the client, so the message goes back to the pool
+					MessageClient(client, static_cast<const message<T>&>(msg));
+					m_msgPool.release(std::move(msg));
+				}
+			}
+
 			// Send a message to a specific client
 			void MessageClient(std::shared_ptr<connection<T>> client, const message<T>& msg)
 			{
@@ -922,6 +2455,7 @@ namespace olc
 					// well remove the client - let the server know, it may
 					// be tracking it somehow
 					OnClientDisconnect(client);
+					RemoveDatagramConnection(client);
 
 					// Off you go now, bye bye!
 					client.reset();
@@ -932,8 +2466,96 @@ namespace olc
 				}
 			}
 			
+			// Send a message to a specific client as unreliable datagram. Falls back
+			// to MessageClient() if the client has no datagram channel yet
+			void MessageClientDatagram(std::shared_ptr<connection<T>> client, const message<T>& msg)
+			{
+				if (client && client->IsConnected())
+					client->SendDatagram(msg);
+				else
+					MessageClient(client, msg);
+			}
+
+			// As above, but hands the message over instead of copying it. The message
+			// should be taken from Pool()
+			void MessageClientDatagram(std::shared_ptr<connection<T>> client, message<T>&& msg)
+			{
+				if (client && client->IsConnected())
+				{
+					client->SendDatagram(std::move(msg));
+				}
+				else
+				{
+					// Only removes the client, so the message goes back to the pool
+					MessageClient(client, static_cast<const message<T>&>(msg));
+					m_msgPool.release(std::move(msg));
+				}
+			}
+
+			// Messages to be sent should be taken from the pool
+			message_pool<T>& Pool()
+			{
+				return m_msgPool;
+			}
+
+			// Socket options and batching of the connections accepted from now on,
+			// call before Start()
+			void SetConnectionOptions(const connection_options& options)
+			{
+				m_options = options;
+			}
+
+			// With bManualFlush set, call once per tick to send everything sent to
+			// the clients during the tick, one write and few datagrams per client
+			void Flush()
+			{
+				for (auto& client : m_deqConnections)
+					if (client && client->IsConnected())
+						client->Flush();
+			}
+
+			// A connection to no one with the given id, see connection::ConnectDetached()
+			std::shared_ptr<connection<T>> CreateDetachedConnection(uint32_t uid)
+			{
+				std::shared_ptr<connection<T>> conn =
+					std::make_shared<connection<T>>(connection<T>::owner::server,
+						m_asioContext, typename connection<T>::socket_type(asio::make_strand(m_asioContext)), m_qMessagesIn, m_msgPool);
+				conn->ConnectDetached(uid);
+				return conn;
+			}
+
+			// Call OnClientDisconnect() for every client which lost its connection and
+			// remove it, without waiting for the next message sent to it to fail
+			void RemoveDisconnectedClients()
+			{
+				bool bInvalidClientExists = false;
+
+				for (auto& client : m_deqConnections)
+				{
+					if (!client || !client->IsConnected())
+					{
+						if (client) OnClientDisconnect(client);
+						RemoveDatagramConnection(client);
+						client.reset();
+
+						bInvalidClientExists = true;
+					}
+				}
+
+				if (bInvalidClientExists)
+					m_deqConnections.erase(
+						std::remove(m_deqConnections.begin(), m_deqConnections.end(), nullptr), m_deqConnections.end());
+			}
+
 			// Send message to all clients
 			void MessageAllClients(const message<T>& msg, std::shared_ptr<connection<T>> pIgnoreClient = nullptr)
+			{
+				// Serialize once, every connection shares the same bytes
+				MessageAllClients(make_shared_message(msg), pIgnoreClient);
+			}
+
+			// Send an already serialized message to all clients
+			void MessageAllClients(const shared_message<T>& msg, std::shared_ptr<connection<T>> pIgnoreClient = nullptr)
 			{
 				bool bInvalidClientExists = false;
 
@@ -952,6 +2574,7 @@ namespace olc
 						// The client couldnt be contacted, so assume it has
 						// disconnected.
 						OnClientDisconnect(client);
+						RemoveDatagramConnection(client);
 						client.reset();
 
 						// Set this flag to then remove dead clients from container
@@ -966,23 +2589,40 @@ namespace olc
 						std::remove(m_deqConnections.begin(), m_deqConnections.end(), nullptr), m_deqConnections.end());
 			}
 
+			// Move the connections accepted since the last call into the container of
+			// connections. Called by Update(), as only its thread may touch the container
+			void AddNewConnections()
+			{
+				std::scoped_lock lock(m_muxNewConnections);
+
+				for (auto& client : m_vecNewConnections)
+					m_deqConnections.push_back(std::move(client));
+
+				m_vecNewConnections.clear();
+			}
+
 			// Force server to respond to incoming messages
 			void Update(size_t nMaxMessages = -1, bool bWait = false)
 			{
 				if (bWait) m_qMessagesIn.wait();
 
-				// Process as many messages as you can up to the value
-				// specified
-				size_t nMessageCount = 0;
-				while (nMessageCount < nMaxMessages && !m_qMessagesIn.empty())
-				{
-					// Grab the front message
-					auto msg = m_qMessagesIn.pop_front();
+				AddNewConnections();
 
+				// Take out as many messages as you can up to the value
+				// specified, all in one go
+				m_vecMessagesIn.clear();
+				m_nLastUpdateMessages = m_qMessagesIn.drain(m_vecMessagesIn, nMaxMessages);
+
+				for (auto& msg : m_vecMessagesIn)
+				{
 					// Pass to message handler
 					OnMessage(msg.remote, msg.msg);
 
-					nMessageCount++;
+					// Done with it, so it can be reused
+					m_msgPool.release(std::move(msg.msg));
+
+					// Do not keep the connection alive until the next Update()
+					msg.remote.reset();
 				}
 			}
 
@@ -998,6 +2638,13 @@ namespace olc
 				return 	m_asioAcceptor.local_endpoint().address().to_string();
 			}
 
+			// Messages the last Update() took out of the incoming queue, which is how
+			// many were waiting when it was called
+			size_t GetLastUpdateMessages() const
+			{
+				return m_nLastUpdateMessages;
+			}
+
 		protected:
 			// This server class should override thse functions to implement
 			// customised functionality
@@ -1021,27 +2668,154 @@ namespace olc
 			}
 
 		public:
-			// Called when a client is validated
+			// Called when a client is validated. With more than one I/O thread this
+			// may be called for different clients at the same time
 			virtual void OnClientValidated(std::shared_ptr<connection<T>> client)
 			{
 
 			}
 
+			// Called from the asio thread when a client is validated, from now on
+			// datagrams carrying its token are routed to it
+			void AddDatagramConnection(std::shared_ptr<connection<T>> client)
+			{
+				if (!m_bDatagrams)
+					return;
+
+				client->AttachDatagramSocket(&m_asioDatagramSocket, {}, &m_muxDatagramSocket);
+				client->SetDatagramLoss(m_fDatagramLoss);
+
+				std::scoped_lock lock(m_muxDatagramConnections);
+				m_mapDatagramConnections[client->GetDatagramToken()] = client;
+			}
+
+			// Datagrams carrying the token of a client which is gone are dropped from
+			// now on, and the map does not grow with every client ever connected
+			void RemoveDatagramConnection(const std::shared_ptr<connection<T>>& client)
+			{
+				if (!m_bDatagrams || !client)
+					return;
+
+				std::scoped_lock lock(m_muxDatagramConnections);
+				auto it = m_mapDatagramConnections.find(client->GetDatagramToken());
+				if (it != m_mapDatagramConnections.end() && (it->second.expired() || it->second.lock() == client))
+					m_mapDatagramConnections.erase(it);
+			}
+
+			// Clients which can be reached by datagrams
+			size_t GetDatagramConnectionCount()
+			{
+				std::scoped_lock lock(m_muxDatagramConnections);
+				return m_mapDatagramConnections.size();
+			}
+
+			// For testing - drop the given fraction [0, 1] of outgoing datagrams.
+			// Call before Start()
+			void SetDatagramLoss(float fLoss)
+			{
+				m_fDatagramLoss = fLoss;
+			}
+
+		private:
+			// ASYNC - Prime context to receive the next datagram from any client
+			void ReadDatagram()
+			{
+				m_asioDatagramSocket.async_receive_from(asio::buffer(m_vDatagramIn), m_udpSenderEndpoint,
+					[this](std::error_code ec, std::size_t length)
+					{
+						if (ec == asio::error::operation_aborted)
+							return;
+
+						if (!ec)
+						{
+							uint64_t token = 0;
+							uint32_t sequence = 0;
+
+							if (ReadDatagramPrefix(m_vDatagramIn.data(), length, token, sequence))
+							{
+								std::shared_ptr<connection<T>> client;
+								{
+									std::scoped_lock lock(m_muxDatagramConnections);
+									auto it = m_mapDatagramConnections.find(token);
+									if (it != m_mapDatagramConnections.end())
+									{
+										// Forget connections which are gone
+										client = it->second.lock();
+										if (!client)
+											m_mapDatagramConnections.erase(it);
+									}
+								}
+
+								if (client && client->AcceptDatagram(sequence, m_udpSenderEndpoint))
+									ReadDatagramMessages(*client, length);
+							}
+						}
+
+						// A single bad datagram does not break the channel, keep listening
+						if (m_asioDatagramSocket.is_open())
+							ReadDatagram();
+					});
+			}
+
+			// Pass the messages of the received datagram to the connection
+			void ReadDatagramMessages(connection<T>& client, size_t length)
+			{
+				size_t offset = datagram_prefix_size;
+				message<T> msg = m_msgPool.acquire();
+
+				while (ReadDatagramMessage(m_vDatagramIn.data(), length, offset, msg))
+				{
+					client.OnDatagram(std::move(msg));
+					msg = m_msgPool.acquire();
+				}
+
+				m_msgPool.release(std::move(msg));
+			}
+
 
 		protected:
 			// Thread Safe Queue for incoming message packets
-			tsqueue<owned_message<T>> m_qMessagesIn;
+			mpsc_queue<owned_message<T>> m_qMessagesIn;
 
-			// Container of active validated connections
+			// Messages taken out of the queue at once by Update()
+			std::vector<owned_message<T>> m_vecMessagesIn;
+			size_t m_nLastUpdateMessages = 0;
+
+			// Messages are recycled through this pool, the connections share it
+			message_pool<T> m_msgPool;
+
+			// Container of active validated connections. Only the thread calling Update()
+			// uses it, which is why Flush(), MessageAllClients() etc. must be called there too
 			std::deque<std::shared_ptr<connection<T>>> m_deqConnections;
 
+			// Connections accepted on an asio thread, not yet in the container
+			std::mutex m_muxNewConnections;
+			std::vector<std::shared_ptr<connection<T>>> m_vecNewConnections;
+
 			// Order of declaration is important - it is also the order of initialisation
 			asio::io_context m_asioContext;
-			std::thread m_threadContext;
+			std::vector<std::thread> m_vecThreadContext;
 
 			// These things need an asio context
 			asio::ip::tcp::acceptor m_asioAcceptor; // Handles new incoming connection attempts...
 
+			// Optional datagram channel shared by all clients. Connections send 
+			// from their own strands, so sends are guarded, and so is the map, as 
+			// connections are added from their strands too
+			asio::ip::udp::socket m_asioDatagramSocket;
+			std::mutex m_muxDatagramSocket;
+			uint16_t m_nPort = 0;
+			bool m_bDatagrams = false;
+			size_t m_nIOThreads = 1;
+			float m_fDatagramLoss = 0.0f;
+			std::vector<uint8_t> m_vDatagramIn;
+			asio::ip::udp::endpoint m_udpSenderEndpoint;
+			std::mutex m_muxDatagramConnections;
+			std::map<uint64_t, std::weak_ptr<connection<T>>> m_mapDatagramConnections;
+
+			// Applied to each accepted connection
+			connection_options m_options;
+
 			// Clients will be identified in the "wider system" via an ID
 			uint32_t nIDCounter = 10000;
 		};